@@ -0,0 +1,25 @@
+#define __1D_WORK_GROUP
+#define __1D_GRID
+#include <opencl.h>
+
+__global int *pick(bool p, __global int *ip, __global int *jp) {
+  return p ? ip : jp;
+}
+
+__global int *step(bool p, __global int *ip) {
+  return p ? ip+1 : 0;
+}
+
+__kernel void foo(bool p, __global int *ip, __global int *jp,
+                  __global int *kp) {
+  __global int *xp = ip;
+  if (p)
+    xp = jp;
+  while (xp[0])
+    xp++;
+  pick(p, xp, jp)[1] = 1;
+  __global int *np = step(p, kp);
+  if (np)
+    np[0] = 2;
+  ((__global char *)kp)[1] = 3;
+}
@@ -0,0 +1,48 @@
+#ifndef BUGLE_AFFINEFORM_H
+#define BUGLE_AFFINEFORM_H
+
+#include "bugle/Expr.h"
+#include "bugle/Ref.h"
+#include "llvm/ADT/APInt.h"
+#include <utility>
+#include <vector>
+
+namespace bugle {
+
+class Var;
+
+// A bitvector expression in the normal form c + c1 * t1 + ... + cn * tn,
+// where the terms ti are neither constants, sums nor constant multiples.
+// Terms are kept in the order in which they were first added, and equal
+// terms are merged, so that the expression built from the form does not
+// depend on how the sum was grouped.
+class AffineForm {
+  llvm::APInt constant;
+  std::vector<std::pair<ref<Expr>, llvm::APInt>> terms;
+
+  void addTerm(ref<Expr> term, const llvm::APInt &coeff);
+
+public:
+  AffineForm(unsigned width) : constant(width, 0) {}
+
+  // Add e multiplied by scale, decomposing e as far as it is affine.
+  void add(ref<Expr> e, const llvm::APInt &scale);
+  void add(ref<Expr> e) { add(e, llvm::APInt(constant.getBitWidth(), 1)); }
+  void add(ref<Expr> e, uint64_t scale) {
+    add(e, llvm::APInt(constant.getBitWidth(), scale));
+  }
+  void addConstant(uint64_t c) { constant += c; }
+
+  // Divide the form by a power of two, exactly as in Expr::createExactBVSDiv,
+  // which is the case if the constant and every term are multiples of it,
+  // counting both the coefficient of a term and the low bits known to be zero
+  // in the term itself.  The offset of the base variable, if any, may appear
+  // unscaled.
+  // Returns false, leaving the form unchanged, if the division is not exact.
+  bool divideExact(uint64_t divisor, Var *base = nullptr);
+
+  ref<Expr> toExpr() const;
+};
+}
+
+#endif
@@ -1,7 +1,10 @@
 #ifndef BUGLE_BPLEXPRWRITER_H
 #define BUGLE_BPLEXPRWRITER_H
 
+#include "bugle/BPLIntrinsic.h"
+#include <functional>
 #include <string>
+#include <unordered_map>
 
 namespace llvm {
 
@@ -13,6 +16,11 @@ namespace bugle {
 class BPLModuleWriter;
 class Expr;
 
+// The intrinsics used by a module or function, each with the first expression
+// using it.
+typedef std::unordered_map<BPLIntrinsic, Expr *, BPLIntrinsic::Hash>
+    BPLIntrinsicTable;
+
 class BPLExprWriter {
   void writeAccessHasOccurredVar(llvm::raw_ostream &OS, bugle::Expr *PtrArr,
                                  std::string accessKind);
@@ -22,9 +30,31 @@ class BPLExprWriter {
 
 protected:
   BPLModuleWriter *MW;
+  // Where the intrinsics used are noted if not with the module writer, as
+  // when a function is written concurrently with others.
+  BPLIntrinsicTable *IntrinsicTable;
+
+  void useIntrinsic(const BPLIntrinsic &I, Expr *Origin = 0);
+  // Write the name of the function implementing a binary operation on
+  // operands of the given types, and note its use.
+  void writeBinaryName(llvm::raw_ostream &OS, Expr::Kind Kind, Type LHSTy,
+                       Type RHSTy);
+  // Write a packed vector as a balanced concatenation of lanes [Begin, End),
+  // each written by WriteLane, so that the depth of the written expression
+  // grows only logarithmically with their number.
+  void writeLanes(llvm::raw_ostream &OS, unsigned Begin, unsigned End,
+                  unsigned Depth,
+                  const std::function<void(llvm::raw_ostream &, unsigned)>
+                      &WriteLane);
+  // Write the given lane of a vector operand of a packed vector.  The operand
+  // is written once per lane, so packed vectors are kept in SSA form for
+  // their users to refer to them by name.
+  void writeLaneOperand(llvm::raw_ostream &OS, Expr *Op, unsigned Lane,
+                        unsigned LaneWidth);
 
 public:
-  BPLExprWriter(BPLModuleWriter *MW) : MW(MW) {}
+  BPLExprWriter(BPLModuleWriter *MW, BPLIntrinsicTable *IntrinsicTable = 0)
+      : MW(MW), IntrinsicTable(IntrinsicTable) {}
   virtual ~BPLExprWriter();
   virtual void writeExpr(llvm::raw_ostream &OS, Expr *E, unsigned Depth = 0);
 };
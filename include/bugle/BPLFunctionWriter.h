@@ -3,9 +3,11 @@
 
 #include "bugle/BPLExprWriter.h"
 #include "bugle/SourceLoc.h"
+#include "bugle/Type.h"
 #include <functional>
 #include <map>
 #include <set>
+#include <utility>
 #include <vector>
 
 namespace llvm {
@@ -15,29 +17,55 @@ class raw_ostream;
 
 namespace bugle {
 
+class AssumeElementsStmt;
 class BPLModuleWriter;
 class BasicBlock;
 class CallStmt;
 class Expr;
 class Function;
 class GlobalArray;
+class SourceLocWriter;
 class Stmt;
 class Var;
 
 class BPLFunctionWriter : BPLExprWriter {
   llvm::raw_ostream &OS;
   bugle::Function *F;
+  bugle::SourceLocWriter *SLW;
+  // Whether the function is written concurrently with others, in which case
+  // its candidates are numbered from NextCandidate and the numbers of its
+  // source locations are marked in the output, as they are renumbered once
+  // the functions written before it are known.
+  bool Concurrent;
+  unsigned NextCandidate;
   std::map<Expr *, unsigned> SSAVarIds;
   std::set<GlobalArray *> ModifiesSet;
 
+  // The pure subexpressions referenced more than once which are bound to
+  // variables in the part of the basic block being written, and the types of
+  // all such variables of the function.
+  std::map<Expr *, unsigned> SharedVarIds;
+  std::vector<Type> SharedVarTypes;
+  // Where bindings are written, or null if the statement being written may
+  // not bind subexpressions.
+  llvm::raw_ostream *BindOS;
+  // Whether the expression being written reads state which the statements of
+  // the function may change.
+  bool WroteImpure;
+
   void maybeWriteCaseSplit(llvm::raw_ostream &OS, Expr *PtrArr,
                            const SourceLocsRef &SLocs,
                            std::function<void(GlobalArray *, unsigned int)> F);
   void writeVar(llvm::raw_ostream &OS, Var *V);
   void writeExpr(llvm::raw_ostream &OS, Expr *E, unsigned Depth = 0) override;
   void writeCallStmt(llvm::raw_ostream &OS, CallStmt *CS);
+  void writeAssumeElementsStmt(llvm::raw_ostream &OS,
+                               AssumeElementsStmt *AES);
   void writeStmt(llvm::raw_ostream &OS, Stmt *S);
   void writeBasicBlock(llvm::raw_ostream &OS, BasicBlock *BB);
+  void writeSSAVarDecl(llvm::raw_ostream &OS, unsigned Id, Type T);
+  void writeSharedVarDecls(llvm::raw_ostream &OS,
+                           const std::vector<Type> &Types);
   void writeSourceLocs(llvm::raw_ostream &OS, const SourceLocsRef &sourcelocs);
   void writeSourceLocsMarker(llvm::raw_ostream &OS,
                              const SourceLocsRef &sourcelocs,
@@ -45,9 +73,24 @@ class BPLFunctionWriter : BPLExprWriter {
 
 public:
   BPLFunctionWriter(BPLModuleWriter *MW, llvm::raw_ostream &OS,
-                    bugle::Function *F)
-      : BPLExprWriter(MW), OS(OS), F(F) {}
+                    bugle::Function *F);
+  BPLFunctionWriter(BPLModuleWriter *MW, llvm::raw_ostream &OS,
+                    bugle::Function *F, BPLIntrinsicTable *Intrinsics,
+                    bugle::SourceLocWriter *SLW, unsigned FirstCandidate)
+      : BPLExprWriter(MW, Intrinsics), OS(OS), F(F), SLW(SLW),
+        Concurrent(true), NextCandidate(FirstCandidate), BindOS(0),
+        WroteImpure(false) {}
   void write();
+  // The id and type of each SSA variable of the function, in the order in
+  // which they are declared.
+  std::vector<std::pair<unsigned, Type>> getSSAVarTypes() const;
+  const std::vector<Type> &getSharedVarTypes() const { return SharedVarTypes; }
+
+  // The number of candidates numbered when the function is written.
+  static unsigned countCandidates(bugle::Function *F);
+  // The marker surrounding the numbers of source locations of a function
+  // written concurrently with others.
+  static const char SourceLocMarker = '\x1A';
 };
 }
 
@@ -0,0 +1,75 @@
+#ifndef BUGLE_BPLINTRINSIC_H
+#define BUGLE_BPLINTRINSIC_H
+
+#include "bugle/Expr.h"
+#include "bugle/Type.h"
+#include <cstddef>
+
+namespace llvm {
+
+class raw_ostream;
+}
+
+namespace bugle {
+
+// Identifies a declaration which the module writer emits before the functions
+// using it: a function or procedure modelling an operation, or a constant or
+// variable.  An intrinsic is identified by its kind together with the
+// operation, widths, types and object it is declared for, so that repeated
+// uses of the same intrinsic are cheap to recognise, and its declaration is
+// only written once.
+struct BPLIntrinsic {
+  enum Kind {
+    Extract,
+    Concat,
+    ZeroExtend,
+    SignExtend,
+    ArithmeticBinary,
+    BooleanBinary,
+    Ctlz,
+    AddNoovflSigned,
+    AddNoovflUnsigned,
+    AddNoovflPredicate,
+    Candidate,
+    AsyncWorkGroupCopy,
+    WaitGroupEvents,
+    SpecialVar,
+    UninterpretedFunction,
+    AtomicUsedMap,
+    UnaryFunction,
+    BinaryFunction
+  };
+
+  Kind K;
+  // The expression kind of the operation, the candidate number or the number
+  // of operands, depending on the kind of intrinsic.
+  unsigned Op;
+  unsigned Widths[4];
+  Type T0, T1;
+  // The special variable attribute, function name or array the intrinsic is
+  // declared for.  Names are interned, so that equal names are equal pointers.
+  const void *Ptr;
+
+  BPLIntrinsic(Kind K, unsigned Op = 0, unsigned W0 = 0, unsigned W1 = 0,
+               unsigned W2 = 0, unsigned W3 = 0)
+      : K(K), Op(Op), Widths{W0, W1, W2, W3}, T0(Type::Unknown),
+        T1(Type::Unknown), Ptr(0) {}
+
+  BPLIntrinsic(Kind K, unsigned Op, Type T0, Type T1 = Type(Type::Unknown),
+               const void *Ptr = 0)
+      : K(K), Op(Op), Widths{0, 0, 0, 0}, T0(T0), T1(T1), Ptr(Ptr) {}
+
+  bool operator==(const BPLIntrinsic &Other) const;
+
+  // The name of a unary or binary function intrinsic.
+  void writeName(llvm::raw_ostream &OS) const;
+
+  static const char *getBinaryName(Expr::Kind Kind);
+
+  struct Hash {
+    size_t operator()(const BPLIntrinsic &I) const;
+  };
+};
+}
+
+#endif
@@ -2,10 +2,16 @@
 #define BUGLE_BPLMODULEWRITER_H
 
 #include "bugle/BPLExprWriter.h"
+#include "bugle/BPLIntrinsic.h"
 #include "bugle/RaceInstrumenter.h"
-#include <functional>
+#include "bugle/Type.h"
+#include <atomic>
+#include <map>
 #include <set>
 #include <string>
+#include <unordered_map>
+#include <utility>
+#include <vector>
 
 namespace llvm {
 
@@ -14,10 +20,13 @@ class raw_ostream;
 
 namespace bugle {
 
+class Expr;
+class Function;
+class GlobalArray;
+struct GlobalInit;
 class IntegerRepresentation;
 class Module;
 class SourceLocWriter;
-struct Type;
 
 class BPLModuleWriter : BPLExprWriter {
   llvm::raw_ostream &OS;
@@ -25,15 +34,41 @@ class BPLModuleWriter : BPLExprWriter {
   bugle::IntegerRepresentation *IntRep;
   bugle::RaceInstrumenter RaceInst;
   bugle::SourceLocWriter *SLW;
-  std::set<std::string> IntrinsicSet;
-  bool UsesPointers, UsesFunctionPointers;
-  std::string GlobalInitRequires;
+  // The intrinsics used by the module, each with the first expression using
+  // it.  Their declarations are written when the module is written.
+  BPLIntrinsicTable Intrinsics;
+  std::atomic<bool> UsesPointers, UsesFunctionPointers;
+  // The declarations stating the initial values of the global arrays, and the
+  // precondition of each entry point applying them.
+  std::string GlobalInitDecls, GlobalInitRequires;
+  // The arrays which are never written, and so are declared as constants.
+  std::set<bugle::GlobalArray *> ReadOnlyArrays;
   unsigned candidateNumber;
 
+  // When streaming, the prelude is written before any function, so the
+  // functions are first written to nowhere to find what the prelude needs,
+  // together with the types of the SSA variables and of the variables bound
+  // to shared subexpressions of each function.
+  bool Stream, PrePass;
+  std::map<bugle::Function *, std::vector<std::pair<unsigned, bugle::Type>>>
+      SSAVarTypes;
+  std::map<bugle::Function *, std::vector<bugle::Type>> SharedVarTypes;
+
+  // The number of threads writing functions when the output is buffered.
+  unsigned Threads;
+
+  void prePass();
+  void writeFunctions(llvm::raw_ostream &OS);
+  void writeFunctionsConcurrently(llvm::raw_ostream &OS);
+  void findReadOnlyArrays();
   const std::string &getGlobalInitRequires();
+  void writeGlobalInit(llvm::raw_ostream &OS, const bugle::GlobalInit &GI,
+                       const std::string &Array, const char *Separator);
+  void useType(const bugle::Type &t);
   void writeType(llvm::raw_ostream &OS, const bugle::Type &t);
-  void writeIntrinsic(std::function<void(llvm::raw_ostream &)> F,
-                      bool addSeparator = true);
+  void useIntrinsic(const BPLIntrinsic &I, Expr *Origin = 0);
+  void writeIntrinsic(llvm::raw_ostream &OS, const BPLIntrinsic &I,
+                      Expr *Origin);
   unsigned nextCandidateNumber();
   unsigned bitsRequiredForArrayBases();
   unsigned bitsRequiredForFunctionPointers();
@@ -41,10 +76,11 @@ class BPLModuleWriter : BPLExprWriter {
 public:
   BPLModuleWriter(llvm::raw_ostream &OS, bugle::Module *M,
                   bugle::IntegerRepresentation *IntRep,
-                  bugle::RaceInstrumenter RaceInst, bugle::SourceLocWriter *SLW)
+                  bugle::RaceInstrumenter RaceInst, bugle::SourceLocWriter *SLW,
+                  bool Stream = false, unsigned Threads = 1)
       : BPLExprWriter(this), OS(OS), M(M), IntRep(IntRep), RaceInst(RaceInst),
         SLW(SLW), UsesPointers(false), UsesFunctionPointers(false),
-        candidateNumber(0) {}
+        candidateNumber(0), Stream(Stream), PrePass(false), Threads(Threads) {}
 
   void write();
 
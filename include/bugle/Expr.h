@@ -1,9 +1,18 @@
+#include "bugle/GlobalArraySet.h"
 #include "bugle/Ref.h"
 #include "bugle/Type.h"
 #include "bugle/Var.h"
 #include "llvm/ADT/ArrayRef.h"
 #include "llvm/ADT/APInt.h"
+#include "llvm/ADT/DenseMap.h"
+#include "llvm/ADT/Hashing.h"
+#include "llvm/ADT/SmallVector.h"
+#include "llvm/Support/Allocator.h"
+#include <cstdint>
+#include <map>
+#include <memory>
 #include <set>
+#include <string>
 #include <vector>
 
 #ifndef BUGLE_EXPR_H
@@ -51,6 +60,8 @@ public:
     ArrayMemberOf,
     AtomicHasTakenValue,
     AsyncWorkGroupCopy,
+    VectorBinary,
+    VectorShuffle,
 
     // Unary
     Not,
@@ -147,9 +158,15 @@ public:
     BinaryLast = Implies
   };
 
-  unsigned refCount;
+  // Shares a word with the flags, which with the packed type keeps the header
+  // of a node to a vtable pointer and 64 bits.  An overflowing count is a
+  // fatal error, see klee::ref.
+  unsigned refCount : 30;
   bool preventEvalStmt : 1, hasEvalStmt : 1;
 
+  // The number of expressions created so far, for statistics.
+  static uint64_t createdCount;
+
   static ref<Expr> createPtrLt(ref<Expr> lhs, ref<Expr> rhs, Type defaultRange);
   static ref<Expr> createPtrLe(ref<Expr> lhs, ref<Expr> rhs, Type defaultRange);
   static ref<Expr> createFuncPtrLt(ref<Expr> lhs, ref<Expr> rhs);
@@ -162,27 +179,143 @@ public:
   static Type getArrayCandidateType(const std::set<GlobalArray *> &Globals);
   static Type getPointerRange(ref<Expr> pointer, Type defaultRange);
   bool computeArrayCandidates(std::set<GlobalArray *> &GlobalSet) const;
+  bool computeArrayCandidates(GlobalArraySet &GlobalSet) const;
 
 private:
   Type type;
 
 protected:
   Expr(Type type)
-      : refCount(0), preventEvalStmt(false), hasEvalStmt(false), type(type) {}
+      : refCount(0), preventEvalStmt(false), hasEvalStmt(false), type(type) {
+    ++createdCount;
+  }
 
 public:
   virtual ~Expr() {}
   virtual Kind getKind() const = 0;
+
+  static void *operator new(size_t size) { return ::operator new(size); }
+  // Allocates trailingSize further bytes after the node, for classes which
+  // store their operands inline.
+  static void *operator new(size_t size, size_t trailingSize) {
+    return ::operator new(size + trailingSize);
+  }
+  static void operator delete(void *ptr) { ::operator delete(ptr); }
   const Type &getType() const { return type; }
 
   static bool classof(const Expr *) { return true; }
 };
 
+// A table of expressions, through which structurally equal expressions
+// without side effects share a single node while the table is current.
+//
+// An expression with an EvalStmt is referred to by name wherever it is used,
+// and that name is only defined where the EvalStmt dominates.  Sharing is
+// therefore scoped to a table rather than global, and the translator makes a
+// table current only while translating straight-line code.
+class ExprUniqueTable {
+public:
+  // The kind of an expression followed by its constructor arguments, as built
+  // for a lookup.  Most expressions have at most three such fields, which are
+  // then held inline.
+  typedef llvm::SmallVector<uint64_t, 4> Key;
+
+  // Makes a table current for the lifetime of the scope.  A null table
+  // disables uniquing within the scope.
+  class Scope {
+    ExprUniqueTable *prev;
+
+  public:
+    Scope(ExprUniqueTable *table) : prev(current) { current = table; }
+    ~Scope() { current = prev; }
+  };
+
+private:
+  typedef llvm::ArrayRef<uint64_t> StoredKey;
+
+  // Every key starts with a kind, so no key of an expression is empty, and
+  // the empty and tombstone keys are told apart by their data.
+  struct KeyInfo {
+    static StoredKey getEmptyKey() {
+      return StoredKey(reinterpret_cast<const uint64_t *>(~uintptr_t(0)),
+                       size_t(0));
+    }
+    static StoredKey getTombstoneKey() {
+      return StoredKey(reinterpret_cast<const uint64_t *>(~uintptr_t(1)),
+                       size_t(0));
+    }
+    static unsigned getHashValue(StoredKey K) {
+      return llvm::hash_combine_range(K.begin(), K.end());
+    }
+    static bool isEqual(StoredKey LHS, StoredKey RHS) {
+      if (LHS.empty() || RHS.empty())
+        return LHS.empty() && RHS.empty() && LHS.data() == RHS.data();
+      return LHS == RHS;
+    }
+  };
+
+  // The keys are copied into storage which is released as a whole, and the
+  // expressions are held in the order they were created.  The order in which
+  // the table frees memory therefore does not follow the hashes of pointers,
+  // which would make later allocations, and so any output ordered by
+  // address, vary from run to run.
+  llvm::BumpPtrAllocator keyStorage;
+  llvm::DenseMap<StoredKey, Expr *, KeyInfo> exprs;
+  std::vector<ref<Expr>> nodes;
+  static ExprUniqueTable *current;
+
+public:
+  // Create an expression of class T, or return the existing node for it in
+  // the current table.
+  template <typename T, typename... Args>
+  static ref<Expr> create(const Args &... args);
+
+  // Allocate an expression of class T, with room after it for the operands
+  // which the class stores inline.
+  template <typename T, typename... Args>
+  static T *construct(const Args &... args);
+
+  void clear() {
+    exprs.clear();
+    nodes.clear();
+    keyStorage.Reset();
+  }
+  size_t size() const { return nodes.size(); }
+};
+
 #define EXPR_KIND(kind)                                                        \
+  friend class ExprUniqueTable;                                                \
+  static const Kind staticKind = kind;                                         \
   Kind getKind() const override { return kind; }                               \
   static bool classof(const Expr *E) { return E->getKind() == kind; }          \
   static bool classof(const kind##Expr *) { return true; }
 
+// Operands of type T stored inline after a node of class NodeT, in storage
+// allocated along with the node.
+template <typename NodeT, typename T> class TrailingOperands {
+  unsigned numOperands;
+
+  T *getOperandStorage() {
+    return reinterpret_cast<T *>(static_cast<NodeT *>(this) + 1);
+  }
+  const T *getOperandStorage() const {
+    return reinterpret_cast<const T *>(static_cast<const NodeT *>(this) + 1);
+  }
+
+protected:
+  TrailingOperands(llvm::ArrayRef<T> ops) : numOperands(ops.size()) {
+    std::uninitialized_copy(ops.begin(), ops.end(), getOperandStorage());
+  }
+  ~TrailingOperands() {
+    for (T *i = getOperandStorage(), *e = i + numOperands; i != e; ++i)
+      i->~T();
+  }
+
+  llvm::ArrayRef<T> getOperands() const {
+    return llvm::ArrayRef<T>(getOperandStorage(), numOperands);
+  }
+};
+
 class BVConstExpr : public Expr {
   BVConstExpr(const llvm::APInt &bv)
       : Expr(Type(Type::BV, bv.getBitWidth())), bv(bv) {}
@@ -228,17 +361,18 @@ public:
   EXPR_KIND(NullArrayRef)
 };
 
-class ConstantArrayRefExpr : public Expr {
+class ConstantArrayRefExpr
+    : public Expr,
+      public TrailingOperands<ConstantArrayRefExpr, ref<Expr>> {
   ConstantArrayRefExpr(llvm::ArrayRef<ref<Expr>> array)
       : Expr(Type(Type::ArrayOf, array[0]->getType())),
-        array(array.begin(), array.end()) {}
-  std::vector<ref<Expr>> array;
+        TrailingOperands(array) {}
 
 public:
   static ref<Expr> create(llvm::ArrayRef<ref<Expr>> array);
 
   EXPR_KIND(ConstantArrayRef)
-  const std::vector<ref<Expr>> &getArray() const { return array; }
+  llvm::ArrayRef<ref<Expr>> getArray() const { return getOperands(); }
 };
 
 class PointerExpr : public Expr {
@@ -251,8 +385,8 @@ public:
   static ref<Expr> create(ref<Expr> array, ref<Expr> offset);
 
   EXPR_KIND(Pointer)
-  ref<Expr> getArray() const { return array; }
-  ref<Expr> getOffset() const { return offset; }
+  const ref<Expr> &getArray() const { return array; }
+  const ref<Expr> &getOffset() const { return offset; }
 };
 
 class NullFunctionPointerExpr : public Expr {
@@ -266,15 +400,15 @@ public:
 };
 
 class FunctionPointerExpr : public Expr {
-  FunctionPointerExpr(std::string funcName, unsigned ptrWidth)
+  FunctionPointerExpr(const std::string *funcName, unsigned ptrWidth)
       : Expr(Type(Type::FunctionPointer, ptrWidth)), funcName(funcName) {}
-  std::string funcName;
+  const std::string *funcName;
 
 public:
-  static ref<Expr> create(std::string funcName, unsigned ptrWidth);
+  static ref<Expr> create(const std::string &funcName, unsigned ptrWidth);
 
   EXPR_KIND(FunctionPointer)
-  std::string getFuncName() const { return funcName; }
+  const std::string &getFuncName() const { return *funcName; }
 };
 
 class LoadExpr : public Expr {
@@ -288,20 +422,20 @@ public:
                           bool isTemporal);
 
   EXPR_KIND(Load)
-  ref<Expr> getArray() const { return array; }
-  ref<Expr> getOffset() const { return offset; }
+  const ref<Expr> &getArray() const { return array; }
+  const ref<Expr> &getOffset() const { return offset; }
   bool getIsTemporal() const { return isTemporal; }
 };
 
-class AtomicExpr : public Expr {
+class AtomicExpr : public Expr,
+                   public TrailingOperands<AtomicExpr, ref<Expr>> {
   AtomicExpr(Type t, ref<Expr> array, ref<Expr> offset,
-             std::vector<ref<Expr>> args, std::string function,
+             llvm::ArrayRef<ref<Expr>> args, const std::string *function,
              unsigned int parts, unsigned int part)
-      : Expr(t), array(array), offset(offset), args(args), function(function),
-        parts(parts), part(part) {}
+      : Expr(t), TrailingOperands(args), array(array), offset(offset),
+        function(function), parts(parts), part(part) {}
   ref<Expr> array, offset;
-  std::vector<ref<Expr>> args;
-  std::string function;
+  const std::string *function;
   unsigned int parts, part;
 
 public:
@@ -310,10 +444,10 @@ public:
                           unsigned int parts, unsigned int part);
 
   EXPR_KIND(Atomic)
-  ref<Expr> getArray() const { return array; }
-  ref<Expr> getOffset() const { return offset; }
-  std::vector<ref<Expr>> getArgs() const { return args; }
-  std::string getFunction() const { return function; }
+  const ref<Expr> &getArray() const { return array; }
+  const ref<Expr> &getOffset() const { return offset; }
+  llvm::ArrayRef<ref<Expr>> getArgs() const { return getOperands(); }
+  const std::string &getFunction() const { return *function; }
   unsigned int getParts() const { return parts; }
   unsigned int getPart() const { return part; }
 };
@@ -334,13 +468,13 @@ public:
 
 // A reference to the special variable marked with the given attribute.
 class SpecialVarRefExpr : public Expr {
-  std::string attr;
-  SpecialVarRefExpr(Type t, const std::string &attr) : Expr(t), attr(attr) {}
+  const std::string *attr;
+  SpecialVarRefExpr(Type t, const std::string *attr) : Expr(t), attr(attr) {}
 
 public:
   static ref<Expr> create(Type t, const std::string &attr);
   EXPR_KIND(SpecialVarRef)
-  const std::string &getAttr() const { return attr; }
+  const std::string &getAttr() const { return *attr; }
 };
 
 class BVExtractExpr : public Expr {
@@ -353,7 +487,7 @@ public:
   static ref<Expr> create(ref<Expr> expr, unsigned offset, unsigned width);
 
   EXPR_KIND(BVExtract)
-  ref<Expr> getSubExpr() const { return expr; }
+  const ref<Expr> &getSubExpr() const { return expr; }
   unsigned getOffset() const { return offset; }
 };
 
@@ -366,8 +500,8 @@ public:
   static ref<Expr> create(ref<Expr> val, ref<Expr> isZeroUndef);
 
   EXPR_KIND(BVCtlz)
-  ref<Expr> getVal() const { return val; }
-  ref<Expr> getIsZeroUndef() const { return isZeroUndef; }
+  const ref<Expr> &getVal() const { return val; }
+  const ref<Expr> &getIsZeroUndef() const { return isZeroUndef; }
 };
 
 class IfThenElseExpr : public Expr {
@@ -380,9 +514,9 @@ public:
   static ref<Expr> create(ref<Expr> cond, ref<Expr> trueExpr,
                           ref<Expr> falseExpr);
   EXPR_KIND(IfThenElse)
-  ref<Expr> getCond() const { return cond; }
-  ref<Expr> getTrueExpr() const { return trueExpr; }
-  ref<Expr> getFalseExpr() const { return falseExpr; }
+  const ref<Expr> &getCond() const { return cond; }
+  const ref<Expr> &getTrueExpr() const { return trueExpr; }
+  const ref<Expr> &getFalseExpr() const { return falseExpr; }
 };
 
 class HavocExpr : public Expr {
@@ -396,19 +530,21 @@ public:
 /// Expression which denotes that its subexpression is an arrayId and a member
 /// of the elems set.  This is an unusual expression in that it only shows
 /// up in the output indirectly via case splits.
-class ArrayMemberOfExpr : public Expr {
+class ArrayMemberOfExpr
+    : public Expr,
+      public TrailingOperands<ArrayMemberOfExpr, GlobalArray *> {
   ArrayMemberOfExpr(Type t, ref<Expr> expr,
-                    const std::set<GlobalArray *> &elems)
-      : Expr(t), expr(expr), elems(elems) {}
+                    llvm::ArrayRef<GlobalArray *> elems)
+      : Expr(t), TrailingOperands(elems), expr(expr) {}
   ref<Expr> expr;
-  std::set<GlobalArray *> elems;
 
 public:
   static ref<Expr> create(ref<Expr> expr, const std::set<GlobalArray *> &elems);
 
   EXPR_KIND(ArrayMemberOf)
-  ref<Expr> getSubExpr() const { return expr; }
-  const std::set<GlobalArray *> &getElems() const { return elems; }
+  const ref<Expr> &getSubExpr() const { return expr; }
+  // The members, in the order of the set they were created from.
+  llvm::ArrayRef<GlobalArray *> getElems() const { return getOperands(); }
 };
 
 class UnaryExpr : public Expr {
@@ -418,7 +554,7 @@ protected:
   UnaryExpr(Type type, ref<Expr> expr) : Expr(type), expr(expr) {}
 
 public:
-  ref<Expr> getSubExpr() const { return expr; }
+  const ref<Expr> &getSubExpr() const { return expr; }
   static bool classof(const Expr *E) {
     Kind k = E->getKind();
     return k >= UnaryFirst && k <= UnaryLast;
@@ -508,8 +644,8 @@ protected:
       : Expr(type), lhs(lhs), rhs(rhs) {}
 
 public:
-  ref<Expr> getLHS() const { return lhs; }
-  ref<Expr> getRHS() const { return rhs; }
+  const ref<Expr> &getLHS() const { return lhs; }
+  const ref<Expr> &getRHS() const { return rhs; }
   static bool classof(const Expr *E) {
     Kind k = E->getKind();
     return k >= BinaryFirst && k <= BinaryLast;
@@ -571,32 +707,31 @@ BINARY_EXPR(Implies)
 
 #undef BINARY_EXPR
 
-class CallExpr : public Expr {
-  CallExpr(Type t, Function *callee, const std::vector<ref<Expr>> &args)
-      : Expr(t), callee(callee), args(args) {}
+class CallExpr : public Expr, public TrailingOperands<CallExpr, ref<Expr>> {
+  CallExpr(Type t, Function *callee, llvm::ArrayRef<ref<Expr>> args)
+      : Expr(t), TrailingOperands(args), callee(callee) {}
   Function *callee;
-  std::vector<ref<Expr>> args;
 
 public:
   static ref<Expr> create(Function *callee, const std::vector<ref<Expr>> &args);
 
   EXPR_KIND(Call)
   Function *getCallee() const { return callee; }
-  const std::vector<ref<Expr>> &getArgs() const { return args; }
+  llvm::ArrayRef<ref<Expr>> getArgs() const { return getOperands(); }
 };
 
-class CallMemberOfExpr : public Expr {
-  CallMemberOfExpr(Type t, ref<Expr> func, std::vector<ref<Expr>> callExprs)
-      : Expr(t), func(func), callExprs(callExprs) {}
+class CallMemberOfExpr : public Expr,
+                         public TrailingOperands<CallMemberOfExpr, ref<Expr>> {
+  CallMemberOfExpr(Type t, ref<Expr> func, llvm::ArrayRef<ref<Expr>> callExprs)
+      : Expr(t), TrailingOperands(callExprs), func(func) {}
   ref<Expr> func;
-  std::vector<ref<Expr>> callExprs;
 
 public:
   static ref<Expr> create(ref<Expr> func, std::vector<ref<Expr>> &callExprs);
 
   EXPR_KIND(CallMemberOf)
-  ref<Expr> getFunc() const { return func; }
-  std::vector<ref<Expr>> getCallExprs() const { return callExprs; }
+  const ref<Expr> &getFunc() const { return func; }
+  llvm::ArrayRef<ref<Expr>> getCallExprs() const { return getOperands(); }
 };
 
 class AccessHasOccurredExpr : public Expr {
@@ -609,7 +744,7 @@ public:
   static ref<Expr> create(ref<Expr> array, bool isWrite);
 
   EXPR_KIND(AccessHasOccurred)
-  ref<Expr> getArray() const { return array; }
+  const ref<Expr> &getArray() const { return array; }
   std::string getAccessKind() { return isWrite ? "WRITE" : "READ"; }
 };
 
@@ -623,7 +758,7 @@ public:
   static ref<Expr> create(ref<Expr> array, unsigned pointerSize, bool isWrite);
 
   EXPR_KIND(AccessOffset)
-  ref<Expr> getArray() const { return array; }
+  const ref<Expr> &getArray() const { return array; }
   std::string getAccessKind() { return isWrite ? "WRITE" : "READ"; }
 };
 
@@ -637,8 +772,8 @@ public:
   static ref<Expr> create(ref<Expr> dst, ref<Expr> src);
 
   EXPR_KIND(ArraySnapshot)
-  ref<Expr> getDst() const { return dst; }
-  ref<Expr> getSrc() const { return src; }
+  const ref<Expr> &getDst() const { return dst; }
+  const ref<Expr> &getSrc() const { return src; }
 };
 
 class UnderlyingArrayExpr : public Expr {
@@ -649,7 +784,7 @@ public:
   static ref<Expr> create(ref<Expr> array);
 
   EXPR_KIND(UnderlyingArray)
-  ref<Expr> getArray() const { return array; }
+  const ref<Expr> &getArray() const { return array; }
 };
 
 class AddNoovflExpr : public Expr {
@@ -664,38 +799,42 @@ public:
   static ref<Expr> create(ref<Expr> first, ref<Expr> second, bool isSigned);
 
   EXPR_KIND(AddNoovfl)
-  ref<Expr> getFirst() const { return first; }
-  ref<Expr> getSecond() const { return second; }
+  const ref<Expr> &getFirst() const { return first; }
+  const ref<Expr> &getSecond() const { return second; }
   bool getIsSigned() const { return isSigned; }
 };
 
-class AddNoovflPredicateExpr : public Expr {
-  AddNoovflPredicateExpr(const std::vector<ref<Expr>> &exprs)
-      : Expr(Type(Type::BV, 1)), exprs(exprs) {}
-  std::vector<ref<Expr>> exprs;
+class AddNoovflPredicateExpr
+    : public Expr,
+      public TrailingOperands<AddNoovflPredicateExpr, ref<Expr>> {
+  AddNoovflPredicateExpr(llvm::ArrayRef<ref<Expr>> exprs)
+      : Expr(Type(Type::BV, 1)), TrailingOperands(exprs) {}
 
 public:
   static ref<Expr> create(const std::vector<ref<Expr>> &exprs);
 
   EXPR_KIND(AddNoovflPredicate)
-  const std::vector<ref<Expr>> &getExprs() const { return exprs; }
+  llvm::ArrayRef<ref<Expr>> getExprs() const { return getOperands(); }
 };
 
-class UninterpretedFunctionExpr : public Expr {
-  UninterpretedFunctionExpr(const std::string &name, Type returnType,
-                            const std::vector<ref<Expr>> &args)
-      : Expr(returnType), name(name), args(args) {}
-  const std::string name;
-  const std::vector<ref<Expr>> args;
+class UninterpretedFunctionExpr
+    : public Expr,
+      public TrailingOperands<UninterpretedFunctionExpr, ref<Expr>> {
+  UninterpretedFunctionExpr(const std::string *name, Type returnType,
+                            llvm::ArrayRef<ref<Expr>> args)
+      : Expr(returnType), TrailingOperands(args), name(name) {}
+  const std::string *name;
 
 public:
   static ref<Expr> create(const std::string &name, Type returnType,
                           const std::vector<ref<Expr>> &args);
 
   EXPR_KIND(UninterpretedFunction)
-  const std::string &getName() { return name; }
-  unsigned getNumOperands() const { return args.size(); }
-  ref<Expr> getOperand(unsigned index) const { return args[index]; }
+  const std::string &getName() { return *name; }
+  unsigned getNumOperands() const { return getOperands().size(); }
+  const ref<Expr> &getOperand(unsigned index) const {
+    return getOperands()[index];
+  }
 };
 
 class AtomicHasTakenValueExpr : public Expr {
@@ -712,9 +851,9 @@ public:
                           ref<Expr> value);
 
   EXPR_KIND(AtomicHasTakenValue)
-  ref<Expr> getArray() const { return atomicArray; }
-  ref<Expr> getOffset() const { return offset; }
-  ref<Expr> getValue() const { return value; }
+  const ref<Expr> &getArray() const { return atomicArray; }
+  const ref<Expr> &getOffset() const { return offset; }
+  const ref<Expr> &getValue() const { return value; }
 };
 
 class AsyncWorkGroupCopyExpr : public Expr {
@@ -734,15 +873,68 @@ public:
                           ref<Expr> srcOffset, ref<Expr> size,
                           ref<Expr> handle);
 
-  ref<Expr> getDst() const { return dst; }
-  ref<Expr> getDstOffset() const { return dstOffset; }
-  ref<Expr> getSrc() const { return src; }
-  ref<Expr> getSrcOffset() const { return srcOffset; }
-  ref<Expr> getSize() const { return size; }
-  ref<Expr> getHandle() const { return handle; }
+  const ref<Expr> &getDst() const { return dst; }
+  const ref<Expr> &getDstOffset() const { return dstOffset; }
+  const ref<Expr> &getSrc() const { return src; }
+  const ref<Expr> &getSrcOffset() const { return srcOffset; }
+  const ref<Expr> &getSize() const { return size; }
+  const ref<Expr> &getHandle() const { return handle; }
 
   EXPR_KIND(AsyncWorkGroupCopy)
 };
+
+// A binary operation applied lane-wise to two vectors, each represented as a
+// bitvector holding its lanes from the least significant bits up.  The vector
+// stays packed through translation, and is split into its lanes only when
+// written out.
+class VectorBinaryExpr : public Expr {
+  VectorBinaryExpr(Kind op, unsigned lanes, ref<Expr> lhs, ref<Expr> rhs)
+      : Expr(lhs->getType()), op(op), lanes(lanes), lhs(lhs), rhs(rhs) {}
+  Kind op;
+  unsigned lanes;
+  ref<Expr> lhs, rhs;
+
+public:
+  static ref<Expr> create(Kind op, unsigned lanes, ref<Expr> lhs,
+                          ref<Expr> rhs);
+  // Apply the operation of kind op to a single lane.
+  static ref<Expr> createLane(Kind op, ref<Expr> lhs, ref<Expr> rhs);
+
+  EXPR_KIND(VectorBinary)
+  Kind getOp() const { return op; }
+  unsigned getNumLanes() const { return lanes; }
+  unsigned getLaneWidth() const { return getType().width / lanes; }
+  const ref<Expr> &getLHS() const { return lhs; }
+  const ref<Expr> &getRHS() const { return rhs; }
+};
+
+// A vector whose lanes are picked from the lanes of two vectors, as by a
+// shufflevector instruction: mask values number the lanes of vec1 and then
+// those of vec2, and a negative mask value picks a zero lane.  Like
+// VectorBinaryExpr, the vector is split into its lanes only when written out.
+class VectorShuffleExpr
+    : public Expr,
+      public TrailingOperands<VectorShuffleExpr, int> {
+  VectorShuffleExpr(Type t, ref<Expr> vec1, ref<Expr> vec2,
+                    unsigned laneWidth, llvm::ArrayRef<int> mask)
+      : Expr(t), TrailingOperands(mask), vec1(vec1), vec2(vec2),
+        laneWidth(laneWidth) {}
+  ref<Expr> vec1, vec2;
+  unsigned laneWidth;
+
+public:
+  static ref<Expr> create(ref<Expr> vec1, ref<Expr> vec2, unsigned laneWidth,
+                          llvm::ArrayRef<int> mask);
+
+  EXPR_KIND(VectorShuffle)
+  const ref<Expr> &getVec1() const { return vec1; }
+  const ref<Expr> &getVec2() const { return vec2; }
+  unsigned getLaneWidth() const { return laneWidth; }
+  unsigned getNumVec1Lanes() const {
+    return vec1->getType().width / laneWidth;
+  }
+  llvm::ArrayRef<int> getMask() const { return getOperands(); }
+};
 }
 
 #undef EXPR_KIND
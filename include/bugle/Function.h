@@ -7,6 +7,8 @@
 #include "bugle/SourceLoc.h"
 #include "bugle/SpecificationInfo.h"
 #include "bugle/util/UniqueNameSet.h"
+#include <algorithm>
+#include <cassert>
 #include <vector>
 #include <set>
 #include <string>
@@ -24,6 +26,8 @@ class Function {
   OwningPtrVector<Var> args, returns, locals;
   UniqueNameSet bbNames, varNames;
 
+  friend class Module;
+
 public:
   Function(const std::string &name, const std::string &sourceName)
       : name(name), sourceName(sourceName), entryPoint(false),
@@ -33,6 +37,14 @@ public:
     blocks.push_back(BB);
     return BB;
   }
+  // Adds a block directly after pred, so that it is written after it.
+  BasicBlock *addBasicBlockAfter(BasicBlock *pred, const std::string &name) {
+    auto i = std::find(blocks.begin(), blocks.end(), pred);
+    assert(i != blocks.end() && "Block not in function");
+    BasicBlock *BB = new BasicBlock(bbNames.makeName(makeBoogieIdent(name)));
+    blocks.insert(std::next(i), BB);
+    return BB;
+  }
   Var *addArgument(Type t, const std::string &name) {
     Var *V = new Var(t, varNames.makeName(makeBoogieIdent(name)));
     args.push_back(V);
@@ -49,6 +61,25 @@ public:
     return V;
   }
   void addAttribute(const std::string &attrib) { attributes.insert(attrib); }
+  // Discards everything but the name of the function, so that it can be
+  // translated again.
+  void clear() {
+    attributes.clear();
+    entryPoint = specification = false;
+    requires.clear();
+    globalRequires.clear();
+    ensures.clear();
+    globalEnsures.clear();
+    modifies.clear();
+    procedureWideInvariant.clear();
+    procedureWideCandidateInvariant.clear();
+    blocks.clear();
+    args.clear();
+    returns.clear();
+    locals.clear();
+    bbNames = UniqueNameSet();
+    varNames = UniqueNameSet();
+  }
   void addRequires(ref<Expr> r, const SourceLocsRef &ss) {
     requires.push_back(new SpecificationInfo(r.get(), ss));
   }
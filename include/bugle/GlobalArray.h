@@ -3,12 +3,20 @@
 
 #include "bugle/Type.h"
 
+#include <algorithm>
 #include <set>
 #include <string>
+#include <vector>
 
 namespace bugle {
 
+class Module;
+
 class GlobalArray {
+  // The module which owns the array, and the dense index which that module
+  // gives it.
+  Module *module;
+  unsigned index;
   std::string name;
   Type rangeType;
   std::string sourceName;
@@ -17,13 +25,19 @@ class GlobalArray {
   bool zeroDimensionValid;
   std::set<std::string> attributes;
 
+  friend class Module;
+
 public:
   GlobalArray(const std::string &name, Type rangeType,
               const std::string &sourceName, Type sourceRangeType,
               std::vector<uint64_t> sourceDim, bool isParameter)
-      : name(name), rangeType(rangeType), sourceName(sourceName),
+      : module(nullptr), index(0), name(name), rangeType(rangeType),
+        sourceName(sourceName),
         sourceRangeType(sourceRangeType), sourceDim(sourceDim),
         zeroDimensionValid(!isParameter) {}
+
+  Module *getModule() const { return module; }
+  unsigned getIndex() const { return index; }
   const std::string &getName() const { return name; }
   Type getRangeType() const { return rangeType; }
   const std::string &getSourceName() const { return sourceName; }
@@ -0,0 +1,41 @@
+#ifndef BUGLE_GLOBALARRAYSET_H
+#define BUGLE_GLOBALARRAYSET_H
+
+#include "bugle/Type.h"
+#include "llvm/ADT/BitVector.h"
+#include <set>
+
+namespace bugle {
+
+class GlobalArray;
+class Module;
+
+// A set of arrays of a single module, and possibly the null pointer, as a bit
+// vector over the indices which the module gives its arrays.  The common
+// range type of the arrays is maintained as the set grows, so that it need
+// not be recomputed by each query.
+class GlobalArraySet {
+  const Module *module;
+  llvm::BitVector arrays;
+  bool null;
+  Type rangeType;
+
+  void addRangeType(Type t);
+
+public:
+  GlobalArraySet() : module(nullptr), null(false), rangeType(Type::Any) {}
+
+  void insert(GlobalArray *array);
+  void insert(const GlobalArraySet &other);
+
+  bool empty() const { return !null && arrays.none(); }
+  bool containsNull() const { return null; }
+  // The range type of the arrays as given by Expr::getArrayCandidateType.
+  Type getRangeType() const { return rangeType; }
+
+  // Add the arrays, and null if present, to Set.
+  void getArrays(std::set<GlobalArray *> &Set) const;
+};
+}
+
+#endif
@@ -2,28 +2,52 @@
 #define BUGLE_INTEGERREPRESENTATION_H
 
 #include "bugle/Expr.h"
+#include "llvm/ADT/STLExtras.h"
+#include "llvm/ADT/StringRef.h"
+#include "llvm/Support/RWMutex.h"
+#include <map>
+#include <string>
 
 namespace bugle {
 
 class IntegerRepresentation {
+  std::map<unsigned, std::string> Types, LiteralSuffixes;
+  // Functions may be written concurrently, sharing the representation.
+  llvm::sys::SmartRWMutex<true> Lock;
+
+protected:
+  virtual std::string makeType(unsigned bitWidth) = 0;
+  virtual std::string makeLiteralSuffix(unsigned bitWidth) = 0;
+
 public:
-  virtual std::string getType(unsigned bitWidth) = 0;
-  virtual std::string getLiteral(unsigned literal, unsigned bitWidth) = 0;
-  virtual std::string getLiteralSuffix(unsigned bitWidth) = 0;
-  virtual std::string getZeroExtend(unsigned FromWidth, unsigned ToWidth) = 0;
-  virtual std::string getSignExtend(unsigned FromWidth, unsigned ToWidth) = 0;
-  virtual std::string getExtract() = 0;
-  virtual std::string getExtractExpr(const std::string &Expr, unsigned UpperBit,
-                                     unsigned LowerBit) = 0;
-  virtual std::string getConcat() = 0;
-  virtual std::string getConcatExpr(const std::string &Lhs,
-                                    const std::string &Rhs) = 0;
-  virtual std::string getCtlz(unsigned Width) = 0;
-  virtual std::string getArithmeticBinary(std::string Name,
-                                          bugle::Expr::Kind Kind,
-                                          unsigned Width) = 0;
-  virtual std::string getBooleanBinary(std::string Name, bugle::Expr::Kind Kind,
-                                       unsigned Width) = 0;
+  // Writes an operand of an expression.  Operands are written straight into
+  // the output rather than rendered into strings first, as extracts and
+  // concatenations nest deeply.
+  typedef llvm::function_ref<void(llvm::raw_ostream &)> OperandWriter;
+
+  // Type names and literal suffixes are made once for each width.
+  const std::string &getType(unsigned bitWidth);
+  const std::string &getLiteralSuffix(unsigned bitWidth);
+  void writeLiteral(llvm::raw_ostream &OS, uint64_t literal,
+                    unsigned bitWidth);
+
+  virtual void writeZeroExtend(llvm::raw_ostream &OS, unsigned FromWidth,
+                               unsigned ToWidth) = 0;
+  virtual void writeSignExtend(llvm::raw_ostream &OS, unsigned FromWidth,
+                               unsigned ToWidth) = 0;
+  virtual void writeExtract(llvm::raw_ostream &OS) = 0;
+  virtual void writeExtractExpr(llvm::raw_ostream &OS, OperandWriter Expr,
+                                unsigned UpperBit, unsigned LowerBit) = 0;
+  virtual void writeConcat(llvm::raw_ostream &OS) = 0;
+  virtual void writeConcatExpr(llvm::raw_ostream &OS, OperandWriter Lhs,
+                               OperandWriter Rhs) = 0;
+  virtual void writeCtlz(llvm::raw_ostream &OS, unsigned Width) = 0;
+  virtual void writeArithmeticBinary(llvm::raw_ostream &OS,
+                                     llvm::StringRef Name,
+                                     bugle::Expr::Kind Kind,
+                                     unsigned Width) = 0;
+  virtual void writeBooleanBinary(llvm::raw_ostream &OS, llvm::StringRef Name,
+                                  bugle::Expr::Kind Kind, unsigned Width) = 0;
   virtual void printVal(llvm::raw_ostream &OS, const llvm::APInt &Val) = 0;
   virtual bool abstractsExtract() = 0;
   virtual bool abstractsConcat() = 0;
@@ -32,46 +56,52 @@ public:
 };
 
 class BVIntegerRepresentation : public IntegerRepresentation {
+protected:
+  std::string makeType(unsigned bitWidth) override;
+  std::string makeLiteralSuffix(unsigned bitWidth) override;
+
 public:
-  std::string getType(unsigned bitWidth) override;
-  std::string getLiteralSuffix(unsigned bitWidth) override;
-  std::string getLiteral(unsigned literal, unsigned bitWidth) override;
-  std::string getZeroExtend(unsigned FromWidth, unsigned ToWidth) override;
-  std::string getSignExtend(unsigned FromWidth, unsigned ToWidth) override;
-  std::string getExtract() override;
-  std::string getExtractExpr(const std::string &Expr, unsigned UpperBit,
-                             unsigned LowerBit) override;
-  std::string getConcat() override;
-  std::string getConcatExpr(const std::string &Lhs,
-                            const std::string &Rhs) override;
-  std::string getCtlz(unsigned Width) override;
-  std::string getArithmeticBinary(std::string Name, bugle::Expr::Kind Kind,
-                                  unsigned Width) override;
-  std::string getBooleanBinary(std::string Name, bugle::Expr::Kind Kind,
-                               unsigned Width) override;
+  void writeZeroExtend(llvm::raw_ostream &OS, unsigned FromWidth,
+                       unsigned ToWidth) override;
+  void writeSignExtend(llvm::raw_ostream &OS, unsigned FromWidth,
+                       unsigned ToWidth) override;
+  void writeExtract(llvm::raw_ostream &OS) override;
+  void writeExtractExpr(llvm::raw_ostream &OS, OperandWriter Expr,
+                        unsigned UpperBit, unsigned LowerBit) override;
+  void writeConcat(llvm::raw_ostream &OS) override;
+  void writeConcatExpr(llvm::raw_ostream &OS, OperandWriter Lhs,
+                       OperandWriter Rhs) override;
+  void writeCtlz(llvm::raw_ostream &OS, unsigned Width) override;
+  void writeArithmeticBinary(llvm::raw_ostream &OS, llvm::StringRef Name,
+                             bugle::Expr::Kind Kind, unsigned Width) override;
+  void writeBooleanBinary(llvm::raw_ostream &OS, llvm::StringRef Name,
+                          bugle::Expr::Kind Kind, unsigned Width) override;
   void printVal(llvm::raw_ostream &OS, const llvm::APInt &Val) override;
   bool abstractsExtract() override;
   bool abstractsConcat() override;
 };
 
 class MathIntegerRepresentation : public IntegerRepresentation {
+protected:
+  std::string makeType(unsigned bitWidth) override;
+  std::string makeLiteralSuffix(unsigned bitWidth) override;
+
 public:
-  std::string getType(unsigned bitWidth) override;
-  std::string getLiteralSuffix(unsigned bitWidth) override;
-  std::string getLiteral(unsigned literal, unsigned bitWidth) override;
-  std::string getZeroExtend(unsigned FromWidth, unsigned ToWidth) override;
-  std::string getSignExtend(unsigned FromWidth, unsigned ToWidth) override;
-  std::string getExtract() override;
-  std::string getExtractExpr(const std::string &Expr, unsigned UpperBit,
-                             unsigned LowerBit) override;
-  std::string getConcat() override;
-  std::string getConcatExpr(const std::string &Lhs,
-                            const std::string &Rhs) override;
-  std::string getCtlz(unsigned Width) override;
-  std::string getArithmeticBinary(std::string Name, bugle::Expr::Kind Kind,
-                                  unsigned Width) override;
-  std::string getBooleanBinary(std::string Name, bugle::Expr::Kind Kind,
-                               unsigned Width) override;
+  void writeZeroExtend(llvm::raw_ostream &OS, unsigned FromWidth,
+                       unsigned ToWidth) override;
+  void writeSignExtend(llvm::raw_ostream &OS, unsigned FromWidth,
+                       unsigned ToWidth) override;
+  void writeExtract(llvm::raw_ostream &OS) override;
+  void writeExtractExpr(llvm::raw_ostream &OS, OperandWriter Expr,
+                        unsigned UpperBit, unsigned LowerBit) override;
+  void writeConcat(llvm::raw_ostream &OS) override;
+  void writeConcatExpr(llvm::raw_ostream &OS, OperandWriter Lhs,
+                       OperandWriter Rhs) override;
+  void writeCtlz(llvm::raw_ostream &OS, unsigned Width) override;
+  void writeArithmeticBinary(llvm::raw_ostream &OS, llvm::StringRef Name,
+                             bugle::Expr::Kind Kind, unsigned Width) override;
+  void writeBooleanBinary(llvm::raw_ostream &OS, llvm::StringRef Name,
+                          bugle::Expr::Kind Kind, unsigned Width) override;
   void printVal(llvm::raw_ostream &OS, const llvm::APInt &Val) override;
   bool abstractsExtract() override;
   bool abstractsConcat() override;
@@ -5,8 +5,11 @@
 #include "bugle/GlobalArray.h"
 #include "bugle/Ident.h"
 #include "bugle/OwningPtrVector.h"
+#include "bugle/StringTable.h"
 #include "bugle/util/UniqueNameSet.h"
 #include "bugle/Ref.h"
+#include <memory>
+#include <set>
 
 namespace bugle {
 
@@ -16,8 +19,12 @@ struct GlobalInit {
   GlobalArray *array;
   uint64_t offset;
   ref<Expr> init;
-  GlobalInit(GlobalArray *array, uint64_t offset, ref<Expr> init)
-      : array(array), offset(offset), init(init) {}
+  // The number of consecutive elements, starting at offset, initialised to
+  // init.
+  uint64_t count;
+  GlobalInit(GlobalArray *array, uint64_t offset, ref<Expr> init,
+             uint64_t count = 1)
+      : array(array), offset(offset), init(init), count(count) {}
 };
 
 class Module {
@@ -25,10 +32,17 @@ class Module {
   OwningPtrVector<Function> functions;
   OwningPtrVector<GlobalArray> globals;
   std::vector<GlobalInit> globalInits;
+  std::vector<ref<Expr>> instrumentedArrays;
   UniqueNameSet functionNames, globalNames;
   unsigned pointerWidth;
+  // Shared with the modules of the other rounds of a translation, whose
+  // expressions may be carried over into this one.
+  std::shared_ptr<StringTable> strings;
 
 public:
+  Module() : strings(std::make_shared<StringTable>()) {}
+  Module(std::shared_ptr<StringTable> strings) : strings(strings) {}
+
   Function *addFunction(const std::string &name,
                         const std::string &sourceName) {
     Function *F =
@@ -44,10 +58,18 @@ public:
     GlobalArray *GA =
         new GlobalArray(globalNames.makeName(makeBoogieIdent(name)), rangeType,
                         sourceName, sourceRangeType, sourceDim, isParameter);
+    GA->module = this;
+    GA->index = globals.size();
     globals.push_back(GA);
     return GA;
   }
 
+  // Moves the given functions, or an array, of the module of an earlier
+  // translation round into this one, renaming them if their names are
+  // already taken.
+  void adoptFunctions(Module &from, const std::set<Function *> &fns);
+  void adoptGlobal(Module &from, GlobalArray *GA);
+
   OwningPtrVector<Function>::const_iterator function_begin() const {
     return functions.begin();
   }
@@ -67,6 +89,7 @@ public:
   OwningPtrVector<GlobalArray>::size_type global_size() const {
     return globals.size();
   }
+  GlobalArray *getGlobal(unsigned index) const { return globals[index]; }
 
   std::vector<GlobalInit>::const_iterator global_init_begin() const {
     return globalInits.begin();
@@ -75,6 +98,13 @@ public:
     return globalInits.end();
   }
 
+  std::vector<ref<Expr>>::const_iterator instrumented_array_begin() const {
+    return instrumentedArrays.begin();
+  }
+  std::vector<ref<Expr>>::const_iterator instrumented_array_end() const {
+    return instrumentedArrays.end();
+  }
+
   std::vector<ref<Expr>>::const_iterator axiom_begin() const {
     return axioms.begin();
   }
@@ -82,12 +112,20 @@ public:
     return axioms.end();
   }
 
+  const std::shared_ptr<StringTable> &getStringTable() const { return strings; }
+
   unsigned getPointerWidth() const { return pointerWidth; }
   void setPointerWidth(unsigned pw) { pointerWidth = pw; }
 
   void addAxiom(ref<Expr> axiom) { axioms.push_back(axiom); }
-  void addGlobalInit(GlobalArray *array, uint64_t offset, ref<Expr> init) {
-    globalInits.push_back(GlobalInit(array, offset, init));
+  // Initialises count elements of array from offset to init, extending the
+  // previous initialiser if it ends at offset with an equal constant.
+  void addGlobalInit(GlobalArray *array, uint64_t offset, ref<Expr> init,
+                     uint64_t count = 1);
+  // Records an array whose race instrumentation state a specification refers
+  // to, so that the state is declared even if the array is never written.
+  void addInstrumentedArray(ref<Expr> array) {
+    instrumentedArrays.push_back(array);
   }
 };
 }
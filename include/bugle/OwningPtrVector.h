@@ -15,6 +15,10 @@ public:
   ~OwningPtrVector() {
     std::for_each(this->rbegin(), this->rend(), [](T *p) { delete p; });
   }
+  void clear() {
+    std::for_each(this->rbegin(), this->rend(), [](T *p) { delete p; });
+    std::vector<T *>::clear();
+  }
 };
 }
 
@@ -0,0 +1,100 @@
+#ifndef BUGLE_PREPROCESSING_POINTERMODELANALYSISPASS_H
+#define BUGLE_PREPROCESSING_POINTERMODELANALYSISPASS_H
+
+#include "bugle/Type.h"
+#include "bugle/Translator/TranslateModule.h"
+#include "llvm/Pass.h"
+#include "llvm/IR/DataLayout.h"
+#include "llvm/IR/Operator.h"
+#include <map>
+#include <set>
+
+namespace llvm {
+
+class raw_ostream;
+}
+
+namespace bugle {
+
+// Predicts, from the IR alone, the pointer models which the translator would
+// otherwise discover over several rounds of its fixed point.  The prediction
+// is conservative: only arrays which the translator will certainly model as
+// byte arrays, and only phi nodes and function return values which it will
+// certainly be able to model as offsets into a single array, are reported.
+class PointerModelAnalysisPass : public llvm::ModulePass {
+private:
+  struct Provenance {
+    enum Kind { None, Known, Unknown };
+
+    Kind K;
+    // The arrays the pointer may refer to, and whether it may be null.
+    std::set<llvm::Value *> Arrays;
+    bool MayBeNull;
+    // The largest power of two dividing each term of the offset, or zero if
+    // the offset has no non-zero terms.
+    uint64_t Alignment;
+    // Whether the pointer is computed from an array without passing through
+    // a phi node or a call, and if so whether its offset is a constant.
+    bool Direct;
+    bool ConstantOffset;
+    uint64_t Offset;
+
+    Provenance()
+        : K(None), MayBeNull(false), Alignment(0), Direct(false),
+          ConstantOffset(false), Offset(0) {}
+  };
+
+  llvm::Module *M;
+  const llvm::DataLayout *TD;
+  TranslateModule::SourceLanguage SL;
+  std::set<std::string> GPUEntryPoints;
+
+  std::map<llvm::Value *, Provenance> Models;
+  std::set<llvm::Value *> ByteArrayModels;
+  std::map<llvm::Value *, std::set<llvm::Value *>> GlobalOffsetModels;
+  std::set<llvm::Value *> MayBeNull;
+
+  bugle::Type getRangeType(llvm::Type *T);
+  bugle::Type getArrayRangeType(llvm::Value *V);
+  bool isArray(llvm::Value *V);
+  bool isTranslated(llvm::Function &F);
+  Provenance getProvenance(llvm::Value *V);
+  Provenance getGEPProvenance(llvm::GEPOperator *GEP);
+  bool computeModels();
+  bool isModelled(Provenance &P);
+  void computeByteArrayModel(llvm::Value *Ptr, llvm::Type *AccessTy);
+
+public:
+  static char ID;
+
+  PointerModelAnalysisPass(TranslateModule::SourceLanguage SL,
+                           std::set<std::string> &EP)
+      : ModulePass(ID), M(0), TD(0), SL(SL), GPUEntryPoints(EP) {}
+
+  llvm::StringRef getPassName() const override {
+    return "Pointer model analysis";
+  }
+
+  void getAnalysisUsage(llvm::AnalysisUsage &AU) const override {
+    AU.setPreservesAll();
+  }
+
+  bool runOnModule(llvm::Module &M) override;
+
+  const std::set<llvm::Value *> &getByteArrayModels() const {
+    return ByteArrayModels;
+  }
+  const std::map<llvm::Value *, std::set<llvm::Value *>> &
+  getGlobalOffsetModels() const {
+    return GlobalOffsetModels;
+  }
+  const std::set<llvm::Value *> &getMayBeNull() const { return MayBeNull; }
+
+  // Check that the fixed point of TM, which translated the module without the
+  // predicted models, arrived at each of them.  The models it did not arrive
+  // at are written to OS.
+  bool checkModels(const TranslateModule &TM, llvm::raw_ostream &OS) const;
+};
+}
+
+#endif
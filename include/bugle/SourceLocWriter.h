@@ -2,21 +2,59 @@
 #define BUGLE_SOURCELOCWRITER_H
 
 #include "bugle/SourceLoc.h"
+#include <cstdint>
+#include <string>
+#include <unordered_map>
+#include <vector>
 
 namespace llvm {
 
+class raw_ostream;
 class ToolOutputFile;
 }
 
 namespace bugle {
 
+// Numbers chains of source locations and writes each distinct chain once, as
+// a group of records, the group numbered N being the Nth in the file.  Chains
+// are recognised by identity and then by value.
+//
+// When interning strings, the file starts with a table of the file names and
+// paths, each terminated by a unit separator, which is enclosed in file
+// separators, and the records give the index of the strings in the table.
+// The binary format, described with SourceLocReader, also interns strings, and
+// indexes the chains by number.
 class SourceLocWriter {
-  llvm::ToolOutputFile *L;
-  unsigned SourceLocCounter;
+  llvm::raw_ostream *OS;
+  std::vector<SourceLocsRef> Numbered;
+  std::unordered_map<SourceLocsRef, unsigned> NumbersByIdentity;
+  std::unordered_map<std::string, unsigned> NumbersByValue;
+
+  // The interned strings, and the records written once the table of strings
+  // is complete, together with the index of the first record of each chain
+  // when writing the binary format.
+  bool Intern, Binary;
+  std::unordered_map<std::string, unsigned> StringIds;
+  std::vector<const std::string *> Strings;
+  std::string Records;
+  std::vector<uint32_t> ChainStarts;
+
+  unsigned intern(const std::string &S);
+  void writeBinary();
 
 public:
-  SourceLocWriter(llvm::ToolOutputFile *L) : L(L), SourceLocCounter(0) {}
+  SourceLocWriter(llvm::ToolOutputFile *L);
+  // Numbers chains without writing them.
+  SourceLocWriter() : OS(nullptr), Intern(false), Binary(false) {}
+
+  // Whether the file is written in the binary format.
+  static bool writesBinary();
+
   unsigned writeSourceLocs(const SourceLocsRef &sourcelocs);
+  // The chains in the order they were numbered.
+  const std::vector<SourceLocsRef> &getSourceLocs() const { return Numbered; }
+  // Writes what is held back until all the chains are known.
+  void finish();
 };
 }
 
@@ -18,7 +18,7 @@ private:
 public:
   SpecificationInfo(Expr *expr, const SourceLocsRef &sourcelocs)
       : expr(expr), sourcelocs(sourcelocs) {}
-  ref<Expr> getExpr() const { return expr; }
+  const ref<Expr> &getExpr() const { return expr; }
   const SourceLocsRef &getSourceLocs() const { return sourcelocs; }
 };
 }
@@ -25,7 +25,8 @@ public:
     Assert,
     Call,
     CallMemberOf,
-    WaitGroupEvent
+    WaitGroupEvent,
+    AssumeElements
   };
 
   virtual ~Stmt() {}
@@ -55,7 +56,7 @@ public:
   ~EvalStmt();
 
   STMT_KIND(Eval)
-  ref<Expr> getExpr() const { return expr; }
+  const ref<Expr> &getExpr() const { return expr; }
 };
 
 class StoreStmt : public Stmt {
@@ -71,9 +72,9 @@ public:
                            const SourceLocsRef &sourcelocs);
 
   STMT_KIND(Store)
-  ref<Expr> getArray() const { return array; }
-  ref<Expr> getOffset() const { return offset; }
-  ref<Expr> getValue() const { return value; }
+  const ref<Expr> &getArray() const { return array; }
+  const ref<Expr> &getOffset() const { return offset; }
+  const ref<Expr> &getValue() const { return value; }
 };
 
 class VarAssignStmt : public Stmt {
@@ -137,7 +138,7 @@ public:
   }
 
   STMT_KIND(Assume)
-  ref<Expr> getPredicate() const { return pred; }
+  const ref<Expr> &getPredicate() const { return pred; }
   bool isPartition() const { return partition; }
 };
 
@@ -162,7 +163,7 @@ public:
   static AssertStmt *createBlockSourceLoc(const SourceLocsRef &sourcelocs);
 
   STMT_KIND(Assert)
-  ref<Expr> getPredicate() const { return pred; }
+  const ref<Expr> &getPredicate() const { return pred; }
   bool isGlobal() const { return global; }
   bool isCandidate() const { return candidate; }
   bool isInvariant() const { return invariant; }
@@ -199,7 +200,7 @@ public:
                                   const SourceLocsRef &sourcelocs);
 
   STMT_KIND(CallMemberOf)
-  ref<Expr> getFunc() const { return func; }
+  const ref<Expr> &getFunc() const { return func; }
   std::vector<Stmt *> getCallStmts() const { return callStmts; }
 };
 
@@ -213,7 +214,45 @@ public:
                                     const SourceLocsRef &sourcelocs);
 
   STMT_KIND(WaitGroupEvent)
-  ref<Expr> getHandle() const { return handle; }
+  const ref<Expr> &getHandle() const { return handle; }
+};
+
+// Assumes that the count elements of an array from an offset on are equal to
+// a value, or to the corresponding elements of a source array.  This states
+// the effect of a loop writing the elements, which is otherwise lost as the
+// verifier havocs the array at the head of the loop.
+class AssumeElementsStmt : public Stmt {
+  AssumeElementsStmt(ref<Expr> array, ref<Expr> offset, ref<Expr> count,
+                     ref<Expr> value, ref<Expr> srcArray, ref<Expr> srcOffset)
+      : array(array), offset(offset), count(count), value(value),
+        srcArray(srcArray), srcOffset(srcOffset) {}
+  ref<Expr> array;
+  ref<Expr> offset;
+  ref<Expr> count;
+  ref<Expr> value;
+  ref<Expr> srcArray;
+  ref<Expr> srcOffset;
+
+public:
+  static AssumeElementsStmt *createFill(ref<Expr> array, ref<Expr> offset,
+                                        ref<Expr> count, ref<Expr> value);
+  static AssumeElementsStmt *createCopy(ref<Expr> array, ref<Expr> offset,
+                                        ref<Expr> count, ref<Expr> srcArray,
+                                        ref<Expr> srcOffset);
+
+  SourceLocsRef &getSourceLocs() override {
+    llvm_unreachable("No source location");
+  }
+
+  STMT_KIND(AssumeElements)
+  const ref<Expr> &getArray() const { return array; }
+  const ref<Expr> &getOffset() const { return offset; }
+  const ref<Expr> &getCount() const { return count; }
+  // The value of each element, or null for a copy.
+  const ref<Expr> &getValue() const { return value; }
+  // The source array and offset of a copy, or null.
+  const ref<Expr> &getSrcArray() const { return srcArray; }
+  const ref<Expr> &getSrcOffset() const { return srcOffset; }
 };
 }
 
@@ -0,0 +1,34 @@
+#ifndef BUGLE_STRINGTABLE_H
+#define BUGLE_STRINGTABLE_H
+
+#include <mutex>
+#include <set>
+#include <string>
+
+namespace bugle {
+
+// A table of interned strings, through which expressions share the names of
+// functions and attributes.  Expressions intern their strings in the current
+// table, which is owned by the modules referring to it.
+class StringTable {
+  std::mutex mutex;
+  std::set<std::string> strings;
+  static StringTable *current;
+
+public:
+  // Makes a table current for the lifetime of the scope.
+  class Scope {
+    StringTable *prev;
+
+  public:
+    Scope(StringTable *table) : prev(current) { current = table; }
+    ~Scope() { current = prev; }
+  };
+
+  // Returns the copy of s in the current table, which lives as long as the
+  // table does.
+  static const std::string *intern(const std::string &s);
+};
+}
+
+#endif
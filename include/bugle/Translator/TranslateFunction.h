@@ -48,10 +48,17 @@ class TranslateFunction {
   std::map<llvm::PHINode *, std::vector<PhiPair>> PhiAssignsMap;
   Var *ReturnVar;
   std::vector<ref<Expr>> ReturnVals;
+  // The first branch assigning each phi node, and the first return of a value,
+  // to which the trace attributes the models of the phi node and return value.
+  std::map<llvm::PHINode *, llvm::Instruction *> PhiAssignCauses;
+  llvm::Instruction *ReturnCause;
   bool LoadsAreTemporal;
   std::map<unsigned, bugle::Function *> BarrierInvariants;
   std::map<unsigned, bugle::Function *> BinaryBarrierInvariants;
   SourceLocsRef currentSourceLocs;
+  // The block in which translation continues after the current instruction,
+  // if translating it ended the current block.
+  BasicBlock *NextBBB;
 
   SpecialFnMapTy &SpecialFunctionMap;
   static SpecialFnMapTy SpecialFunctionMaps[TranslateModule::SL_Count];
@@ -101,12 +108,16 @@ class TranslateFunction {
   ref<Expr> translateValue(llvm::Value *V, bugle::BasicBlock *BBB);
   void translateBasicBlock(BasicBlock *BBB, llvm::BasicBlock *BB);
   void translateInstruction(BasicBlock *BBB, llvm::Instruction *I);
+  void translateTracedInstruction(BasicBlock *BBB, llvm::Instruction *I);
   Var *getPhiVariable(llvm::PHINode *PN);
   void computeClosure(std::vector<PhiPair> &currentAssigns,
                       std::set<llvm::PHINode *> &foundPhiNodes,
                       std::vector<ref<Expr>> &assigns);
   void addPhiAssigns(BasicBlock *BBB, llvm::BasicBlock *Pred,
                      llvm::BasicBlock *Succ);
+  BasicBlock *addElementWrites(
+      BasicBlock *BBB, ref<Expr> Count,
+      const std::function<void(BasicBlock *, ref<Expr>)> &WriteElement);
   SourceLocsRef extractSourceLocsForBlock(llvm::BasicBlock *BB);
   SourceLocsRef extractSourceLocs(llvm::Instruction *I);
   void specifyZeroDimensions(unsigned PtrArgs);
@@ -119,7 +130,8 @@ public:
   TranslateFunction(TranslateModule *TM, bugle::Function *BF, llvm::Function *F,
                     bool isGPUEntryPoint)
       : TM(TM), BF(BF), F(F), isGPUEntryPoint(isGPUEntryPoint), ReturnVar(0),
-        LoadsAreTemporal(true), currentSourceLocs(new SourceLocs),
+        ReturnCause(nullptr), LoadsAreTemporal(true),
+        currentSourceLocs(new SourceLocs), NextBBB(nullptr),
         SpecialFunctionMap(initSpecialFunctionMap(TM->SL)) {}
 
   static bool isSpecialFunction(TranslateModule::SourceLanguage SL,
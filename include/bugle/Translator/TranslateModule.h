@@ -1,12 +1,16 @@
 #ifndef BUGLE_TRANSLATOR_TRANSLATEMODULE_H
 #define BUGLE_TRANSLATOR_TRANSLATEMODULE_H
 
+#include "bugle/Expr.h"
 #include "bugle/RaceInstrumenter.h"
 #include "bugle/Ref.h"
 #include "bugle/SourceLoc.h"
 #include "bugle/Type.h"
+#include "bugle/Translator/TranslationTrace.h"
 #include "klee/util/GetElementPtrTypeIterator.h"
 #include "llvm/ADT/ArrayRef.h"
+#include "llvm/ADT/MapVector.h"
+#include "llvm/ADT/SetVector.h"
 #include "llvm/IR/DataLayout.h"
 #include "llvm/IR/DebugInfo.h"
 #include <functional>
@@ -32,6 +36,7 @@ class Function;
 class GlobalArray;
 class Module;
 class Stmt;
+class TranslateFunction;
 class Var;
 
 typedef std::vector<std::pair<bool, uint64_t>> ArraySpec;
@@ -68,6 +73,10 @@ private:
   std::map<llvm::Function *, bugle::Function *> FunctionMap;
   std::map<llvm::Function *, std::vector<llvm::Instruction *> *> StructMap;
   std::map<llvm::Constant *, ref<Expr>> ConstantMap;
+  std::map<llvm::Constant *, bool> RoundInvariantConstants;
+  ExprUniqueTable ConstantExprs;
+  std::map<llvm::Type *, Type> TypeMap, ArrayRangeTypeMap,
+      SourceArrayRangeTypeMap;
 
   std::map<GlobalArray *, llvm::Value *> GlobalValueMap;
   std::map<llvm::Value *, GlobalArray *> ValueGlobalMap;
@@ -76,13 +85,67 @@ private:
   std::set<llvm::Value *> ModelAsByteArray;
   bool ModelAllAsByteArray, NextModelAllAsByteArray;
 
-  std::map<llvm::Function *, std::vector<const std::vector<ref<Expr>> *>>
-      CallSites;
+  // A call of a function, and the arguments it passes.
+  typedef std::pair<llvm::Instruction *, llvm::ArrayRef<ref<Expr>>> CallArgs;
+  std::map<llvm::Function *, std::vector<CallArgs>> CallSites;
   bool NeedAdditionalGlobalOffsetModels;
   std::map<llvm::Value *, std::set<llvm::Value *>> ModelPtrAsGlobalOffset,
       NextModelPtrAsGlobalOffset;
   std::set<llvm::Value *> PtrMayBeNull, NextPtrMayBeNull;
 
+  // Model inputs read, and model effects produced, by the translation of a
+  // single function.  Used to skip the re-translation of functions whose
+  // inputs did not change between fixed-point rounds.
+  struct ModelDependencies {
+    unsigned Version = 0;
+    llvm::MapVector<llvm::Value *, unsigned> Arrays;
+    std::set<llvm::Value *> Pointers;
+    std::vector<std::pair<llvm::Function *, CallArgs>> CallSites;
+    bool NeedAdditionalByteArrayModels = false;
+    bool NeedAdditionalGlobalOffsetModels = false;
+    bool NextModelAllAsByteArray = false;
+    // Effects on the module, which are repeated when the translation of the
+    // function is carried over into a later round.
+    llvm::SetVector<llvm::Constant *> Constants;
+    std::vector<std::pair<llvm::Value *, llvm::Constant *>> ArrayInits;
+    std::vector<ref<Expr>> InstrumentedArrays;
+    std::set<bugle::Function *> HelperFunctions;
+    // The trace events of the translation, which are traced again when it is
+    // carried over.
+    std::vector<TranslationTrace::Event> TraceEvents;
+  };
+
+  unsigned ModelVersion;
+  std::set<llvm::Value *> VersionedModelAsByteArray;
+  std::map<llvm::Value *, unsigned> ArrayModelVersion, PointerModelVersion;
+  std::map<llvm::Value *, unsigned> GlobalArrayVersion;
+  std::map<llvm::Function *, ModelDependencies> FunctionDeps;
+  std::map<llvm::Constant *, ModelDependencies> ConstantDeps;
+  ModelDependencies *CurrentDeps;
+  // The module of the previous round, and its arrays, from which skipped
+  // functions are carried over.
+  bugle::Module *PrevBM;
+  std::map<llvm::Value *, GlobalArray *> CarriedGlobals;
+  std::map<llvm::Value *, unsigned> CarriedGlobalVersions;
+  std::set<bugle::Function *> CarriedFunctions;
+
+  TranslationTrace *Trace;
+  std::set<llvm::Value *> TracedByteArrayModels;
+
+  enum ModelEscalation {
+    NoEscalation,
+    EscalateByteArrays,
+    EscalateAllAsByteArray
+  };
+  unsigned CaseSplitRounds, ByteArrayRounds;
+
+  void traceEvent(TranslationTrace::Reason R, llvm::Value *V,
+                  llvm::Value *Cause);
+  void traceByteArrayModels(llvm::Value *Cause);
+  void escalateAllAsByteArray();
+  bool escalateByteArrayModels();
+  ModelEscalation chooseModelEscalation(unsigned Round);
+
   ref<Expr> translate1dCUDABuiltinGlobal(std::string Prefix,
                                          llvm::GlobalVariable *GV);
   ref<Expr> translate3dCUDABuiltinGlobal(std::string Prefix,
@@ -94,15 +157,24 @@ private:
   ref<Expr> translateGlobalVariable(llvm::GlobalVariable *GV);
   void addGlobalArrayAttribs(GlobalArray *GA, llvm::PointerType *PT);
   bugle::GlobalArray *getGlobalArray(llvm::Value *V, bool IsParameter = false);
+  void translateArrayInit(llvm::Value *V, llvm::Constant *Init);
+  void addInstrumentedArray(ref<Expr> Array);
+  bugle::Function *addHelperFunction(const std::string &Name,
+                                     const std::string &SourceName);
 
   ref<Expr> translateConstant(llvm::Constant *C);
   ref<Expr> doTranslateConstant(llvm::Constant *C);
+  bool isRoundInvariant(llvm::Constant *C);
+  static bool uniqueExprs();
 
   Type translateType(llvm::Type *T);
+  Type doTranslateType(llvm::Type *T);
   Type handlePadding(Type ElTy, llvm::Type *T);
   Type translateArrayRangeType(llvm::Type *T);
+  Type doTranslateArrayRangeType(llvm::Type *T);
   Type translateSourceType(llvm::Type *T);
   Type translateSourceArrayRangeType(llvm::Type *T);
+  Type doTranslateSourceArrayRangeType(llvm::Type *T);
   void getSourceArrayDimensions(llvm::Type *T, std::vector<uint64_t> &dim);
 
   ref<Expr> translateGEP(ref<Expr> Ptr, klee::gep_type_iterator begin,
@@ -129,15 +201,29 @@ private:
                          ref<Expr> RHS,
                          std::function<ref<Expr>(ref<Expr>, ref<Expr>)> F);
 
+  void recordArrayModelUse(llvm::Value *V);
+  void recordPointerModelUse(llvm::Value *V);
+  void mergeModelDependencies(const ModelDependencies &D);
+  void updateArrayModelVersions();
+  void updatePointerModelVersions();
+  bool isModelUnchanged(const ModelDependencies &D);
+  void replayModelDependencies(const ModelDependencies &D);
+  void resetFunction(llvm::Function *F, bugle::Function *BF);
+  void translateFunctionIncrementally(llvm::Function *F,
+                                      TranslateFunction &TF);
+
   ref<Expr> modelValue(llvm::Value *V, ref<Expr> E);
   Type getModelledType(llvm::Value *V);
   ref<Expr> unmodelValue(llvm::Value *V, ref<Expr> E);
   void computeValueModel(llvm::Value *Val, Var *Var,
-                         llvm::ArrayRef<ref<Expr>> Assigns);
+                         llvm::ArrayRef<ref<Expr>> Assigns,
+                         llvm::Instruction *Cause);
 
-  Stmt *modelCallStmt(llvm::Type *T, llvm::Function *F, ref<Expr> Val,
-                      std::vector<ref<Expr>> &args, SourceLocsRef &sourcelocs);
-  ref<Expr> modelCallExpr(llvm::Type *T, llvm::Function *F, ref<Expr> Val,
+  Stmt *modelCallStmt(llvm::CallInst *CI, llvm::Type *T, llvm::Function *F,
+                      ref<Expr> Val, std::vector<ref<Expr>> &args,
+                      SourceLocsRef &sourcelocs);
+  ref<Expr> modelCallExpr(llvm::CallInst *CI, llvm::Type *T,
+                          llvm::Function *F, ref<Expr> Val,
                           std::vector<ref<Expr>> &args);
 
   Type defaultRange() {
@@ -152,12 +238,15 @@ private:
 public:
   TranslateModule(llvm::Module *M, SourceLanguage SL, std::set<std::string> &EP,
                   RaceInstrumenter RI, AddressSpaceMap &AS,
-                  std::map<std::string, ArraySpec> &GAS)
+                  std::map<std::string, ArraySpec> &GAS,
+                  TranslationTrace *Trace = nullptr)
       : BM(nullptr), M(M), TD(M), SL(SL), GPUEntryPoints(EP), RaceInst(RI),
         AddressSpaces(AS), GPUArraySizes(GAS),
         NeedAdditionalByteArrayModels(false), ModelAllAsByteArray(false),
         NextModelAllAsByteArray(false),
-        NeedAdditionalGlobalOffsetModels(false) {
+        NeedAdditionalGlobalOffsetModels(false), ModelVersion(0),
+        CurrentDeps(nullptr), PrevBM(nullptr), Trace(Trace),
+        CaseSplitRounds(0), ByteArrayRounds(0) {
     DIF.processModule(*M);
   }
 
@@ -174,9 +263,24 @@ public:
   std::string getSourceFunctionName(llvm::Function *F);
   static std::string getSourceGlobalArrayName(llvm::Value *V);
   static std::string getSourceName(llvm::Value *V, llvm::Function *F);
+  void addPointerModels(
+      const std::set<llvm::Value *> &ByteArrays,
+      const std::map<llvm::Value *, std::set<llvm::Value *>> &GlobalOffsets,
+      const std::set<llvm::Value *> &MayBeNull);
   void translate();
   bugle::Module *takeModule() { return BM; }
 
+  // The pointer models at the fixed point, once the module is translated.
+  bool modelsAllAsByteArray() const { return ModelAllAsByteArray; }
+  const std::set<llvm::Value *> &getByteArrayModels() const {
+    return ModelAsByteArray;
+  }
+  const std::map<llvm::Value *, std::set<llvm::Value *>> &
+  getGlobalOffsetModels() const {
+    return ModelPtrAsGlobalOffset;
+  }
+  const std::set<llvm::Value *> &getMayBeNull() const { return PtrMayBeNull; }
+
   friend class TranslateFunction;
 };
 }
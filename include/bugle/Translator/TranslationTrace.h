@@ -0,0 +1,67 @@
+#ifndef BUGLE_TRANSLATOR_TRANSLATIONTRACE_H
+#define BUGLE_TRANSLATOR_TRANSLATIONTRACE_H
+
+#include <chrono>
+#include <cstdint>
+#include <string>
+#include <vector>
+
+namespace llvm {
+
+class raw_ostream;
+class Value;
+}
+
+namespace bugle {
+
+class Module;
+
+// Records, for each round of the pointer model fixed point, the values and
+// instructions which caused another round to be needed, so that the rounds
+// can be accounted for.
+class TranslationTrace {
+public:
+  enum Reason {
+    ByteArrayModel,
+    GlobalOffsetModel,
+    AllAsByteArray,
+    EscalateByteArrayModel,
+    EscalateAllAsByteArray
+  };
+
+  struct Event {
+    Reason R;
+    std::string Value, SourceName, Function, Instruction, File;
+    unsigned Line, Column;
+    // Whether the event is traced again for a translation carried over from
+    // an earlier round.
+    bool Replayed;
+  };
+
+private:
+  struct Round {
+    double Seconds;
+    uint64_t Exprs, Stmts;
+    bool NeedAdditionalByteArrayModels, NeedAdditionalGlobalOffsetModels,
+        NextModelAllAsByteArray;
+    std::vector<Event> Events;
+  };
+
+  std::vector<Round> Rounds;
+  std::chrono::steady_clock::time_point RoundStart;
+  uint64_t RoundStartExprs;
+
+public:
+  TranslationTrace() : RoundStartExprs(0) {}
+
+  void beginRound();
+  void endRound(bugle::Module *BM, bool NeedAdditionalByteArrayModels,
+                bool NeedAdditionalGlobalOffsetModels,
+                bool NextModelAllAsByteArray);
+  const Event &addEvent(Reason R, llvm::Value *V, llvm::Value *Cause);
+  void replayEvent(const Event &E);
+  void write(llvm::raw_ostream &OS) const;
+};
+}
+
+#endif
@@ -1,6 +1,7 @@
 #ifndef BUGLE_TYPE_H
 #define BUGLE_TYPE_H
 
+#include "llvm/Support/ErrorHandling.h"
 #include <assert.h>
 
 namespace bugle {
@@ -23,17 +24,24 @@ struct Type {
     Any
   };
 
+  // Packed into 32 bits, as a type is stored in every expression.
   bool array : 1;
-  Kind kind : 31;
-  unsigned width;
+  Kind kind : 4;
+  unsigned width : 27;
+
+  static const unsigned MaxWidth = (1u << 27) - 1;
 
   Type(Kind kind, unsigned width = 0) : array(false), kind(kind), width(width) {
     assert((kind != Bool && kind != Unknown) || width == 0);
+    if (width > MaxWidth)
+      llvm::report_fatal_error("Type too wide");
   }
 
   Type(ArrayKind ak, Kind kind, unsigned width = 0)
       : array(true), kind(kind), width(width) {
     assert((kind != Bool && kind != Unknown) || width == 0);
+    if (width > MaxWidth)
+      llvm::report_fatal_error("Type too wide");
   }
 
   Type(ArrayKind ak, Type subType)
@@ -10,11 +10,16 @@ namespace bugle {
 class Var {
   Type type;
   std::string name;
+  // The number of low bits known to be zero in every value of the variable.
+  unsigned knownTrailingZeros;
 
 public:
-  Var(Type type, const std::string &name) : type(type), name(name) {}
+  Var(Type type, const std::string &name)
+      : type(type), name(name), knownTrailingZeros(0) {}
   Type getType() { return type; }
   const std::string &getName() { return name; }
+  unsigned getKnownTrailingZeros() const { return knownTrailingZeros; }
+  void setKnownTrailingZeros(unsigned tz) { knownTrailingZeros = tz; }
 };
 }
 
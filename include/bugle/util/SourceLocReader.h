@@ -0,0 +1,63 @@
+#ifndef BUGLE_UTIL_SOURCELOCREADER_H
+#define BUGLE_UTIL_SOURCELOCREADER_H
+
+#include "bugle/SourceLoc.h"
+#include "llvm/ADT/StringRef.h"
+#include <cstdint>
+#include <memory>
+#include <string>
+
+namespace llvm {
+
+class MemoryBuffer;
+}
+
+namespace bugle {
+
+// The binary format of source location files, in which all numbers are 32-bit
+// little-endian.  The file consists of:
+//  - a header: the magic number, the version, the number of chains and the
+//    number of strings;
+//  - the chain index: for each chain, the index of its first record, followed
+//    by the total number of records;
+//  - the string index: for each string, the offset of its first character in
+//    the string data, followed by the size of the string data;
+//  - the records: the line, column, file name and path of each location, the
+//    names and paths being indices of strings;
+//  - the string data.
+struct BinarySourceLocFormat {
+  static const uint32_t Magic = 0x4c534742; // "BGSL"
+  static const uint32_t Version = 1;
+  static const unsigned HeaderSize = 16;
+  static const unsigned RecordSize = 16;
+};
+
+// Reads a source location file in the binary format.  The file is mapped into
+// memory where possible, and each chain is found through the index without
+// reading the others.
+class SourceLocReader {
+  std::unique_ptr<llvm::MemoryBuffer> Buffer;
+  uint32_t NumChains, NumStrings;
+  const char *ChainIndex, *StringIndex, *Records, *StringData;
+  uint32_t NumRecords, StringDataSize;
+
+  SourceLocReader(std::unique_ptr<llvm::MemoryBuffer> Buffer);
+
+public:
+  ~SourceLocReader();
+
+  // Opens FileName, or returns null and sets Error if it cannot be read or is
+  // not a source location file in the binary format.
+  static std::unique_ptr<SourceLocReader> open(llvm::StringRef FileName,
+                                               std::string &Error);
+
+  unsigned getNumChains() const { return NumChains; }
+  unsigned getNumStrings() const { return NumStrings; }
+  llvm::StringRef getString(unsigned Id) const;
+  // Reads the chain numbered Num into Locs, returning false if the number or
+  // the chain is out of range.
+  bool getSourceLocs(unsigned Num, SourceLocs &Locs) const;
+};
+}
+
+#endif
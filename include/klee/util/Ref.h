@@ -11,6 +11,7 @@
 #define KLEE_REF_H
 
 #include "llvm/Support/Casting.h"
+#include "llvm/Support/ErrorHandling.h"
 using llvm::isa;
 using llvm::cast;
 using llvm::cast_or_null;
@@ -33,8 +34,9 @@ public:
 
 private:
   void inc() const {
-    if (ptr)
-      ++ptr->refCount;
+    // The count may be a bit-field, which wraps to zero on overflow.
+    if (ptr && ++ptr->refCount == 0)
+      llvm::report_fatal_error("Reference count overflow");
   }
 
   void dec() const {
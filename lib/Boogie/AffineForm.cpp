@@ -0,0 +1,164 @@
+#include "bugle/AffineForm.h"
+#include "bugle/Var.h"
+#include <algorithm>
+
+using namespace bugle;
+
+void AffineForm::addTerm(ref<Expr> term, const llvm::APInt &coeff) {
+  if (coeff == 0)
+    return;
+
+  for (auto &T : terms) {
+    if (T.first.get() == term.get()) {
+      T.second += coeff;
+      return;
+    }
+  }
+  terms.push_back(std::make_pair(term, coeff));
+}
+
+void AffineForm::add(ref<Expr> e, const llvm::APInt &scale) {
+  assert(e->getType().isKind(Type::BV));
+  assert(e->getType().width == constant.getBitWidth());
+
+  if (auto *CE = dyn_cast<BVConstExpr>(e)) {
+    constant += CE->getValue() * scale;
+  } else if (auto *AE = dyn_cast<BVAddExpr>(e)) {
+    add(AE->getLHS(), scale);
+    add(AE->getRHS(), scale);
+  } else if (auto *SE = dyn_cast<BVSubExpr>(e)) {
+    add(SE->getLHS(), scale);
+    add(SE->getRHS(), -scale);
+  } else if (auto *ME = dyn_cast<BVMulExpr>(e)) {
+    if (auto *CE = dyn_cast<BVConstExpr>(ME->getLHS()))
+      add(ME->getRHS(), CE->getValue() * scale);
+    else if (auto *CE = dyn_cast<BVConstExpr>(ME->getRHS()))
+      add(ME->getLHS(), CE->getValue() * scale);
+    else
+      addTerm(e, scale);
+  } else if (auto *SE = dyn_cast<BVShlExpr>(e)) {
+    auto *CE = dyn_cast<BVConstExpr>(SE->getRHS());
+    if (!CE)
+      addTerm(e, scale);
+    else if (CE->getValue().ult(constant.getBitWidth()))
+      add(SE->getLHS(), scale.shl(CE->getValue().getZExtValue()));
+  } else {
+    addTerm(e, scale);
+  }
+}
+
+// A lower bound on the number of low bits which are zero in every value of e.
+static unsigned getKnownTrailingZeros(Expr *e) {
+  if (!e->getType().isKind(Type::BV))
+    return 0;
+  unsigned Width = e->getType().width;
+
+  if (auto *CE = dyn_cast<BVConstExpr>(e))
+    return CE->getValue().countTrailingZeros();
+  if (auto *VRE = dyn_cast<VarRefExpr>(e))
+    return std::min(VRE->getVar()->getKnownTrailingZeros(), Width);
+  if (isa<BVAddExpr>(e) || isa<BVSubExpr>(e) || isa<BVOrExpr>(e) ||
+      isa<BVXorExpr>(e)) {
+    auto *BE = cast<BinaryExpr>(e);
+    return std::min(getKnownTrailingZeros(BE->getLHS().get()),
+                    getKnownTrailingZeros(BE->getRHS().get()));
+  }
+  if (auto *AE = dyn_cast<BVAndExpr>(e))
+    return std::max(getKnownTrailingZeros(AE->getLHS().get()),
+                    getKnownTrailingZeros(AE->getRHS().get()));
+  if (auto *ME = dyn_cast<BVMulExpr>(e))
+    return std::min(getKnownTrailingZeros(ME->getLHS().get()) +
+                        getKnownTrailingZeros(ME->getRHS().get()),
+                    Width);
+  if (auto *SE = dyn_cast<BVShlExpr>(e)) {
+    if (auto *CE = dyn_cast<BVConstExpr>(SE->getRHS())) {
+      if (CE->getValue().uge(Width))
+        return Width;
+      return std::min(getKnownTrailingZeros(SE->getLHS().get()) +
+                          (unsigned)CE->getValue().getZExtValue(),
+                      Width);
+    }
+    return 0;
+  }
+  if (isa<BVZExtExpr>(e) || isa<BVSExtExpr>(e))
+    return getKnownTrailingZeros(cast<UnaryExpr>(e)->getSubExpr().get());
+  if (auto *CE = dyn_cast<BVConcatExpr>(e)) {
+    unsigned RHSWidth = CE->getRHS()->getType().width;
+    unsigned RHSZeros = getKnownTrailingZeros(CE->getRHS().get());
+    if (RHSZeros < RHSWidth)
+      return RHSZeros;
+    return RHSWidth + getKnownTrailingZeros(CE->getLHS().get());
+  }
+  if (auto *EE = dyn_cast<BVExtractExpr>(e)) {
+    unsigned SubZeros = getKnownTrailingZeros(EE->getSubExpr().get());
+    return SubZeros > EE->getOffset()
+               ? std::min(SubZeros - EE->getOffset(), Width)
+               : 0;
+  }
+  if (auto *ITE = dyn_cast<IfThenElseExpr>(e))
+    return std::min(getKnownTrailingZeros(ITE->getTrueExpr().get()),
+                    getKnownTrailingZeros(ITE->getFalseExpr().get()));
+  return 0;
+}
+
+static bool isBaseOffset(Expr *e, Var *base) {
+  if (auto *AOE = dyn_cast<ArrayOffsetExpr>(e))
+    if (auto *VRE = dyn_cast<VarRefExpr>(AOE->getSubExpr()))
+      return VRE->getVar() == base;
+  return false;
+}
+
+bool AffineForm::divideExact(uint64_t divisor, Var *base) {
+  assert(divisor != 0 && (divisor & (divisor - 1)) == 0);
+  unsigned Shift = llvm::APInt(64, divisor).logBase2();
+
+  // The gcd of the constant and the coefficients is a multiple of the
+  // divisor exactly if its low bits are clear in each of them.  A term whose
+  // coefficient falls short may make up the difference with low bits known
+  // to be zero in the term itself, which is then shifted right exactly.
+  if (constant.countTrailingZeros() < Shift)
+    return false;
+  std::vector<unsigned> TermShifts;
+  for (auto &T : terms) {
+    unsigned CoeffZeros = T.second.countTrailingZeros();
+    if (CoeffZeros >= Shift) {
+      TermShifts.push_back(0);
+    } else if (base && T.second == 1 && isBaseOffset(T.first.get(), base)) {
+      TermShifts.push_back(0);
+    } else if (getKnownTrailingZeros(T.first.get()) >= Shift - CoeffZeros) {
+      TermShifts.push_back(Shift - CoeffZeros);
+    } else {
+      return false;
+    }
+  }
+
+  constant = constant.ashr(Shift);
+  for (unsigned i = 0; i != terms.size(); ++i) {
+    auto &T = terms[i];
+    unsigned TermShift = TermShifts[i];
+    if (TermShift == 0 && T.second.countTrailingZeros() < Shift)
+      continue;
+    if (TermShift != 0)
+      T.first = BVAShrExpr::create(
+          T.first, BVConstExpr::create(constant.getBitWidth(), TermShift));
+    T.second = T.second.ashr(Shift - TermShift);
+  }
+  return true;
+}
+
+ref<Expr> AffineForm::toExpr() const {
+  ref<Expr> Sum;
+  for (auto &T : terms) {
+    if (T.second == 0)
+      continue;
+    ref<Expr> Term = T.first;
+    if (T.second != 1)
+      Term = BVMulExpr::create(Term, BVConstExpr::create(T.second));
+    Sum = Sum.isNull() ? Term : BVAddExpr::create(Sum, Term);
+  }
+
+  ref<Expr> C = BVConstExpr::create(constant);
+  if (Sum.isNull())
+    return C;
+  return BVAddExpr::create(Sum, C);
+}
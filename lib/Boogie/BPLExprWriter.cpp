@@ -1,4 +1,5 @@
 #include "bugle/BPLExprWriter.h"
+#include "bugle/BPLIntrinsic.h"
 #include "bugle/BPLModuleWriter.h"
 #include "bugle/Expr.h"
 #include "bugle/Function.h"
@@ -10,6 +11,7 @@
 #include "llvm/Support/CommandLine.h"
 #include "llvm/Support/raw_ostream.h"
 #include <cmath>
+#include <functional>
 
 using namespace bugle;
 
@@ -36,6 +38,110 @@ struct ScopedParenPrinter {
 
 BPLExprWriter::~BPLExprWriter() {}
 
+void BPLExprWriter::useIntrinsic(const BPLIntrinsic &I, Expr *Origin) {
+  if (IntrinsicTable)
+    IntrinsicTable->insert(std::make_pair(I, Origin));
+  else
+    MW->useIntrinsic(I, Origin);
+}
+
+void BPLExprWriter::writeLanes(
+    llvm::raw_ostream &OS, unsigned Begin, unsigned End, unsigned Depth,
+    const std::function<void(llvm::raw_ostream &, unsigned)> &WriteLane) {
+  if (End - Begin == 1) {
+    WriteLane(OS, Begin);
+    return;
+  }
+
+  unsigned Mid = Begin + (End - Begin) / 2;
+  ScopedParenPrinter X(OS, Depth, 4);
+  MW->IntRep->writeConcatExpr(
+      OS,
+      [&](llvm::raw_ostream &OS) { writeLanes(OS, Mid, End, 4, WriteLane); },
+      [&](llvm::raw_ostream &OS) {
+        writeLanes(OS, Begin, Mid, 5, WriteLane);
+      });
+  if (MW->IntRep->abstractsConcat())
+    useIntrinsic(BPLIntrinsic(BPLIntrinsic::Concat));
+}
+
+void BPLExprWriter::writeLaneOperand(llvm::raw_ostream &OS, Expr *Op,
+                                     unsigned Lane, unsigned LaneWidth) {
+  if (Op->getType().width == LaneWidth) {
+    writeExpr(OS, Op, 9);
+    return;
+  }
+
+  MW->IntRep->writeExtractExpr(
+      OS, [&](llvm::raw_ostream &OS) { writeExpr(OS, Op, 9); },
+      (Lane + 1) * LaneWidth, Lane * LaneWidth);
+  if (MW->IntRep->abstractsExtract())
+    useIntrinsic(BPLIntrinsic(BPLIntrinsic::Extract));
+}
+
+void BPLExprWriter::writeBinaryName(llvm::raw_ostream &OS, Expr::Kind Kind,
+                                    Type LHSTy, Type RHSTy) {
+  switch (Kind) {
+  case Expr::BVAdd:
+  case Expr::BVSub:
+  case Expr::BVMul:
+  case Expr::BVSDiv:
+  case Expr::BVUDiv:
+  case Expr::BVSRem:
+  case Expr::BVURem:
+  case Expr::BVShl:
+  case Expr::BVAShr:
+  case Expr::BVLShr:
+  case Expr::BVAnd:
+  case Expr::BVOr:
+  case Expr::BVXor: {
+    OS << "BV" << LHSTy.width << "_" << BPLIntrinsic::getBinaryName(Kind);
+    useIntrinsic(
+        BPLIntrinsic(BPLIntrinsic::ArithmeticBinary, Kind, LHSTy.width));
+    break;
+  }
+  case Expr::BVUgt:
+  case Expr::BVUge:
+  case Expr::BVUlt:
+  case Expr::BVUle:
+  case Expr::BVSgt:
+  case Expr::BVSge:
+  case Expr::BVSlt:
+  case Expr::BVSle: {
+    OS << "BV" << LHSTy.width << "_" << BPLIntrinsic::getBinaryName(Kind);
+    useIntrinsic(
+        BPLIntrinsic(BPLIntrinsic::BooleanBinary, Kind, LHSTy.width));
+    break;
+  }
+  case Expr::FAdd:
+  case Expr::FSub:
+  case Expr::FMul:
+  case Expr::FDiv:
+  case Expr::FRem:
+  case Expr::FPow:
+  case Expr::FMax:
+  case Expr::FMin:
+  case Expr::FEq:
+  case Expr::FLt:
+  case Expr::FUno:
+  case Expr::PtrLt:
+  case Expr::FuncPtrLt: {
+    BPLIntrinsic I(BPLIntrinsic::BinaryFunction, Kind, LHSTy);
+    I.writeName(OS);
+    useIntrinsic(I);
+    break;
+  }
+  case Expr::FPowi: {
+    BPLIntrinsic I(BPLIntrinsic::BinaryFunction, Kind, LHSTy, RHSTy);
+    I.writeName(OS);
+    useIntrinsic(I);
+    break;
+  }
+  default:
+    llvm_unreachable("Unsupported binary expr");
+  }
+}
+
 void BPLExprWriter::writeExpr(llvm::raw_ostream &OS, Expr *E, unsigned Depth) {
   if (DumpRefCounts)
     OS << "/*rc=" << E->refCount << "*/";
@@ -47,15 +153,14 @@ void BPLExprWriter::writeExpr(llvm::raw_ostream &OS, Expr *E, unsigned Depth) {
     OS << (BCE->getValue() ? "true" : "false");
   } else if (auto *EE = dyn_cast<BVExtractExpr>(E)) {
     ScopedParenPrinter X(OS, Depth, 8);
-    std::string s; llvm::raw_string_ostream ss(s);
-    writeExpr(ss, EE->getSubExpr().get(), 9);
-    OS << MW->IntRep->getExtractExpr(
-        ss.str(), EE->getOffset() + EE->getType().width, EE->getOffset());
-    if (MW->IntRep->abstractsExtract()) {
-      MW->writeIntrinsic(
-          [&](llvm::raw_ostream &OS) { OS << MW->IntRep->getExtract(); },
-          false);
-    }
+    MW->IntRep->writeExtractExpr(
+        OS,
+        [&](llvm::raw_ostream &OS) {
+          writeExpr(OS, EE->getSubExpr().get(), 9);
+        },
+        EE->getOffset() + EE->getType().width, EE->getOffset());
+    if (MW->IntRep->abstractsExtract())
+      useIntrinsic(BPLIntrinsic(BPLIntrinsic::Extract));
   } else if (isa<BVCtlzExpr>(E)) {
     llvm_unreachable("Handled at statement level");
   } else if (auto *ZEE = dyn_cast<BVZExtExpr>(E)) {
@@ -63,25 +168,17 @@ void BPLExprWriter::writeExpr(llvm::raw_ostream &OS, Expr *E, unsigned Depth) {
        << "_ZEXT" << ZEE->getType().width << "(";
     writeExpr(OS, ZEE->getSubExpr().get());
     OS << ")";
-    MW->writeIntrinsic(
-        [&](llvm::raw_ostream &OS) {
-          unsigned FromWidth = ZEE->getSubExpr()->getType().width,
-                   ToWidth = ZEE->getType().width;
-          OS << MW->IntRep->getZeroExtend(FromWidth, ToWidth);
-        },
-        false);
+    useIntrinsic(BPLIntrinsic(BPLIntrinsic::ZeroExtend, 0,
+                              ZEE->getSubExpr()->getType().width,
+                              ZEE->getType().width));
   } else if (auto SEE = dyn_cast<BVSExtExpr>(E)) {
     OS << "BV" << SEE->getSubExpr()->getType().width
        << "_SEXT" << SEE->getType().width << "(";
     writeExpr(OS, SEE->getSubExpr().get());
     OS << ")";
-    MW->writeIntrinsic(
-        [&](llvm::raw_ostream &OS) {
-          unsigned FromWidth = SEE->getSubExpr()->getType().width,
-                   ToWidth = SEE->getType().width;
-          OS << MW->IntRep->getSignExtend(FromWidth, ToWidth);
-        },
-        false);
+    useIntrinsic(BPLIntrinsic(BPLIntrinsic::SignExtend, 0,
+                              SEE->getSubExpr()->getType().width,
+                              SEE->getType().width));
   } else if (auto PtrE = dyn_cast<PointerExpr>(E)) {
     OS << "MKPTR(";
     writeExpr(OS, PtrE->getArray().get());
@@ -97,10 +194,8 @@ void BPLExprWriter::writeExpr(llvm::raw_ostream &OS, Expr *E, unsigned Depth) {
   } else if (auto *VarE = dyn_cast<VarRefExpr>(E)) {
     OS << "$" << VarE->getVar()->getName();
   } else if (auto *SVarE = dyn_cast<SpecialVarRefExpr>(E)) {
-    MW->writeIntrinsic([&](llvm::raw_ostream &OS) {
-      OS << "const {:" << SVarE->getAttr() << "} " << SVarE->getAttr() << " : ";
-      MW->writeType(OS, SVarE->getType());
-    });
+    useIntrinsic(BPLIntrinsic(BPLIntrinsic::SpecialVar, 0, SVarE->getType(),
+                              Type(Type::Unknown), &SVarE->getAttr()));
     OS << SVarE->getAttr();
   } else if (auto *ArrE = dyn_cast<GlobalArrayRefExpr>(E)) {
     MW->UsesPointers = true;
@@ -108,17 +203,44 @@ void BPLExprWriter::writeExpr(llvm::raw_ostream &OS, Expr *E, unsigned Depth) {
   } else if (isa<NullArrayRefExpr>(E)) {
     MW->UsesPointers = true;
     OS << "$arrayId$$null$";
+  } else if (auto *VBE = dyn_cast<VectorBinaryExpr>(E)) {
+    unsigned LaneWidth = VBE->getLaneWidth();
+    Type LaneTy(Type::BV, LaneWidth);
+    writeLanes(OS, 0, VBE->getNumLanes(), Depth,
+               [&](llvm::raw_ostream &OS, unsigned Lane) {
+      writeBinaryName(OS, VBE->getOp(), LaneTy, LaneTy);
+      OS << "(";
+      writeLaneOperand(OS, VBE->getLHS().get(), Lane, LaneWidth);
+      OS << ", ";
+      writeLaneOperand(OS, VBE->getRHS().get(), Lane, LaneWidth);
+      OS << ")";
+    });
+  } else if (auto *VSE = dyn_cast<VectorShuffleExpr>(E)) {
+    unsigned LaneWidth = VSE->getLaneWidth();
+    unsigned Vec1Lanes = VSE->getNumVec1Lanes();
+    auto Mask = VSE->getMask();
+    writeLanes(OS, 0, Mask.size(), Depth,
+               [&](llvm::raw_ostream &OS, unsigned Lane) {
+      if (Mask[Lane] < 0)
+        MW->IntRep->printVal(OS, llvm::APInt(LaneWidth, 0));
+      else if ((unsigned)Mask[Lane] < Vec1Lanes)
+        writeLaneOperand(OS, VSE->getVec1().get(), Mask[Lane], LaneWidth);
+      else
+        writeLaneOperand(OS, VSE->getVec2().get(), Mask[Lane] - Vec1Lanes,
+                         LaneWidth);
+    });
   } else if (auto *ConcatE = dyn_cast<BVConcatExpr>(E)) {
     ScopedParenPrinter X(OS, Depth, 4);
-    std::string lhsS; llvm::raw_string_ostream lhsSS(lhsS);
-    std::string rhsS; llvm::raw_string_ostream rhsSS(rhsS);
-    writeExpr(lhsSS, ConcatE->getLHS().get(), 4);
-    writeExpr(rhsSS, ConcatE->getRHS().get(), 5);
-    OS << MW->IntRep->getConcatExpr(lhsSS.str(), rhsSS.str());
-    if (MW->IntRep->abstractsConcat()) {
-      MW->writeIntrinsic(
-          [&](llvm::raw_ostream &OS) { OS << MW->IntRep->getConcat(); }, false);
-    }
+    MW->IntRep->writeConcatExpr(
+        OS,
+        [&](llvm::raw_ostream &OS) {
+          writeExpr(OS, ConcatE->getLHS().get(), 4);
+        },
+        [&](llvm::raw_ostream &OS) {
+          writeExpr(OS, ConcatE->getRHS().get(), 5);
+        });
+    if (MW->IntRep->abstractsConcat())
+      useIntrinsic(BPLIntrinsic(BPLIntrinsic::Concat));
   } else if (auto *EE = dyn_cast<EqExpr>(E)) {
     ScopedParenPrinter X(OS, Depth, 4);
     writeExpr(OS, EE->getLHS().get(), 4);
@@ -152,12 +274,16 @@ void BPLExprWriter::writeExpr(llvm::raw_ostream &OS, Expr *E, unsigned Depth) {
   } else if (auto *B2BVE = dyn_cast<BoolToBVExpr>(E)) {
     OS << "(if ";
     writeExpr(OS, B2BVE->getSubExpr().get());
-    OS << " then " << MW->IntRep->getLiteral(1, 1) << " else "
-       << MW->IntRep->getLiteral(0, 1) << ")";
+    OS << " then ";
+    MW->IntRep->writeLiteral(OS, 1, 1);
+    OS << " else ";
+    MW->IntRep->writeLiteral(OS, 0, 1);
+    OS << ")";
   } else if (auto *BV2BE = dyn_cast<BVToBoolExpr>(E)) {
     ScopedParenPrinter X(OS, Depth, 4);
     writeExpr(OS, BV2BE->getSubExpr().get(), 4);
-    OS << " == " << MW->IntRep->getLiteral(1, 1);
+    OS << " == ";
+    MW->IntRep->writeLiteral(OS, 1, 1);
   } else if (auto *AIE = dyn_cast<ArrayIdExpr>(E)) {
     OS << "base#MKPTR(";
     writeExpr(OS, AIE->getSubExpr().get());
@@ -190,88 +316,18 @@ void BPLExprWriter::writeExpr(llvm::raw_ostream &OS, Expr *E, unsigned Depth) {
     writeExpr(OS, ANOVE->getSecond().get());
     OS << ")";
 
-    MW->writeIntrinsic([&](llvm::raw_ostream &OS) {
-                         OS << MW->IntRep->getArithmeticBinary(
-                             "ADD", bugle::Expr::Kind::BVAdd, width);
-                       },
-                       false);
-
-    MW->writeIntrinsic([&](llvm::raw_ostream &OS) {
-                         OS << MW->IntRep->getArithmeticBinary(
-                             "ADD", bugle::Expr::Kind::BVAdd, width + 1);
-                       },
-                       false);
-
-    if (MW->IntRep->abstractsConcat()) {
-      MW->writeIntrinsic(
-          [&](llvm::raw_ostream &OS) { OS << MW->IntRep->getConcat(); }, false);
-    }
-
-    if (MW->IntRep->abstractsExtract()) {
-      MW->writeIntrinsic(
-          [&](llvm::raw_ostream &OS) { OS << MW->IntRep->getExtract(); },
-          false);
-    }
-
-    if (ANOVE->getIsSigned()) {
-      MW->writeIntrinsic(
-          [&](llvm::raw_ostream &OS) {
-            OS << "procedure {:inline 1} $__add_noovfl_signed_" << width
-               << "(x : " << MW->IntRep->getType(width)
-               << ", y : " << MW->IntRep->getType(width)
-               << ") returns (z : " << MW->IntRep->getType(width) << ") {\n"
-               << "  assume ";
-
-            {
-              std::string S; llvm::raw_string_ostream SS(S);
-              SS << "BV" << (width + 1) << "_ADD("
-                 << MW->IntRep->getConcatExpr(MW->IntRep->getLiteral(0, 1), "x")
-                 << ", "
-                 << MW->IntRep->getConcatExpr(MW->IntRep->getLiteral(0, 1), "y")
-                 << ")";
-
-              OS << MW->IntRep->getExtractExpr(SS.str(), width + 1, width);
-            }
-
-            OS << " == " << MW->IntRep->getLiteral(0, 1) << ";\n"
-               << "  assume "
-               << MW->IntRep->getExtractExpr("x", width, width - 1)
-               << " == " << MW->IntRep->getExtractExpr("y", width, width - 1)
-               << " ==> ";
-
-            {
-              std::string S; llvm::raw_string_ostream SS(S);
-              SS << "BV" << width << "_ADD(x, y)";
-              OS << MW->IntRep->getExtractExpr(SS.str(), width, width - 1);
-            }
-
-            OS << " == " << MW->IntRep->getExtractExpr("x", width, width - 1)
-               << ";\n"
-               << "  z := BV" << width << "_ADD(x, y);\n"
-               << "}";
-          },
-          false);
-    } else {
-      MW->writeIntrinsic(
-          [&](llvm::raw_ostream &OS) {
-            std::string S; llvm::raw_string_ostream SS(S);
-            SS << "BV" << (width + 1) << "_ADD("
-               << MW->IntRep->getConcatExpr(MW->IntRep->getLiteral(0, 1), "x")
-               << ", "
-               << MW->IntRep->getConcatExpr(MW->IntRep->getLiteral(0, 1), "y")
-               << ")";
-            OS << "procedure {:inline 1} $__add_noovfl_unsigned_" << width
-               << "(x : " << MW->IntRep->getType(width)
-               << ", y : " << MW->IntRep->getType(width)
-               << ") returns (z : " << MW->IntRep->getType(width) << ") {\n"
-               << "  assume "
-               << MW->IntRep->getExtractExpr(SS.str(), width + 1, width)
-               << " == " << MW->IntRep->getLiteral(0, 1) << ";\n"
-               << "  z := BV" << width << "_ADD(x, y);\n"
-               << "}";
-          },
-          false);
-    }
+    useIntrinsic(
+        BPLIntrinsic(BPLIntrinsic::ArithmeticBinary, Expr::BVAdd, width));
+    useIntrinsic(
+        BPLIntrinsic(BPLIntrinsic::ArithmeticBinary, Expr::BVAdd, width + 1));
+    if (MW->IntRep->abstractsConcat())
+      useIntrinsic(BPLIntrinsic(BPLIntrinsic::Concat));
+    if (MW->IntRep->abstractsExtract())
+      useIntrinsic(BPLIntrinsic(BPLIntrinsic::Extract));
+    useIntrinsic(BPLIntrinsic(ANOVE->getIsSigned()
+                                  ? BPLIntrinsic::AddNoovflSigned
+                                  : BPLIntrinsic::AddNoovflUnsigned,
+                              0, width));
   } else if (auto *ANOVPE = dyn_cast<AddNoovflPredicateExpr>(E)) {
     const auto &exprs = ANOVPE->getExprs();
     unsigned n = exprs.size();
@@ -285,55 +341,13 @@ void BPLExprWriter::writeExpr(llvm::raw_ostream &OS, Expr *E, unsigned Depth) {
     OS << ")";
 
     unsigned b = (unsigned)std::ceil(std::log((double)n) / std::log((double)2));
-    std::string S; llvm::raw_string_ostream SS(S);
-    SS << MW->IntRep->getConcatExpr(MW->IntRep->getLiteral(0, b), "v0");
-    std::string lhs = SS.str();
-    for (unsigned i = 1; i < n; ++i) {
-      std::string S; llvm::raw_string_ostream SS(S);
-      std::string VI; llvm::raw_string_ostream VIS(VI);
-      VIS << "v" << i;
-      SS << "BV" << (width + b) << "_ADD(" << lhs << ", "
-         << MW->IntRep->getConcatExpr(MW->IntRep->getLiteral(0, b), VIS.str())
-         << ")";
-      lhs = SS.str();
-    }
-
-    MW->writeIntrinsic([&](llvm::raw_ostream &OS) {
-                         OS << MW->IntRep->getArithmeticBinary(
-                             "ADD", bugle::Expr::Kind::BVAdd, width + b);
-                       },
-                       false);
-
-    MW->writeIntrinsic(
-        [&](llvm::raw_ostream &OS) {
-          OS << "function {:inline true} __add_noovfl_" << n << "(";
-          for (unsigned i = 0; i < n; ++i) {
-            OS << (i > 0 ? ", " : "") << "v" << i << ":"
-               << MW->IntRep->getType(width);
-          }
-          OS << ") : " << MW->IntRep->getType(1) << " {";
-          if (n == 1) {
-            OS << MW->IntRep->getLiteral(1, 1);
-          } else {
-            OS << "if " << MW->IntRep->getExtractExpr(lhs, width + b, width)
-               << " == " << MW->IntRep->getLiteral(0, b)
-               << " then " << MW->IntRep->getLiteral(1, 1)
-               << " else " << MW->IntRep->getLiteral(0, 1);
-          }
-          OS << "}";
-        },
-        false);
-
-    if (MW->IntRep->abstractsConcat()) {
-      MW->writeIntrinsic(
-          [&](llvm::raw_ostream &OS) { OS << MW->IntRep->getConcat(); }, false);
-    }
-
-    if (MW->IntRep->abstractsExtract()) {
-      MW->writeIntrinsic(
-          [&](llvm::raw_ostream &OS) { OS << MW->IntRep->getExtract(); },
-          false);
-    }
+    useIntrinsic(
+        BPLIntrinsic(BPLIntrinsic::ArithmeticBinary, Expr::BVAdd, width + b));
+    useIntrinsic(BPLIntrinsic(BPLIntrinsic::AddNoovflPredicate, n, width));
+    if (MW->IntRep->abstractsConcat())
+      useIntrinsic(BPLIntrinsic(BPLIntrinsic::Concat));
+    if (MW->IntRep->abstractsExtract())
+      useIntrinsic(BPLIntrinsic(BPLIntrinsic::Extract));
   } else if (auto *UFE = dyn_cast<UninterpretedFunctionExpr>(E)) {
     OS << UFE->getName() << "(";
     for (unsigned i = 0; i < UFE->getNumOperands(); ++i) {
@@ -343,18 +357,12 @@ void BPLExprWriter::writeExpr(llvm::raw_ostream &OS, Expr *E, unsigned Depth) {
     }
     OS << ")";
 
-    MW->writeIntrinsic([&](llvm::raw_ostream &OS) {
-      OS << "function " << UFE->getName() << "(";
-      for (unsigned i = 0; i < UFE->getNumOperands(); ++i) {
-        if (i > 0)
-          OS << ", ";
-        MW->writeType(OS, UFE->getOperand(i)->getType());
-      }
-      OS << ") : ";
-      MW->writeType(OS, UFE->getType());
-    });
+    useIntrinsic(BPLIntrinsic(BPLIntrinsic::UninterpretedFunction, 0,
+                              Type(Type::Unknown), Type(Type::Unknown),
+                              &UFE->getName()),
+                 UFE);
   } else if (auto *AHTVE = dyn_cast<AtomicHasTakenValueExpr>(E)) {
-    auto Array = AHTVE->getArray();
+    auto *Array = AHTVE->getArray().get();
     assert(!(isa<NullArrayRefExpr>(Array) ||
              MW->M->global_begin() == MW->M->global_end()));
 
@@ -370,19 +378,10 @@ void BPLExprWriter::writeExpr(llvm::raw_ostream &OS, Expr *E, unsigned Depth) {
       OS << "][";
       writeExpr(OS, AHTVE->getValue().get());
       OS << "]";
-      MW->writeIntrinsic([&](llvm::raw_ostream &OS) {
-        OS << "var {:atomic_usedmap} ";
-        if ((*Globals.begin())->isGlobal())
-          OS << "{:atomic_global}";
-        else if ((*Globals.begin())->isGroupShared())
-          OS << "{:atomic_group_shared}";
-        OS << "_USED_$$" << (*Globals.begin())->getName()
-           << " : [";
-        MW->writeType(OS, AHTVE->getOffset()->getType());
-        OS << "][";
-        MW->writeType(OS, AHTVE->getValue()->getType());
-        OS << "]bool";
-      });
+      useIntrinsic(BPLIntrinsic(BPLIntrinsic::AtomicUsedMap, 0,
+                                AHTVE->getOffset()->getType(),
+                                AHTVE->getValue()->getType(),
+                                *Globals.begin()));
     } else {
       ErrorReporter::reportImplementationLimitation(
           "\"Atomic has taken value\" expressions for pointers not supported");
@@ -435,64 +434,10 @@ void BPLExprWriter::writeExpr(llvm::raw_ostream &OS, Expr *E, unsigned Depth) {
     case Expr::UIToFP:
     case Expr::GetImageWidth:
     case Expr::GetImageHeight: {
-      std::string IntName; llvm::raw_string_ostream IntS(IntName);
-      unsigned FromWidth = UnE->getSubExpr()->getType().width,
-               ToWidth = UnE->getType().width;
-      switch (UnE->getKind()) {
-      case Expr::BVToPtr:        IntS << "BV" << FromWidth
-                                      << "_TO_PTR";               break;
-      case Expr::PtrToBV:        IntS << "PTR_TO_BV" << ToWidth;  break;
-      case Expr::BVToFuncPtr:    IntS << "BV" << FromWidth
-                                      << "_TO_FUNCPTR";           break;
-      case Expr::FuncPtrToBV:    IntS << "FUNCPTR_TO_BV"
-                                      << ToWidth;                 break;
-      case Expr::PtrToFuncPtr:   IntS << "PTR_TO_FUNCPTR";        break;
-      case Expr::FuncPtrToPtr:   IntS << "FUNCPTR_TO_PTR";        break;
-      case Expr::BVCtpop:        IntS << "BV" << FromWidth
-                                      << "_CTPOP";                break;
-      case Expr::FAbs:           IntS << "FABS" << ToWidth;       break;
-      case Expr::FCeil:          IntS << "FCEIL" << ToWidth;      break;
-      case Expr::FCos:           IntS << "FCOS" << ToWidth;       break;
-      case Expr::FExp:           IntS << "FEXP" << ToWidth;       break;
-      case Expr::FExp2:          IntS << "FEXP2" << ToWidth;      break;
-      case Expr::FFloor:         IntS << "FFLOOR" << ToWidth;     break;
-      case Expr::FLog:           IntS << "FLOG" << ToWidth;       break;
-      case Expr::FLog10:         IntS << "FLOG10" << ToWidth;     break;
-      case Expr::FLog2:          IntS << "FLOG2" << ToWidth;      break;
-      case Expr::FPConv:         IntS << "FP" << FromWidth
-                                      << "_CONV" << ToWidth;      break;
-      case Expr::FPToSI:         IntS << "FP" << FromWidth
-                                      << "_TO_SI" << ToWidth;     break;
-      case Expr::FPToUI:         IntS << "FP" << FromWidth
-                                      << "_TO_UI" << ToWidth;     break;
-      case Expr::FrexpExp:       IntS << "FREXP" << FromWidth
-                                      << "_EXP";                  break;
-      case Expr::FrexpFrac:      IntS << "FREXP" << FromWidth
-                                      << "_FRAC" << ToWidth;      break;
-      case Expr::FRint:          IntS << "FRINT" << ToWidth;      break;
-      case Expr::FRsqrt:         IntS << "FRSQRT" << ToWidth;     break;
-      case Expr::FSin:           IntS << "FSIN" << ToWidth;       break;
-      case Expr::FSqrt:          IntS << "FSQRT" << ToWidth;      break;
-      case Expr::FTrunc:         IntS << "FTRUNC" << ToWidth;     break;
-      case Expr::OtherInt:       IntS << "__other_bv" << ToWidth; break;
-      case Expr::OtherBool:      IntS << "__other_bool";          break;
-      case Expr::OtherPtrBase:   IntS << "__other_arrayId";       break;
-      case Expr::SIToFP:         IntS << "SI" << FromWidth
-                                      << "_TO_FP" << ToWidth;     break;
-      case Expr::UIToFP:         IntS << "UI" << FromWidth
-                                      << "_TO_FP" << ToWidth;     break;
-      case Expr::GetImageWidth:  IntS << "GET_IMAGE_WIDTH";       break;
-      case Expr::GetImageHeight: IntS << "GET_IMAGE_HEIGHT";      break;
-      default:
-        llvm_unreachable("Unsupported unary expr opcode");
-      }
-      OS << IntS.str();
-      MW->writeIntrinsic([&](llvm::raw_ostream &OS) {
-        OS << "function " << IntS.str() << "(";
-        MW->writeType(OS, UnE->getSubExpr()->getType());
-        OS << ") : ";
-        MW->writeType(OS, UnE->getType());
-      });
+      BPLIntrinsic I(BPLIntrinsic::UnaryFunction, UnE->getKind(),
+                     UnE->getSubExpr()->getType(), UnE->getType());
+      I.writeName(OS);
+      useIntrinsic(I);
       break;
     }
     case Expr::SafeBVToPtr:
@@ -510,178 +455,15 @@ void BPLExprWriter::writeExpr(llvm::raw_ostream &OS, Expr *E, unsigned Depth) {
     writeExpr(OS, UnE->getSubExpr().get());
     OS << ")";
   } else if (auto *BinE = dyn_cast<BinaryExpr>(E)) {
-    switch (BinE->getKind()) {
-    case Expr::BVAdd:
-    case Expr::BVSub:
-    case Expr::BVMul:
-    case Expr::BVSDiv:
-    case Expr::BVUDiv:
-    case Expr::BVSRem:
-    case Expr::BVURem:
-    case Expr::BVShl:
-    case Expr::BVAShr:
-    case Expr::BVLShr:
-    case Expr::BVAnd:
-    case Expr::BVOr:
-    case Expr::BVXor: {
-      const char *IntName;
-      switch (BinE->getKind()) {
-      case Expr::BVAdd:  IntName = "ADD";  break;
-      case Expr::BVSub:  IntName = "SUB";  break;
-      case Expr::BVMul:  IntName = "MUL";  break;
-      case Expr::BVSDiv: IntName = "SDIV"; break;
-      case Expr::BVUDiv: IntName = "UDIV"; break;
-      case Expr::BVSRem: IntName = "SREM"; break;
-      case Expr::BVURem: IntName = "UREM"; break;
-      case Expr::BVShl:  IntName = "SHL";  break;
-      case Expr::BVAShr: IntName = "ASHR"; break;
-      case Expr::BVLShr: IntName = "LSHR"; break;
-      case Expr::BVAnd:  IntName = "AND";  break;
-      case Expr::BVOr:   IntName = "OR";   break;
-      case Expr::BVXor:  IntName = "XOR";  break;
-      default:
-        llvm_unreachable("huh?");
-      }
-      OS << "BV" << BinE->getType().width << "_" << IntName;
-      MW->writeIntrinsic([&](llvm::raw_ostream &OS) {
-                           OS << MW->IntRep->getArithmeticBinary(
-                               IntName, BinE->getKind(), BinE->getType().width);
-                         },
-                         false);
-      break;
-    }
-    case Expr::BVUgt:
-    case Expr::BVUge:
-    case Expr::BVUlt:
-    case Expr::BVUle:
-    case Expr::BVSgt:
-    case Expr::BVSge:
-    case Expr::BVSlt:
-    case Expr::BVSle: {
-      const char *IntName;
-      switch (BinE->getKind()) {
-      case Expr::BVUgt: IntName = "UGT"; break;
-      case Expr::BVUge: IntName = "UGE"; break;
-      case Expr::BVUlt: IntName = "ULT"; break;
-      case Expr::BVUle: IntName = "ULE"; break;
-      case Expr::BVSgt: IntName = "SGT"; break;
-      case Expr::BVSge: IntName = "SGE"; break;
-      case Expr::BVSlt: IntName = "SLT"; break;
-      case Expr::BVSle: IntName = "SLE"; break;
-      default:
-        llvm_unreachable("huh?");
-      }
-      OS << "BV" << BinE->getLHS()->getType().width << "_" << IntName;
-      MW->writeIntrinsic([&](llvm::raw_ostream &OS) {
-                           OS << MW->IntRep->getBooleanBinary(
-                               IntName, BinE->getKind(),
-                               BinE->getLHS()->getType().width);
-                         },
-                         false);
-      break;
-    }
-    case Expr::FAdd:
-    case Expr::FSub:
-    case Expr::FMul:
-    case Expr::FDiv:
-    case Expr::FRem:
-    case Expr::FPow:
-    case Expr::FMax:
-    case Expr::FMin: {
-      const char *IntName;
-      switch (BinE->getKind()) {
-      case Expr::FAdd: IntName = "FADD"; break;
-      case Expr::FSub: IntName = "FSUB"; break;
-      case Expr::FMul: IntName = "FMUL"; break;
-      case Expr::FRem: IntName = "FREM"; break;
-      case Expr::FDiv: IntName = "FDIV"; break;
-      case Expr::FPow: IntName = "FPOW"; break;
-      case Expr::FMax: IntName = "FMAX"; break;
-      case Expr::FMin: IntName = "FMIN"; break;
-      default:
-        llvm_unreachable("huh?");
-      }
-      OS << IntName << BinE->getType().width;
-      MW->writeIntrinsic([&](llvm::raw_ostream &OS) {
-        OS << "function " << IntName << BinE->getType().width << "(";
-        MW->writeType(OS, BinE->getType());
-        OS << ", ";
-        MW->writeType(OS, BinE->getType());
-        OS << ") : ";
-        MW->writeType(OS, BinE->getType());
-      });
-      break;
-    }
-    case Expr::FPowi: {
-      const char *IntName;
-      switch (BinE->getKind()) {
-      case Expr::FPowi: IntName = "FPOWI"; break;
-      default:
-        llvm_unreachable("huh?");
-      }
-      OS << IntName << BinE->getType().width << "_I"
-         << BinE->getRHS()->getType().width;
-      MW->writeIntrinsic([&](llvm::raw_ostream &OS) {
-        OS << "function " << IntName << BinE->getType().width << "_I"
-           << BinE->getRHS()->getType().width << "(";
-        MW->writeType(OS, BinE->getType());
-        OS << ", ";
-        MW->writeType(OS, BinE->getRHS()->getType());
-        OS << ") : ";
-        MW->writeType(OS, BinE->getType());
-      });
-      break;
-    }
-    case Expr::FEq:
-    case Expr::FLt:
-    case Expr::FUno: {
-      const char *IntName;
-      switch (BinE->getKind()) {
-      case Expr::FEq:  IntName = "FEQ";  break;
-      case Expr::FLt:  IntName = "FLT";  break;
-      case Expr::FUno: IntName = "FUNO"; break;
-      default:
-        llvm_unreachable("huh?");
-      }
-      OS << IntName << BinE->getLHS()->getType().width;
-      MW->writeIntrinsic([&](llvm::raw_ostream &OS) {
-        OS << "function " << IntName << BinE->getLHS()->getType().width << "(";
-        MW->writeType(OS, BinE->getLHS()->getType());
-        OS << ", ";
-        MW->writeType(OS, BinE->getLHS()->getType());
-        OS << ") : bool";
-      });
-      break;
-    }
-    case Expr::PtrLt:
-    case Expr::FuncPtrLt: {
-      const char *IntName;
-      switch (BinE->getKind()) {
-      case Expr::PtrLt:     IntName = "PTR_LT";     break;
-      case Expr::FuncPtrLt: IntName = "FUNCPTR_LT"; break;
-      default:
-        llvm_unreachable("huh?");
-      }
-      OS << IntName;
-      MW->writeIntrinsic([&](llvm::raw_ostream &OS) {
-        OS << "function " << IntName << "(";
-        MW->writeType(OS, BinE->getLHS()->getType());
-        OS << ", ";
-        MW->writeType(OS, BinE->getLHS()->getType());
-        OS << ") : bool";
-      });
-      break;
-    }
-    default:
-      llvm_unreachable("Unsupported binary expr");
-    }
+    writeBinaryName(OS, BinE->getKind(), BinE->getLHS()->getType(),
+                    BinE->getRHS()->getType());
     OS << "(";
     writeExpr(OS, BinE->getLHS().get());
     OS << ", ";
     writeExpr(OS, BinE->getRHS().get());
     OS << ")";
   } else if (auto *LE = dyn_cast<LoadExpr>(E)) {
-    auto PtrArr = LE->getArray();
+    auto *PtrArr = LE->getArray().get();
     assert(!(isa<NullArrayRefExpr>(PtrArr) ||
              MW->M->global_begin() == MW->M->global_end()));
     std::set<GlobalArray *> Globals;
@@ -703,7 +485,7 @@ void BPLExprWriter::writeExpr(llvm::raw_ostream &OS, Expr *E, unsigned Depth) {
   } else if (isa<ArraySnapshotExpr>(E)) {
     llvm_unreachable("Handled at statement level");
   } else if (auto *UAE = dyn_cast<UnderlyingArrayExpr>(E)) {
-    auto Array = UAE->getArray();
+    auto *Array = UAE->getArray().get();
     assert(!(isa<NullArrayRefExpr>(Array) ||
              MW->M->global_begin() == MW->M->global_end()));
 
@@ -804,7 +586,8 @@ void BPLExprWriter::writeAccessOffsetVar(llvm::raw_ostream &OS,
         OS << " == $arrayId$$" << GA->getName() << ") then "
            << prefix << GA->getName() << " else ";
       }
-      OS << MW->IntRep->getLiteral(0, MW->M->getPointerWidth()) << ")";
+      MW->IntRep->writeLiteral(OS, 0, MW->M->getPointerWidth());
+      OS << ")";
     }
   }
 }
@@ -12,11 +12,36 @@
 #include "bugle/Stmt.h"
 #include "bugle/util/ErrorReporter.h"
 #include "llvm/ADT/StringRef.h"
+#include "llvm/Support/CommandLine.h"
 #include "llvm/Support/ErrorHandling.h"
 #include "llvm/Support/raw_ostream.h"
+#include <algorithm>
 
 using namespace bugle;
 
+static llvm::cl::opt<unsigned> ShareThreshold(
+    "share-threshold", llvm::cl::init(64),
+    llvm::cl::desc("Bind pure subexpressions referenced more than once whose "
+                   "Boogie text is at least this long to variables, so that "
+                   "they are written once (0 disables)"),
+    llvm::cl::value_desc("length"));
+
+// Whether the value of E depends on state which the statements of a function
+// may change, so that it cannot be bound to a variable and then reused.
+static bool readsMutableState(Expr *E) {
+  return isa<LoadExpr>(E) || isa<AccessHasOccurredExpr>(E) ||
+         isa<AccessOffsetExpr>(E) || isa<AtomicHasTakenValueExpr>(E) ||
+         isa<UnderlyingArrayExpr>(E) || isa<OldExpr>(E) || isa<HavocExpr>(E) ||
+         isa<CallExpr>(E) || isa<CallMemberOfExpr>(E) || isa<AtomicExpr>(E) ||
+         isa<ArraySnapshotExpr>(E) || isa<AsyncWorkGroupCopyExpr>(E) ||
+         isa<BVCtlzExpr>(E) || isa<AddNoovflExpr>(E);
+}
+
+BPLFunctionWriter::BPLFunctionWriter(BPLModuleWriter *MW, llvm::raw_ostream &OS,
+                                     bugle::Function *F)
+    : BPLExprWriter(MW), OS(OS), F(F), SLW(MW->SLW), Concurrent(false),
+      NextCandidate(0), BindOS(0), WroteImpure(false) {}
+
 void BPLFunctionWriter::maybeWriteCaseSplit(
     llvm::raw_ostream &OS, Expr *PtrArr, const SourceLocsRef &SLocs,
     std::function<void(GlobalArray *, unsigned int)> F) {
@@ -64,7 +89,39 @@ void BPLFunctionWriter::writeExpr(llvm::raw_ostream &OS, Expr *E,
     return;
   }
 
-  return BPLExprWriter::writeExpr(OS, E, Depth);
+  auto sid = SharedVarIds.find(E);
+  if (sid != SharedVarIds.end()) {
+    OS << "s" << sid->second;
+    return;
+  }
+
+  if (!BindOS)
+    return BPLExprWriter::writeExpr(OS, E, Depth);
+
+  // A subexpression referenced more than once is written aside, and bound to
+  // a variable if it is pure and long enough for this to pay off.  Otherwise
+  // a DAG of such subexpressions could be written out as a tree of
+  // exponential size.
+  bool OuterWroteImpure = WroteImpure;
+  WroteImpure = readsMutableState(E);
+  if (E->refCount < 2 || E->hasEvalStmt) {
+    BPLExprWriter::writeExpr(OS, E, Depth);
+  } else {
+    std::string S;
+    llvm::raw_string_ostream SS(S);
+    BPLExprWriter::writeExpr(SS, E, Depth);
+    SS.flush();
+    if (!WroteImpure && S.size() >= ShareThreshold) {
+      unsigned Id = SharedVarTypes.size();
+      SharedVarTypes.push_back(E->getType());
+      SharedVarIds[E] = Id;
+      *BindOS << "  s" << Id << " := " << S << ";\n";
+      OS << "s" << Id;
+    } else {
+      OS << S;
+    }
+  }
+  WroteImpure |= OuterWroteImpure;
 }
 
 void BPLFunctionWriter::writeCallStmt(llvm::raw_ostream &OS, CallStmt *CS) {
@@ -78,6 +135,79 @@ void BPLFunctionWriter::writeCallStmt(llvm::raw_ostream &OS, CallStmt *CS) {
   OS << ")";
 }
 
+// Writes one quantified assumption for each of the arrays the statement may
+// refer to, which holds if the statement refers to that array.  A copy within
+// one array is not described, as its source may have been overwritten, and
+// neither are arrays of another range type, which it cannot refer to.
+void BPLFunctionWriter::writeAssumeElementsStmt(llvm::raw_ostream &OS,
+                                                AssumeElementsStmt *AES) {
+  auto GetCandidates = [&](Expr *PtrArr) {
+    std::set<GlobalArray *> Globals;
+    if (!PtrArr->computeArrayCandidates(Globals))
+      Globals.insert(MW->M->global_begin(), MW->M->global_end());
+    Globals.erase(nullptr);
+    return Globals;
+  };
+  auto WriteIsArray = [&](Expr *PtrArr, GlobalArray *GA) {
+    MW->UsesPointers = true;
+    OS << "(";
+    writeExpr(OS, PtrArr);
+    OS << " == $arrayId$$" << GA->getName() << ") ==> ";
+  };
+
+  unsigned Width = AES->getOffset()->getType().width;
+  auto WriteElement = [&](GlobalArray *GA, Expr *Offset) {
+    OS << "$$" << GA->getName() << "[";
+    auto *CE = dyn_cast<BVConstExpr>(Offset);
+    if (CE && CE->getValue() == 0) {
+      OS << "i]";
+      return;
+    }
+    useIntrinsic(
+        BPLIntrinsic(BPLIntrinsic::ArithmeticBinary, Expr::BVAdd, Width));
+    OS << "BV" << Width << "_ADD(";
+    writeExpr(OS, Offset);
+    OS << ", i)]";
+  };
+
+  Expr *Dst = AES->getArray().get(), *Src = AES->getSrcArray().get();
+  if (isa<NullArrayRefExpr>(Dst) || (Src && isa<NullArrayRefExpr>(Src)))
+    return;
+  std::set<GlobalArray *> Dsts = GetCandidates(Dst), Srcs;
+  if (Src)
+    Srcs = GetCandidates(Src);
+  else
+    Srcs.insert(nullptr);
+
+  useIntrinsic(BPLIntrinsic(BPLIntrinsic::BooleanBinary, Expr::BVUlt, Width));
+  for (auto *DstGA : Dsts) {
+    Type RangeTy = DstGA->getRangeType();
+    if (!Src && AES->getValue()->getType() != RangeTy)
+      continue;
+    for (auto *SrcGA : Srcs) {
+      if (SrcGA == DstGA || (SrcGA && SrcGA->getRangeType() != RangeTy))
+        continue;
+      OS << "  assume ";
+      if (Dsts.size() > 1)
+        WriteIsArray(Dst, DstGA);
+      if (Srcs.size() > 1)
+        WriteIsArray(Src, SrcGA);
+      OS << "(forall i : " << MW->IntRep->getType(Width) << " :: {";
+      WriteElement(DstGA, AES->getOffset().get());
+      OS << "} BV" << Width << "_ULT(i, ";
+      writeExpr(OS, AES->getCount().get());
+      OS << ") ==> ";
+      WriteElement(DstGA, AES->getOffset().get());
+      OS << " == ";
+      if (SrcGA)
+        WriteElement(SrcGA, AES->getSrcOffset().get());
+      else
+        writeExpr(OS, AES->getValue().get());
+      OS << ");\n";
+    }
+  }
+}
+
 void BPLFunctionWriter::writeStmt(llvm::raw_ostream &OS, Stmt *S) {
   if (auto *ES = dyn_cast<EvalStmt>(S)) {
     assert(!ES->getExpr()->preventEvalStmt);
@@ -122,12 +252,12 @@ void BPLFunctionWriter::writeStmt(llvm::raw_ostream &OS, Stmt *S) {
     } else if (auto *CMOE = dyn_cast<CallMemberOfExpr>(ES->getExpr())) {
       auto CES = CMOE->getCallExprs();
       auto SL = ES->getSourceLocs();
-      auto F = CMOE->getFunc();
+      auto *F = CMOE->getFunc().get();
       OS << "  ";
       for (auto &E : CES) {
         auto *CE = cast<CallExpr>(E);
         OS << "if (";
-        writeExpr(OS, F.get());
+        writeExpr(OS, F);
         OS << " == $functionId$$" << CE->getCallee()->getName() << ") {\n";
         OS << "    call ";
         writeSourceLocs(OS, SL);
@@ -170,10 +300,10 @@ void BPLFunctionWriter::writeStmt(llvm::raw_ostream &OS, Stmt *S) {
         OS << ");";
       });
     } else if (auto *AWGCE = dyn_cast<AsyncWorkGroupCopyExpr>(ES->getExpr())) {
-      auto DstArray = AWGCE->getDst();
-      auto DstOffset = AWGCE->getDstOffset();
-      auto SrcArray = AWGCE->getSrc();
-      auto SrcOffset = AWGCE->getSrcOffset();
+      auto *DstArray = AWGCE->getDst().get();
+      auto *DstOffset = AWGCE->getDstOffset().get();
+      auto *SrcArray = AWGCE->getSrc().get();
+      auto *SrcOffset = AWGCE->getSrcOffset().get();
 
       std::set<GlobalArray *> GlobalsDst;
       if (!DstArray->computeArrayCandidates(GlobalsDst)) {
@@ -194,29 +324,18 @@ void BPLFunctionWriter::writeStmt(llvm::raw_ostream &OS, Stmt *S) {
       auto src = *GlobalsSrc.begin();
       assert(dst->getRangeType() == src->getRangeType());
 
-      MW->writeIntrinsic([&](llvm::raw_ostream &OS) {
-        OS << "procedure {:async_work_group_copy} _ASYNC_WORK_GROUP_COPY_"
-           << dst->getRangeType().width
-           << "(dstOffset : " << MW->IntRep->getType(DstOffset->getType().width)
-           << ", src : [" << MW->IntRep->getType(MW->M->getPointerWidth())
-           << "]" << MW->IntRep->getType(src->getRangeType().width)
-           << ", srcOffset : "
-           << MW->IntRep->getType(SrcOffset->getType().width)
-           << ", size : " << MW->IntRep->getType(MW->M->getPointerWidth())
-           << ", handle : " << MW->IntRep->getType(MW->M->getPointerWidth())
-           << ") returns (handle' : "
-           << MW->IntRep->getType(MW->M->getPointerWidth()) << ", dst : ["
-           << MW->IntRep->getType(MW->M->getPointerWidth()) << "]"
-           << MW->IntRep->getType(dst->getRangeType().width) << ")";
-      });
+      useIntrinsic(BPLIntrinsic(
+          BPLIntrinsic::AsyncWorkGroupCopy, 0, dst->getRangeType().width,
+          DstOffset->getType().width, src->getRangeType().width,
+          SrcOffset->getType().width));
       writeSourceLocsMarker(OS, ES->getSourceLocs(), 2);
       OS << "  ";
       OS << "call {:async_work_group_copy} v" << id << ", $$" << dst->getName()
          << " := _ASYNC_WORK_GROUP_COPY_" << dst->getRangeType().width << "(";
-      writeExpr(OS, DstOffset.get());
+      writeExpr(OS, DstOffset);
       OS << ", "
          << "$$" << src->getName() << ", ";
-      writeExpr(OS, SrcOffset.get());
+      writeExpr(OS, SrcOffset);
       OS << ", ";
       writeExpr(OS, AWGCE->getSize().get());
       OS << ", ";
@@ -225,16 +344,9 @@ void BPLFunctionWriter::writeStmt(llvm::raw_ostream &OS, Stmt *S) {
     } else if (auto *CE = dyn_cast<BVCtlzExpr>(ES->getExpr())) {
       unsigned Width = CE->getVal()->getType().width;
 
-      MW->writeIntrinsic([&](llvm::raw_ostream &OS) {
-                           OS << MW->IntRep->getArithmeticBinary(
-                               "LSHR", Expr::BVLShr, Width);
-                         },
-                         false);
-
-      MW->writeIntrinsic([&](llvm::raw_ostream &OS) {
-                           OS << MW->IntRep->getCtlz(Width);
-                         },
-                         false);
+      useIntrinsic(
+          BPLIntrinsic(BPLIntrinsic::ArithmeticBinary, Expr::BVLShr, Width));
+      useIntrinsic(BPLIntrinsic(BPLIntrinsic::Ctlz, 0, Width));
 
       OS << "  call v" << id << " := BV" << Width << "_CTLZ(";
       writeExpr(OS, CE->getVal().get());
@@ -255,12 +367,12 @@ void BPLFunctionWriter::writeStmt(llvm::raw_ostream &OS, Stmt *S) {
   } else if (auto *CMOS = dyn_cast<CallMemberOfStmt>(S)) {
     auto CSS = CMOS->getCallStmts();
     auto SL = S->getSourceLocs();
-    auto F = CMOS->getFunc();
+    auto *F = CMOS->getFunc().get();
     OS << "  ";
     for (auto *S : CSS) {
       auto *CS = cast<CallStmt>(S);
       OS << "if (";
-      writeExpr(OS, F.get());
+      writeExpr(OS, F);
       OS << " == $functionId$$" << CS->getCallee()->getName() << ") {\n";
       OS << "    call ";
       writeSourceLocs(OS, SL);
@@ -327,29 +439,25 @@ void BPLFunctionWriter::writeStmt(llvm::raw_ostream &OS, Stmt *S) {
       OS << "{:block_sourceloc} ";
     writeSourceLocs(OS, AtS->getSourceLocs());
     if (AtS->isCandidate()) {
-      unsigned candidateNumber = MW->nextCandidateNumber();
+      unsigned candidateNumber =
+          Concurrent ? NextCandidate++ : MW->nextCandidateNumber();
       OS << "_c" << candidateNumber << " ==> ";
-      MW->writeIntrinsic([&](llvm::raw_ostream &OS) {
-                           OS << "const {:existential true} _c"
-                              << candidateNumber << " : bool";
-                         },
-                         true);
+      useIntrinsic(BPLIntrinsic(BPLIntrinsic::Candidate, candidateNumber));
     }
     writeExpr(OS, AtS->getPredicate().get());
     OS << ";\n";
   } else if (isa<ReturnStmt>(S)) {
     OS << "  return;\n";
   } else if (auto *WGES = dyn_cast<WaitGroupEventStmt>(S)) {
-    MW->writeIntrinsic([&](llvm::raw_ostream &OS) {
-      OS << "procedure {:wait_group_events} _WAIT_GROUP_EVENTS(handle : "
-         << MW->IntRep->getType(MW->M->getPointerWidth()) << ")";
-    });
+    useIntrinsic(BPLIntrinsic(BPLIntrinsic::WaitGroupEvents));
     OS << "  ";
     OS << "call {:wait_group_events} ";
     writeSourceLocs(OS, S->getSourceLocs());
     OS << "_WAIT_GROUP_EVENTS(";
     writeExpr(OS, WGES->getHandle().get());
     OS << ");\n";
+  } else if (auto *AES = dyn_cast<AssumeElementsStmt>(S)) {
+    writeAssumeElementsStmt(OS, AES);
   } else {
     llvm_unreachable("Unsupported statement");
   }
@@ -357,16 +465,45 @@ void BPLFunctionWriter::writeStmt(llvm::raw_ostream &OS, Stmt *S) {
 
 void BPLFunctionWriter::writeBasicBlock(llvm::raw_ostream &OS, BasicBlock *BB) {
   OS << "$" << BB->getName() << ":\n";
-  for (auto *E : *BB)
-    writeStmt(OS, E);
+  SharedVarIds.clear();
+  // No bindings are made among the assertions and assumptions at the start of
+  // the block, as these include the invariants of a loop and must remain at
+  // the start of its header.
+  bool Leading = true;
+  for (auto *S : *BB) {
+    if (!isa<AssertStmt>(S) && !isa<AssumeStmt>(S))
+      Leading = false;
+    if (ShareThreshold == 0 || Leading) {
+      writeStmt(OS, S);
+    } else {
+      // The statement is buffered, so that the bindings it makes precede it.
+      std::string Stmt;
+      llvm::raw_string_ostream StmtOS(Stmt);
+      BindOS = &OS;
+      writeStmt(StmtOS, S);
+      BindOS = 0;
+      OS << StmtOS.str();
+    }
+    // Assigning to variables may change the values of the bound expressions.
+    if (isa<VarAssignStmt>(S))
+      SharedVarIds.clear();
+  }
 }
 
 void BPLFunctionWriter::writeSourceLocs(llvm::raw_ostream &OS,
                                         const SourceLocsRef &sourcelocs) {
   if (sourcelocs.get() == 0 || sourcelocs->size() == 0)
     return;
-  unsigned locnum = MW->SLW->writeSourceLocs(sourcelocs);
-  OS << "{:sourceloc_num " << locnum << "}";
+  // The locations are recorded when the function is written for real.
+  if (MW->PrePass)
+    return;
+  unsigned locnum = SLW->writeSourceLocs(sourcelocs);
+  OS << "{:sourceloc_num ";
+  if (Concurrent)
+    OS << SourceLocMarker << locnum << SourceLocMarker;
+  else
+    OS << locnum;
+  OS << "}";
   OS << " ";
 }
 
@@ -380,6 +517,51 @@ void BPLFunctionWriter::writeSourceLocsMarker(llvm::raw_ostream &OS,
   OS << "true;\n";
 }
 
+void BPLFunctionWriter::writeSSAVarDecl(llvm::raw_ostream &OS, unsigned Id,
+                                        Type T) {
+  OS << "  var v" << Id << ":";
+  MW->writeType(OS, T);
+  OS << ";\n";
+}
+
+void BPLFunctionWriter::writeSharedVarDecls(llvm::raw_ostream &OS,
+                                            const std::vector<Type> &Types) {
+  for (unsigned i = 0; i < Types.size(); ++i) {
+    OS << "  var s" << i << ":";
+    MW->writeType(OS, Types[i]);
+    OS << ";\n";
+  }
+}
+
+// The SSA variables in the order of their ids, rather than of the addresses
+// of their expressions, so that the declarations do not depend on allocation.
+std::vector<std::pair<unsigned, Type>>
+BPLFunctionWriter::getSSAVarTypes() const {
+  std::vector<std::pair<unsigned, Type>> Types;
+  for (const auto &VarId : SSAVarIds)
+    Types.push_back(std::make_pair(VarId.second, VarId.first->getType()));
+  std::sort(Types.begin(), Types.end(),
+            [](const std::pair<unsigned, Type> &LHS,
+               const std::pair<unsigned, Type> &RHS) {
+              return LHS.first < RHS.first;
+            });
+  return Types;
+}
+
+unsigned BPLFunctionWriter::countCandidates(bugle::Function *F) {
+  if (F->isSpecification())
+    return 0;
+  unsigned Count = 0;
+  for (auto *BB : *F) {
+    for (auto *S : *BB) {
+      auto *AtS = dyn_cast<AssertStmt>(S);
+      if (AtS && AtS->isCandidate())
+        ++Count;
+    }
+  }
+  return Count;
+}
+
 void BPLFunctionWriter::writeVar(llvm::raw_ostream &OS, Var *V) {
   OS << "$" << V->getName() << ":";
   MW->writeType(OS, V->getType());
@@ -481,10 +663,18 @@ void BPLFunctionWriter::write() {
       return;
     }
 
+    // The SSA variables are declared before the body but only known once it
+    // has been written, so the body is buffered unless a pre-pass has already
+    // found them, or this is the pre-pass and the output is discarded.
+    auto SSAVarTypes = MW->SSAVarTypes.find(F);
+    bool BufferBody = !MW->PrePass && SSAVarTypes == MW->SSAVarTypes.end();
+
     std::string Body;
     llvm::raw_string_ostream BodyOS(Body);
-    for (auto *BB : *F) {
-      writeBasicBlock(BodyOS, BB);
+    if (BufferBody) {
+      for (auto *BB : *F) {
+        writeBasicBlock(BodyOS, BB);
+      }
     }
 
     OS << "{\n";
@@ -495,13 +685,24 @@ void BPLFunctionWriter::write() {
       OS << ";\n";
     }
 
-    for (const auto &VarId : SSAVarIds) {
-      OS << "  var v" << VarId.second << ":";
-      MW->writeType(OS, VarId.first->getType());
-      OS << ";\n";
+    if (BufferBody) {
+      for (const auto &VarType : getSSAVarTypes())
+        writeSSAVarDecl(OS, VarType.first, VarType.second);
+      writeSharedVarDecls(OS, SharedVarTypes);
+      OS << BodyOS.str();
+    } else if (MW->PrePass) {
+      for (auto *BB : *F)
+        writeBasicBlock(OS, BB);
+      for (const auto &VarType : getSSAVarTypes())
+        writeSSAVarDecl(OS, VarType.first, VarType.second);
+      writeSharedVarDecls(OS, SharedVarTypes);
+    } else {
+      for (const auto &VarType : SSAVarTypes->second)
+        writeSSAVarDecl(OS, VarType.first, VarType.second);
+      writeSharedVarDecls(OS, MW->SharedVarTypes[F]);
+      for (auto *BB : *F)
+        writeBasicBlock(OS, BB);
     }
-
-    OS << BodyOS.str();
     OS << "}\n";
   }
 }
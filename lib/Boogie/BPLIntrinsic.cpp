@@ -0,0 +1,130 @@
+#include "bugle/BPLIntrinsic.h"
+#include "llvm/ADT/Hashing.h"
+#include "llvm/Support/ErrorHandling.h"
+#include "llvm/Support/raw_ostream.h"
+
+using namespace bugle;
+
+static llvm::hash_code hashType(Type T) {
+  return llvm::hash_combine(T.array, (unsigned)T.kind, (unsigned)T.width);
+}
+
+bool BPLIntrinsic::operator==(const BPLIntrinsic &Other) const {
+  return K == Other.K && Op == Other.Op && Widths[0] == Other.Widths[0] &&
+         Widths[1] == Other.Widths[1] && Widths[2] == Other.Widths[2] &&
+         Widths[3] == Other.Widths[3] && T0 == Other.T0 && T1 == Other.T1 &&
+         Ptr == Other.Ptr;
+}
+
+size_t BPLIntrinsic::Hash::operator()(const BPLIntrinsic &I) const {
+  return llvm::hash_combine((unsigned)I.K, I.Op, I.Widths[0], I.Widths[1],
+                            I.Widths[2], I.Widths[3], hashType(I.T0),
+                            hashType(I.T1), I.Ptr);
+}
+
+const char *BPLIntrinsic::getBinaryName(Expr::Kind Kind) {
+  switch (Kind) {
+  case Expr::BVAdd:     return "ADD";
+  case Expr::BVSub:     return "SUB";
+  case Expr::BVMul:     return "MUL";
+  case Expr::BVSDiv:    return "SDIV";
+  case Expr::BVUDiv:    return "UDIV";
+  case Expr::BVSRem:    return "SREM";
+  case Expr::BVURem:    return "UREM";
+  case Expr::BVShl:     return "SHL";
+  case Expr::BVAShr:    return "ASHR";
+  case Expr::BVLShr:    return "LSHR";
+  case Expr::BVAnd:     return "AND";
+  case Expr::BVOr:      return "OR";
+  case Expr::BVXor:     return "XOR";
+  case Expr::BVUgt:     return "UGT";
+  case Expr::BVUge:     return "UGE";
+  case Expr::BVUlt:     return "ULT";
+  case Expr::BVUle:     return "ULE";
+  case Expr::BVSgt:     return "SGT";
+  case Expr::BVSge:     return "SGE";
+  case Expr::BVSlt:     return "SLT";
+  case Expr::BVSle:     return "SLE";
+  case Expr::FAdd:      return "FADD";
+  case Expr::FSub:      return "FSUB";
+  case Expr::FMul:      return "FMUL";
+  case Expr::FRem:      return "FREM";
+  case Expr::FDiv:      return "FDIV";
+  case Expr::FPow:      return "FPOW";
+  case Expr::FMax:      return "FMAX";
+  case Expr::FMin:      return "FMIN";
+  case Expr::FPowi:     return "FPOWI";
+  case Expr::FEq:       return "FEQ";
+  case Expr::FLt:       return "FLT";
+  case Expr::FUno:      return "FUNO";
+  case Expr::PtrLt:     return "PTR_LT";
+  case Expr::FuncPtrLt: return "FUNCPTR_LT";
+  default:
+    llvm_unreachable("Unsupported binary expr opcode");
+  }
+}
+
+void BPLIntrinsic::writeName(llvm::raw_ostream &OS) const {
+  Expr::Kind Kind = (Expr::Kind)Op;
+  if (K == BinaryFunction) {
+    OS << getBinaryName(Kind);
+    switch (Kind) {
+    case Expr::PtrLt:
+    case Expr::FuncPtrLt:
+      break;
+    case Expr::FPowi:
+      OS << T0.width << "_I" << T1.width;
+      break;
+    default:
+      OS << T0.width;
+      break;
+    }
+    return;
+  }
+
+  assert(K == UnaryFunction);
+  unsigned FromWidth = T0.width, ToWidth = T1.width;
+  switch (Kind) {
+  case Expr::BVToPtr:        OS << "BV" << FromWidth << "_TO_PTR";      break;
+  case Expr::PtrToBV:        OS << "PTR_TO_BV" << ToWidth;             break;
+  case Expr::BVToFuncPtr:    OS << "BV" << FromWidth << "_TO_FUNCPTR";  break;
+  case Expr::FuncPtrToBV:    OS << "FUNCPTR_TO_BV" << ToWidth;         break;
+  case Expr::PtrToFuncPtr:   OS << "PTR_TO_FUNCPTR";                   break;
+  case Expr::FuncPtrToPtr:   OS << "FUNCPTR_TO_PTR";                   break;
+  case Expr::BVCtpop:        OS << "BV" << FromWidth << "_CTPOP";       break;
+  case Expr::FAbs:           OS << "FABS" << ToWidth;                  break;
+  case Expr::FCeil:          OS << "FCEIL" << ToWidth;                 break;
+  case Expr::FCos:           OS << "FCOS" << ToWidth;                  break;
+  case Expr::FExp:           OS << "FEXP" << ToWidth;                  break;
+  case Expr::FExp2:          OS << "FEXP2" << ToWidth;                 break;
+  case Expr::FFloor:         OS << "FFLOOR" << ToWidth;                break;
+  case Expr::FLog:           OS << "FLOG" << ToWidth;                  break;
+  case Expr::FLog10:         OS << "FLOG10" << ToWidth;                break;
+  case Expr::FLog2:          OS << "FLOG2" << ToWidth;                 break;
+  case Expr::FPConv:         OS << "FP" << FromWidth << "_CONV" << ToWidth;
+                                                                       break;
+  case Expr::FPToSI:         OS << "FP" << FromWidth << "_TO_SI" << ToWidth;
+                                                                       break;
+  case Expr::FPToUI:         OS << "FP" << FromWidth << "_TO_UI" << ToWidth;
+                                                                       break;
+  case Expr::FrexpExp:       OS << "FREXP" << FromWidth << "_EXP";      break;
+  case Expr::FrexpFrac:      OS << "FREXP" << FromWidth << "_FRAC" << ToWidth;
+                                                                       break;
+  case Expr::FRint:          OS << "FRINT" << ToWidth;                 break;
+  case Expr::FRsqrt:         OS << "FRSQRT" << ToWidth;                break;
+  case Expr::FSin:           OS << "FSIN" << ToWidth;                  break;
+  case Expr::FSqrt:          OS << "FSQRT" << ToWidth;                 break;
+  case Expr::FTrunc:         OS << "FTRUNC" << ToWidth;                break;
+  case Expr::OtherInt:       OS << "__other_bv" << ToWidth;            break;
+  case Expr::OtherBool:      OS << "__other_bool";                     break;
+  case Expr::OtherPtrBase:   OS << "__other_arrayId";                  break;
+  case Expr::SIToFP:         OS << "SI" << FromWidth << "_TO_FP" << ToWidth;
+                                                                       break;
+  case Expr::UIToFP:         OS << "UI" << FromWidth << "_TO_FP" << ToWidth;
+                                                                       break;
+  case Expr::GetImageWidth:  OS << "GET_IMAGE_WIDTH";                  break;
+  case Expr::GetImageHeight: OS << "GET_IMAGE_HEIGHT";                 break;
+  default:
+    llvm_unreachable("Unsupported unary expr opcode");
+  }
+}
@@ -1,18 +1,45 @@
 #include "bugle/BPLModuleWriter.h"
 #include "bugle/BPLFunctionWriter.h"
+#include "bugle/BasicBlock.h"
+#include "bugle/Expr.h"
+#include "bugle/GlobalArray.h"
 #include "bugle/IntegerRepresentation.h"
 #include "bugle/Module.h"
 #include "bugle/RaceInstrumenter.h"
+#include "bugle/SourceLocWriter.h"
+#include "bugle/Stmt.h"
 #include "bugle/Type.h"
+#include "llvm/Support/CommandLine.h"
 #include "llvm/Support/ErrorHandling.h"
+#include "llvm/Support/ThreadPool.h"
 #include "llvm/Support/raw_ostream.h"
 #include <cmath>
+#include <functional>
+#include <set>
 
 using namespace bugle;
 
+static llvm::cl::opt<unsigned> GlobalInitRunThreshold(
+    "global-init-run-threshold", llvm::cl::init(4),
+    llvm::cl::desc("Write runs of at least this many equal global array "
+                   "initialisers as a single quantified precondition "
+                   "(0 disables)"));
+
+static llvm::cl::opt<bool> ConstantReadOnlyArrays(
+    "constant-read-only-arrays", llvm::cl::init(false),
+    llvm::cl::desc("Declare global arrays which are never written as "
+                   "constants, with their initial values as axioms"));
+
+void BPLModuleWriter::useType(const Type &t) {
+  if (t.array || t.kind == Type::Pointer)
+    UsesPointers = true;
+  else if (t.kind == Type::FunctionPointer)
+    UsesFunctionPointers = true;
+}
+
 void BPLModuleWriter::writeType(llvm::raw_ostream &OS, const Type &t) {
+  useType(t);
   if (t.array) {
-    UsesPointers = true;
     OS << "arrayId";
     return;
   }
@@ -24,11 +51,9 @@ void BPLModuleWriter::writeType(llvm::raw_ostream &OS, const Type &t) {
     OS << MW->IntRep->getType(t.width);
     break;
   case Type::Pointer:
-    UsesPointers = true;
     OS << "ptr";
     break;
   case Type::FunctionPointer:
-    UsesFunctionPointers = true;
     OS << "functionPtr";
     break;
   case Type::Any:
@@ -37,48 +62,469 @@ void BPLModuleWriter::writeType(llvm::raw_ostream &OS, const Type &t) {
   }
 }
 
-void BPLModuleWriter::writeIntrinsic(std::function<void(llvm::raw_ostream &)> F,
-                                     bool addSeparator) {
-  std::string S;
-  llvm::raw_string_ostream SS(S);
-  F(SS);
-  if (addSeparator) {
-    SS << ";";
+void BPLModuleWriter::useIntrinsic(const BPLIntrinsic &I, Expr *Origin) {
+  if (!Intrinsics.insert(std::make_pair(I, Origin)).second)
+    return;
+
+  // The declaration is written after the parts of the prelude which depend on
+  // the types used by the module, so the types it uses are noted here.
+  useType(I.T0);
+  useType(I.T1);
+  if (I.K == BPLIntrinsic::UninterpretedFunction) {
+    auto *UFE = cast<UninterpretedFunctionExpr>(Origin);
+    for (unsigned i = 0; i < UFE->getNumOperands(); ++i)
+      useType(UFE->getOperand(i)->getType());
+    useType(UFE->getType());
   }
-  IntrinsicSet.insert(SS.str());
+}
+
+void BPLModuleWriter::writeIntrinsic(llvm::raw_ostream &OS,
+                                     const BPLIntrinsic &I, Expr *Origin) {
+  Expr::Kind Kind = (Expr::Kind)I.Op;
+  unsigned Width = I.Widths[0];
+  switch (I.K) {
+  case BPLIntrinsic::Extract:
+    IntRep->writeExtract(OS);
+    return;
+  case BPLIntrinsic::Concat:
+    IntRep->writeConcat(OS);
+    return;
+  case BPLIntrinsic::ZeroExtend:
+    IntRep->writeZeroExtend(OS, I.Widths[0], I.Widths[1]);
+    return;
+  case BPLIntrinsic::SignExtend:
+    IntRep->writeSignExtend(OS, I.Widths[0], I.Widths[1]);
+    return;
+  case BPLIntrinsic::ArithmeticBinary:
+    IntRep->writeArithmeticBinary(OS, BPLIntrinsic::getBinaryName(Kind), Kind,
+                                  Width);
+    return;
+  case BPLIntrinsic::BooleanBinary:
+    IntRep->writeBooleanBinary(OS, BPLIntrinsic::getBinaryName(Kind), Kind,
+                               Width);
+    return;
+  case BPLIntrinsic::Ctlz:
+    IntRep->writeCtlz(OS, Width);
+    return;
+  case BPLIntrinsic::AddNoovflSigned:
+  case BPLIntrinsic::AddNoovflUnsigned: {
+    bool IsSigned = I.K == BPLIntrinsic::AddNoovflSigned;
+    auto X = [](llvm::raw_ostream &OS) { OS << "x"; };
+    auto Y = [](llvm::raw_ostream &OS) { OS << "y"; };
+    auto Zero = [&](llvm::raw_ostream &OS) { IntRep->writeLiteral(OS, 0, 1); };
+    // The sum of x and y, each zero extended by one bit.
+    auto WideSum = [&](llvm::raw_ostream &OS) {
+      OS << "BV" << (Width + 1) << "_ADD(";
+      IntRep->writeConcatExpr(OS, Zero, X);
+      OS << ", ";
+      IntRep->writeConcatExpr(OS, Zero, Y);
+      OS << ")";
+    };
+
+    OS << "procedure {:inline 1} $__add_noovfl_"
+       << (IsSigned ? "signed" : "unsigned") << "_" << Width
+       << "(x : " << IntRep->getType(Width)
+       << ", y : " << IntRep->getType(Width)
+       << ") returns (z : " << IntRep->getType(Width) << ") {\n"
+       << "  assume ";
+    IntRep->writeExtractExpr(OS, WideSum, Width + 1, Width);
+    OS << " == ";
+    IntRep->writeLiteral(OS, 0, 1);
+    OS << ";\n";
+    if (IsSigned) {
+      OS << "  assume ";
+      IntRep->writeExtractExpr(OS, X, Width, Width - 1);
+      OS << " == ";
+      IntRep->writeExtractExpr(OS, Y, Width, Width - 1);
+      OS << " ==> ";
+      IntRep->writeExtractExpr(OS,
+                               [&](llvm::raw_ostream &OS) {
+                                 OS << "BV" << Width << "_ADD(x, y)";
+                               },
+                               Width, Width - 1);
+      OS << " == ";
+      IntRep->writeExtractExpr(OS, X, Width, Width - 1);
+      OS << ";\n";
+    }
+    OS << "  z := BV" << Width << "_ADD(x, y);\n"
+       << "}";
+    return;
+  }
+  case BPLIntrinsic::AddNoovflPredicate: {
+    unsigned n = I.Op;
+    unsigned b = (unsigned)std::ceil(std::log((double)n) / std::log((double)2));
+    // The sum of the first Count operands, each zero extended by b bits.
+    std::function<void(llvm::raw_ostream &, unsigned)> WriteSum =
+        [&](llvm::raw_ostream &OS, unsigned Count) {
+          auto Zero = [&](llvm::raw_ostream &OS) {
+            IntRep->writeLiteral(OS, 0, b);
+          };
+          auto V = [&](llvm::raw_ostream &OS) { OS << "v" << (Count - 1); };
+          if (Count == 1) {
+            IntRep->writeConcatExpr(OS, Zero, V);
+            return;
+          }
+          OS << "BV" << (Width + b) << "_ADD(";
+          WriteSum(OS, Count - 1);
+          OS << ", ";
+          IntRep->writeConcatExpr(OS, Zero, V);
+          OS << ")";
+        };
+
+    OS << "function {:inline true} __add_noovfl_" << n << "(";
+    for (unsigned i = 0; i < n; ++i) {
+      OS << (i > 0 ? ", " : "") << "v" << i << ":" << IntRep->getType(Width);
+    }
+    OS << ") : " << IntRep->getType(1) << " {";
+    if (n == 1) {
+      IntRep->writeLiteral(OS, 1, 1);
+    } else {
+      OS << "if ";
+      IntRep->writeExtractExpr(
+          OS, [&](llvm::raw_ostream &OS) { WriteSum(OS, n); }, Width + b,
+          Width);
+      OS << " == ";
+      IntRep->writeLiteral(OS, 0, b);
+      OS << " then ";
+      IntRep->writeLiteral(OS, 1, 1);
+      OS << " else ";
+      IntRep->writeLiteral(OS, 0, 1);
+    }
+    OS << "}";
+    return;
+  }
+  case BPLIntrinsic::Candidate:
+    OS << "const {:existential true} _c" << I.Op << " : bool";
+    break;
+  case BPLIntrinsic::AsyncWorkGroupCopy: {
+    const std::string &PtrType = IntRep->getType(M->getPointerWidth());
+    OS << "procedure {:async_work_group_copy} _ASYNC_WORK_GROUP_COPY_"
+       << I.Widths[0] << "(dstOffset : " << IntRep->getType(I.Widths[1])
+       << ", src : [" << PtrType << "]" << IntRep->getType(I.Widths[2])
+       << ", srcOffset : " << IntRep->getType(I.Widths[3])
+       << ", size : " << PtrType << ", handle : " << PtrType
+       << ") returns (handle' : " << PtrType << ", dst : [" << PtrType << "]"
+       << IntRep->getType(I.Widths[0]) << ")";
+    break;
+  }
+  case BPLIntrinsic::WaitGroupEvents:
+    OS << "procedure {:wait_group_events} _WAIT_GROUP_EVENTS(handle : "
+       << IntRep->getType(M->getPointerWidth()) << ")";
+    break;
+  case BPLIntrinsic::SpecialVar: {
+    const std::string &Attr = *static_cast<const std::string *>(I.Ptr);
+    OS << "const {:" << Attr << "} " << Attr << " : ";
+    writeType(OS, I.T0);
+    break;
+  }
+  case BPLIntrinsic::UninterpretedFunction: {
+    auto *UFE = cast<UninterpretedFunctionExpr>(Origin);
+    OS << "function " << UFE->getName() << "(";
+    for (unsigned i = 0; i < UFE->getNumOperands(); ++i) {
+      if (i > 0)
+        OS << ", ";
+      writeType(OS, UFE->getOperand(i)->getType());
+    }
+    OS << ") : ";
+    writeType(OS, UFE->getType());
+    break;
+  }
+  case BPLIntrinsic::AtomicUsedMap: {
+    auto *GA = static_cast<const GlobalArray *>(I.Ptr);
+    OS << "var {:atomic_usedmap} ";
+    if (GA->isGlobal())
+      OS << "{:atomic_global}";
+    else if (GA->isGroupShared())
+      OS << "{:atomic_group_shared}";
+    OS << "_USED_$$" << GA->getName() << " : [";
+    writeType(OS, I.T0);
+    OS << "][";
+    writeType(OS, I.T1);
+    OS << "]bool";
+    break;
+  }
+  case BPLIntrinsic::UnaryFunction:
+    OS << "function ";
+    I.writeName(OS);
+    OS << "(";
+    writeType(OS, I.T0);
+    OS << ") : ";
+    writeType(OS, I.T1);
+    break;
+  case BPLIntrinsic::BinaryFunction:
+    OS << "function ";
+    I.writeName(OS);
+    OS << "(";
+    writeType(OS, I.T0);
+    OS << ", ";
+    writeType(OS, Kind == Expr::FPowi ? I.T1 : I.T0);
+    OS << ") : ";
+    switch (Kind) {
+    case Expr::FEq:
+    case Expr::FLt:
+    case Expr::FUno:
+    case Expr::PtrLt:
+    case Expr::FuncPtrLt:
+      OS << "bool";
+      break;
+    default:
+      writeType(OS, I.T0);
+      break;
+    }
+    break;
+  }
+  OS << ";";
+}
+
+void BPLModuleWriter::findReadOnlyArrays() {
+  std::set<GlobalArray *> Written;
+  auto Write = [&](Expr *Array) {
+    if (!Array->computeArrayCandidates(Written))
+      Written.insert(M->global_begin(), M->global_end());
+  };
+
+  // The race instrumentation state of the arrays specifications refer to is
+  // declared with the arrays, so these are kept as variables.
+  for (auto i = M->instrumented_array_begin(),
+            e = M->instrumented_array_end();
+       i != e; ++i)
+    Write(i->get());
+
+  for (auto fi = M->function_begin(), fe = M->function_end(); fi != fe;
+       ++fi) {
+    auto *F = *fi;
+    for (auto i = F->modifies_begin(), e = F->modifies_end(); i != e; ++i) {
+      if (auto *UAE = dyn_cast<UnderlyingArrayExpr>((*i)->getExpr()))
+        Write(UAE->getArray().get());
+    }
+    for (auto *BB : *F) {
+      for (auto *S : *BB) {
+        if (auto *SS = dyn_cast<StoreStmt>(S)) {
+          Write(SS->getArray().get());
+        } else if (auto *ES = dyn_cast<EvalStmt>(S)) {
+          Expr *E = ES->getExpr().get();
+          if (auto *AE = dyn_cast<AtomicExpr>(E))
+            Write(AE->getArray().get());
+          else if (auto *ASE = dyn_cast<ArraySnapshotExpr>(E))
+            Write(ASE->getDst().get());
+          else if (auto *AWGCE = dyn_cast<AsyncWorkGroupCopyExpr>(E))
+            Write(AWGCE->getDst().get());
+        }
+      }
+    }
+  }
+
+  for (auto i = M->global_begin(), e = M->global_end(); i != e; ++i) {
+    if (!Written.count(*i))
+      ReadOnlyArrays.insert(*i);
+  }
+}
+
+void BPLModuleWriter::writeGlobalInit(llvm::raw_ostream &OS,
+                                      const GlobalInit &GI,
+                                      const std::string &Array,
+                                      const char *Separator) {
+  unsigned PtrWidth = M->getPointerWidth();
+  if (GlobalInitRunThreshold == 0 || GI.count < GlobalInitRunThreshold) {
+    for (uint64_t j = 0; j != GI.count; ++j) {
+      if (j != 0)
+        OS << Separator;
+      OS << Array << "[";
+      MW->IntRep->writeLiteral(OS, GI.offset + j, PtrWidth);
+      OS << "] == ";
+      writeExpr(OS, GI.init.get());
+    }
+    return;
+  }
+  useIntrinsic(
+      BPLIntrinsic(BPLIntrinsic::BooleanBinary, Expr::BVUle, PtrWidth));
+  OS << "(forall i : " << MW->IntRep->getType(PtrWidth) << " :: {" << Array
+     << "[i]} BV" << PtrWidth << "_ULE(";
+  MW->IntRep->writeLiteral(OS, GI.offset, PtrWidth);
+  OS << ", i) && BV" << PtrWidth << "_ULE(i, ";
+  MW->IntRep->writeLiteral(OS, GI.offset + GI.count - 1, PtrWidth);
+  OS << ") ==> " << Array << "[i] == ";
+  writeExpr(OS, GI.init.get());
+  OS << ")";
 }
 
 const std::string &BPLModuleWriter::getGlobalInitRequires() {
-  if (GlobalInitRequires.empty() &&
+  if (GlobalInitDecls.empty() &&
       M->global_init_begin() != M->global_init_end()) {
-    llvm::raw_string_ostream SS(GlobalInitRequires);
+    llvm::raw_string_ostream SS(GlobalInitDecls);
+
+    // The initial values of constant arrays are axioms.
     for (auto i = M->global_init_begin(), e = M->global_init_end(); i != e;
          ++i) {
-      SS << "requires "
-         << "$$" << i->array->getName() << "["
-         << MW->IntRep->getLiteral(i->offset, M->getPointerWidth())
-         << "] == ";
-      writeExpr(SS, i->init.get());
+      if (!ReadOnlyArrays.count(i->array))
+        continue;
+      SS << "axiom ";
+      writeGlobalInit(SS, *i, "$$" + i->array->getName(), ";\naxiom ");
       SS << ";\n";
     }
+
+    // Those of variables are written once, as the body of a function of the
+    // arrays, which each entry point requires to hold.  The parameters are
+    // prefixed, so that they do not shadow the arrays.
+    std::vector<GlobalArray *> Arrays;
+    std::set<GlobalArray *> Seen;
+    for (auto i = M->global_init_begin(), e = M->global_init_end(); i != e;
+         ++i) {
+      if (!ReadOnlyArrays.count(i->array) && Seen.insert(i->array).second)
+        Arrays.push_back(i->array);
+    }
+
+    if (!Arrays.empty()) {
+      SS << "function {:inline true} _GLOBAL_INIT(";
+      for (auto b = Arrays.begin(), i = b, e = Arrays.end(); i != e; ++i) {
+        if (i != b)
+          SS << ", ";
+        SS << "init$$" << (*i)->getName() << " : ["
+           << MW->IntRep->getType(M->getPointerWidth()) << "]";
+        writeType(SS, (*i)->getRangeType());
+      }
+      SS << ") : bool {\n  ";
+      bool First = true;
+      for (auto i = M->global_init_begin(), e = M->global_init_end(); i != e;
+           ++i) {
+        if (ReadOnlyArrays.count(i->array))
+          continue;
+        if (!First)
+          SS << " &&\n  ";
+        First = false;
+        writeGlobalInit(SS, *i, "init$$" + i->array->getName(), " &&\n  ");
+      }
+      SS << "\n}\n\n";
+
+      llvm::raw_string_ostream RS(GlobalInitRequires);
+      RS << "requires _GLOBAL_INIT(";
+      for (auto b = Arrays.begin(), i = b, e = Arrays.end(); i != e; ++i) {
+        if (i != b)
+          RS << ", ";
+        RS << "$$" << (*i)->getName();
+      }
+      RS << ");\n";
+    }
   }
   return GlobalInitRequires;
 }
 
+void BPLModuleWriter::writeFunctions(llvm::raw_ostream &OS) {
+  // Streaming writes each function as it goes, so does not write them
+  // concurrently.
+  if (Threads > 1 && !Stream) {
+    writeFunctionsConcurrently(OS);
+  } else {
+    for (auto i = M->function_begin(), e = M->function_end(); i != e; ++i) {
+      BPLFunctionWriter FW(this, OS, *i);
+      FW.write();
+      if (PrePass) {
+        SSAVarTypes[*i] = FW.getSSAVarTypes();
+        SharedVarTypes[*i] = FW.getSharedVarTypes();
+      }
+    }
+  }
+
+  for (auto i = M->axiom_begin(), e = M->axiom_end(); i != e; ++i) {
+    OS << "axiom ";
+    writeExpr(OS, i->get());
+    OS << ";\n";
+  }
+}
+
+// Writes Text, replacing the local number of each source location marked in
+// it by its number in the module.
+static void writeRenumbered(llvm::raw_ostream &OS, llvm::StringRef Text,
+                            const std::vector<unsigned> &Numbers) {
+  const char Marker = BPLFunctionWriter::SourceLocMarker;
+  while (true) {
+    size_t Begin = Text.find(Marker);
+    OS << Text.substr(0, Begin);
+    if (Begin == llvm::StringRef::npos)
+      return;
+    size_t End = Text.find(Marker, Begin + 1);
+    unsigned Num = 0;
+    Text.slice(Begin + 1, End).getAsInteger(10, Num);
+    OS << Numbers[Num];
+    Text = Text.substr(End + 1);
+  }
+}
+
+// Writes the functions on Threads threads.  Each function is written to its
+// own buffer, with its own table of intrinsics and its own numbering of source
+// locations, and its candidates numbered from the count of those of the
+// functions before it.  The buffers are then written in the order of the
+// functions, numbering their source locations in the module, so that the
+// output is the same as if the functions were written one after the other.
+void BPLModuleWriter::writeFunctionsConcurrently(llvm::raw_ostream &OS) {
+  struct FunctionOutput {
+    std::string Text;
+    std::vector<SourceLocsRef> SourceLocs;
+    BPLIntrinsicTable Intrinsics;
+  };
+
+  std::vector<bugle::Function *> Fs(M->function_begin(), M->function_end());
+  std::vector<FunctionOutput> Outputs(Fs.size());
+  std::vector<unsigned> FirstCandidates(Fs.size());
+  for (unsigned i = 0; i < Fs.size(); ++i) {
+    FirstCandidates[i] = candidateNumber;
+    candidateNumber += BPLFunctionWriter::countCandidates(Fs[i]);
+  }
+
+  // The preconditions of the entry points are shared, so are written before
+  // any of the functions.
+  getGlobalInitRequires();
+
+  auto WriteFunction = [&](unsigned i) {
+    FunctionOutput &Out = Outputs[i];
+    llvm::raw_string_ostream TextOS(Out.Text);
+    SourceLocWriter FunctionSLW;
+    BPLFunctionWriter FW(this, TextOS, Fs[i], &Out.Intrinsics, &FunctionSLW,
+                         FirstCandidates[i]);
+    FW.write();
+    TextOS.flush();
+    Out.SourceLocs = FunctionSLW.getSourceLocs();
+  };
+
+  llvm::ThreadPool Pool(llvm::hardware_concurrency(Threads));
+  for (unsigned i = 0; i < Fs.size(); ++i)
+    Pool.async(WriteFunction, i);
+  Pool.wait();
+
+  for (auto &Out : Outputs) {
+    for (const auto &I : Out.Intrinsics)
+      useIntrinsic(I.first, I.second);
+    std::vector<unsigned> Numbers;
+    for (const auto &SL : Out.SourceLocs)
+      Numbers.push_back(SLW->writeSourceLocs(SL));
+    writeRenumbered(OS, Out.Text, Numbers);
+  }
+}
+
+void BPLModuleWriter::prePass() {
+  llvm::raw_null_ostream Null;
+  PrePass = true;
+  writeFunctions(Null);
+  PrePass = false;
+  // Number the candidates again as the functions are written.
+  candidateNumber = 0;
+}
+
 void BPLModuleWriter::write() {
   std::string S;
   llvm::raw_string_ostream SS(S);
 
-  for (auto i = M->function_begin(), e = M->function_end(); i != e; ++i) {
-    BPLFunctionWriter FW(this, SS, *i);
-    FW.write();
-  }
+  if (ConstantReadOnlyArrays)
+    findReadOnlyArrays();
 
-  for (auto i = M->axiom_begin(), e = M->axiom_end(); i != e; ++i) {
-    SS << "axiom ";
-    writeExpr(SS, i->get());
-    SS << ";\n";
-  }
+  if (Stream)
+    prePass();
+  else
+    writeFunctions(SS);
+
+  // Also written if no entry point requires the initial values, as those of
+  // constant arrays are axioms.
+  getGlobalInitRequires();
 
   OS << "type _SIZE_T_TYPE = bv" << M->getPointerWidth() << ";\n\n";
 
@@ -99,7 +545,9 @@ void BPLModuleWriter::write() {
   unsigned arrayIdCounter = 1;
   for (auto i = M->global_begin(), e = M->global_end(); i != e;
        ++i, ++arrayIdCounter) {
-    OS << "var {:source_name \"" << (*i)->getSourceName() << "\"} ";
+    bool ReadOnly = ReadOnlyArrays.count(*i);
+    OS << (ReadOnly ? "const" : "var") << " {:source_name \""
+       << (*i)->getSourceName() << "\"} ";
     for (auto ai = (*i)->attrib_begin(), ae = (*i)->attrib_end(); ai != ae;
          ++ai) {
       OS << "{:" << *ai << "} ";
@@ -128,7 +576,8 @@ void BPLModuleWriter::write() {
       OS << "," << (*di);
     OS << "\"} true;\n";
 
-    if ((*i)->isGlobalOrGroupShared()) {
+    // Constant arrays cannot race, so are not instrumented.
+    if ((*i)->isGlobalOrGroupShared() && !ReadOnly) {
       std::string attributes;
       attributes += " {:race_checking} ";
       if ((*i)->isGlobal())
@@ -177,9 +626,9 @@ void BPLModuleWriter::write() {
 
     if (UsesPointers) {
       OS << "const $arrayId$$" << (*i)->getName() << " : arrayId;\n";
-      OS << "axiom $arrayId$$" << (*i)->getName() << " == "
-         << IntRep->getLiteral(arrayIdCounter, bitsRequiredForArrayBases())
-         << ";\n";
+      OS << "axiom $arrayId$$" << (*i)->getName() << " == ";
+      IntRep->writeLiteral(OS, arrayIdCounter, bitsRequiredForArrayBases());
+      OS << ";\n";
     }
 
     OS << "\n";
@@ -187,45 +636,47 @@ void BPLModuleWriter::write() {
 
   if (UsesPointers) {
     unsigned BitsRequiredForArrayBases = bitsRequiredForArrayBases();
+    unsigned OffsetBits = M->getPointerWidth() - BitsRequiredForArrayBases;
+    auto Base = [](llvm::raw_ostream &OS) { OS << "base"; };
+    auto P = [](llvm::raw_ostream &OS) { OS << "p"; };
     OS << "type ptr = " << IntRep->getType(M->getPointerWidth()) << ";\n"
        << "type arrayId = " << IntRep->getType(BitsRequiredForArrayBases)
        << ";\n\n"
        << "function {:inline true} MKPTR(base: arrayId, offset: "
        << MW->IntRep->getType(M->getPointerWidth()) << ") : ptr {\n"
-       << "  "
-       << IntRep->getConcatExpr(
-              "base",
-              IntRep->getExtractExpr(
-                  "offset", (M->getPointerWidth() - BitsRequiredForArrayBases),
-                  0))
-       << "\n}\n\n"
+       << "  ";
+    IntRep->writeConcatExpr(OS, Base, [&](llvm::raw_ostream &OS) {
+      IntRep->writeExtractExpr(
+          OS, [](llvm::raw_ostream &OS) { OS << "offset"; }, OffsetBits, 0);
+    });
+    OS << "\n}\n\n"
        << "function {:inline true} base#MKPTR(p: ptr) : arrayId {\n"
-       << "  "
-       << IntRep->getExtractExpr("p", M->getPointerWidth(),
-                                 M->getPointerWidth() -
-                                     BitsRequiredForArrayBases)
-       << "\n}\n\n"
+       << "  ";
+    IntRep->writeExtractExpr(OS, P, M->getPointerWidth(), OffsetBits);
+    OS << "\n}\n\n"
        << "function {:inline true} offset#MKPTR(p : ptr) : "
        << IntRep->getType(M->getPointerWidth()) << " {\n"
-       << "  "
-       << IntRep->getConcatExpr(
-              IntRep->getLiteral(0, BitsRequiredForArrayBases),
-              IntRep->getExtractExpr(
-                  "p", (M->getPointerWidth() - BitsRequiredForArrayBases), 0))
-       << "\n}\n\n"
+       << "  ";
+    IntRep->writeConcatExpr(
+        OS,
+        [&](llvm::raw_ostream &OS) {
+          IntRep->writeLiteral(OS, 0, BitsRequiredForArrayBases);
+        },
+        [&](llvm::raw_ostream &OS) {
+          IntRep->writeExtractExpr(OS, P, OffsetBits, 0);
+        });
+    OS << "\n}\n\n"
        << "const $arrayId$$null$ : arrayId;\n"
-       << "axiom $arrayId$$null$ == "
-       << IntRep->getLiteral(0, BitsRequiredForArrayBases) << ";\n\n";
+       << "axiom $arrayId$$null$ == ";
+    IntRep->writeLiteral(OS, 0, BitsRequiredForArrayBases);
+    OS << ";\n\n";
 
     if (IntRep->abstractsConcat()) {
-      writeIntrinsic(
-          [&](llvm::raw_ostream &OS) { OS << MW->IntRep->getConcat(); }, false);
+      useIntrinsic(BPLIntrinsic(BPLIntrinsic::Concat));
     }
 
     if (IntRep->abstractsExtract()) {
-      writeIntrinsic(
-          [&](llvm::raw_ostream &OS) { OS << MW->IntRep->getExtract(); },
-          false);
+      useIntrinsic(BPLIntrinsic(BPLIntrinsic::Extract));
     }
   }
 
@@ -241,22 +692,37 @@ void BPLModuleWriter::write() {
     for (auto i = M->function_begin(), e = M->function_end(); i != e;
          ++i, ++functionIdCounter) {
       OS << "const $functionId$$" << (*i)->getName() << " : functionPtr;\n";
-      OS << "axiom $functionId$$" << (*i)->getName() << " == "
-         << IntRep->getLiteral(functionIdCounter,
-                               bitsRequiredForFunctionPointers())
-         << ";\n";
+      OS << "axiom $functionId$$" << (*i)->getName() << " == ";
+      IntRep->writeLiteral(OS, functionIdCounter,
+                           bitsRequiredForFunctionPointers());
+      OS << ";\n";
     }
 
     OS << "const $functionId$$null$ : functionPtr;\n";
-    OS << "axiom $functionId$$null$ == "
-       << IntRep->getLiteral(0, bitsRequiredForFunctionPointers()) << ";\n\n";
+    OS << "axiom $functionId$$null$ == ";
+    IntRep->writeLiteral(OS, 0, bitsRequiredForFunctionPointers());
+    OS << ";\n\n";
   }
 
-  for (const auto &I : IntrinsicSet) {
-    OS << I << "\n";
+  OS << GlobalInitDecls;
+
+  // The declarations are written in order, so that the output does not depend
+  // on the order in which the intrinsics were first used.
+  std::set<std::string> IntrinsicDecls;
+  for (const auto &I : Intrinsics) {
+    std::string S;
+    llvm::raw_string_ostream SS(S);
+    writeIntrinsic(SS, I.first, I.second);
+    IntrinsicDecls.insert(SS.str());
+  }
+  for (const auto &D : IntrinsicDecls) {
+    OS << D << "\n";
   }
 
-  OS << SS.str();
+  if (Stream)
+    writeFunctions(OS);
+  else
+    OS << SS.str();
 }
 
 unsigned BPLModuleWriter::nextCandidateNumber() {
@@ -4,44 +4,36 @@
 
 namespace bugle {
 
-std::string BVIntegerRepresentation::getType(unsigned bitWidth) {
-  return getLiteralSuffix(bitWidth);
+std::string BVIntegerRepresentation::makeType(unsigned bitWidth) {
+  return makeLiteralSuffix(bitWidth);
 }
 
-std::string BVIntegerRepresentation::getLiteralSuffix(unsigned bitWidth) {
+std::string BVIntegerRepresentation::makeLiteralSuffix(unsigned bitWidth) {
   std::string S; llvm::raw_string_ostream SS(S);
   SS << "bv" << bitWidth;
   return SS.str();
 }
 
-std::string BVIntegerRepresentation::getLiteral(unsigned literal,
-                                                unsigned bitWidth) {
-  std::string S; llvm::raw_string_ostream SS(S);
-  SS << literal << getLiteralSuffix(bitWidth);
-  return SS.str();
-}
-
-std::string BVIntegerRepresentation::getZeroExtend(unsigned FromWidth,
-                                                   unsigned ToWidth) {
-  std::string S; llvm::raw_string_ostream SS(S);
-  SS << "function {:bvbuiltin \"zero_extend " << (ToWidth - FromWidth)
+void BVIntegerRepresentation::writeZeroExtend(llvm::raw_ostream &OS,
+                                              unsigned FromWidth,
+                                              unsigned ToWidth) {
+  OS << "function {:bvbuiltin \"zero_extend " << (ToWidth - FromWidth)
      << "\"} BV" << FromWidth << "_ZEXT" << ToWidth << "(bv" << FromWidth
      << ") : bv" << ToWidth << ";";
-  return SS.str();
 }
 
-std::string BVIntegerRepresentation::getSignExtend(unsigned FromWidth,
-                                                   unsigned ToWidth) {
-  std::string S; llvm::raw_string_ostream SS(S);
-  SS << "function {:bvbuiltin \"sign_extend " << (ToWidth - FromWidth)
+void BVIntegerRepresentation::writeSignExtend(llvm::raw_ostream &OS,
+                                              unsigned FromWidth,
+                                              unsigned ToWidth) {
+  OS << "function {:bvbuiltin \"sign_extend " << (ToWidth - FromWidth)
      << "\"} BV" << FromWidth << "_SEXT" << ToWidth << "(bv" << FromWidth
      << ") : bv" << ToWidth << ";";
-  return SS.str();
 }
 
-std::string BVIntegerRepresentation::getArithmeticBinary(std::string Name,
-                                                         bugle::Expr::Kind Kind,
-                                                         unsigned Width) {
+void BVIntegerRepresentation::writeArithmeticBinary(llvm::raw_ostream &OS,
+                                                    llvm::StringRef Name,
+                                                    bugle::Expr::Kind Kind,
+                                                    unsigned Width) {
   const char *SMTName;
   switch (Kind) {
   case Expr::BVAdd:  SMTName = "bvadd";  break;
@@ -61,15 +53,14 @@ std::string BVIntegerRepresentation::getArithmeticBinary(std::string Name,
     llvm_unreachable("huh?");
   }
 
-  std::string S; llvm::raw_string_ostream SS(S);
-  SS << "function {:bvbuiltin \"" << SMTName << "\"} BV" << Width << "_" << Name
+  OS << "function {:bvbuiltin \"" << SMTName << "\"} BV" << Width << "_" << Name
      << "(bv" << Width << ", bv" << Width << ") : bv" << Width << ";";
-  return SS.str();
 }
 
-std::string BVIntegerRepresentation::getBooleanBinary(std::string Name,
-                                                      bugle::Expr::Kind Kind,
-                                                      unsigned Width) {
+void BVIntegerRepresentation::writeBooleanBinary(llvm::raw_ostream &OS,
+                                                 llvm::StringRef Name,
+                                                 bugle::Expr::Kind Kind,
+                                                 unsigned Width) {
   const char *SMTName;
   switch (Kind) {
   case Expr::BVUgt: SMTName = "bvugt"; break;
@@ -84,10 +75,8 @@ std::string BVIntegerRepresentation::getBooleanBinary(std::string Name,
     llvm_unreachable("huh?");
   }
 
-  std::string S; llvm::raw_string_ostream SS(S);
-  SS << "function {:bvbuiltin \"" << SMTName << "\"} BV" << Width << "_" << Name
+  OS << "function {:bvbuiltin \"" << SMTName << "\"} BV" << Width << "_" << Name
      << "(bv" << Width << ", bv" << Width << ") : bool;";
-  return SS.str();
 }
 
 void BVIntegerRepresentation::printVal(llvm::raw_ostream &OS,
@@ -96,50 +85,50 @@ void BVIntegerRepresentation::printVal(llvm::raw_ostream &OS,
   OS << getLiteralSuffix(Val.getBitWidth());
 }
 
-std::string BVIntegerRepresentation::getExtractExpr(const std::string &Expr,
-                                                    unsigned UpperBit,
-                                                    unsigned LowerBit) {
-  std::string S; llvm::raw_string_ostream SS(S);
-  SS << Expr << "[" << UpperBit << ":" << LowerBit << "]";
-  return SS.str();
+void BVIntegerRepresentation::writeExtractExpr(llvm::raw_ostream &OS,
+                                               OperandWriter Expr,
+                                               unsigned UpperBit,
+                                               unsigned LowerBit) {
+  Expr(OS);
+  OS << "[" << UpperBit << ":" << LowerBit << "]";
 }
 
 bool BVIntegerRepresentation::abstractsExtract() { return false; }
 
-std::string BVIntegerRepresentation::getExtract() {
+void BVIntegerRepresentation::writeExtract(llvm::raw_ostream &OS) {
   llvm_unreachable(
       "BVIntegerRepresentation should generate Boogie extract syntax");
 }
 
 bool BVIntegerRepresentation::abstractsConcat() { return false; }
 
-std::string BVIntegerRepresentation::getConcat() {
+void BVIntegerRepresentation::writeConcat(llvm::raw_ostream &OS) {
   llvm_unreachable(
       "BVIntegerRepresentation should generate Boogie concatenation syntax");
 }
 
-std::string BVIntegerRepresentation::getConcatExpr(const std::string &Lhs,
-                                                   const std::string &Rhs) {
-  std::string S; llvm::raw_string_ostream SS(S);
-  SS << Lhs << " ++ " << Rhs;
-  return SS.str();
+void BVIntegerRepresentation::writeConcatExpr(llvm::raw_ostream &OS,
+                                              OperandWriter Lhs,
+                                              OperandWriter Rhs) {
+  Lhs(OS);
+  OS << " ++ ";
+  Rhs(OS);
 }
 
-std::string BVIntegerRepresentation::getCtlz(unsigned Width) {
-  std::string S; llvm::raw_string_ostream SS(S);
-  SS << "procedure BV" << Width << "_CTLZ"
+void BVIntegerRepresentation::writeCtlz(llvm::raw_ostream &OS,
+                                        unsigned Width) {
+  OS << "procedure BV" << Width << "_CTLZ"
      << "(val : bv" << Width << ", isZeroUndef : bool) "
      << "returns (count : bv" << Width << ");\n";
-  SS << "  ensures (val == 0bv" << Width << " && !isZeroUndef) "
+  OS << "  ensures (val == 0bv" << Width << " && !isZeroUndef) "
      << " ==> count == " << Width << "bv" << Width << ";\n";
   for (unsigned i = 1; i < Width; ++i) {
-    SS << "  ensures ("
+    OS << "  ensures ("
        << "BV" << Width << "_LSHR(val, " << i << "bv" << Width << ") "
        << "== 0bv" << Width << " && "
        << "BV" << Width << "_LSHR(val, " << (i - 1) << "bv" << Width << ") "
        << "!= 0bv" << Width << ")"
        << " ==> count == " << (Width - i) << "bv" << Width << ";\n";
   }
-  return SS.str();
 }
 }
@@ -1,36 +1,168 @@
 #include "bugle/Expr.h"
+#include "bugle/AffineForm.h"
 #include "bugle/BPLExprWriter.h"
 #include "bugle/Function.h"
 #include "bugle/GlobalArray.h"
-#include "bugle/util/Functional.h"
+#include "bugle/StringTable.h"
+#include "llvm/Support/ErrorHandling.h"
 #include "llvm/Support/raw_ostream.h"
+#include <algorithm>
 
 using namespace bugle;
 
+uint64_t Expr::createdCount = 0;
+
+ExprUniqueTable *ExprUniqueTable::current = nullptr;
+
+static void addField(ExprUniqueTable::Key &K, uint64_t I) {
+  K.push_back(I);
+}
+
+static void addField(ExprUniqueTable::Key &K, const void *P) {
+  K.push_back(reinterpret_cast<uintptr_t>(P));
+}
+
+static void addField(ExprUniqueTable::Key &K, const ref<Expr> &E) {
+  addField(K, E.get());
+}
+
+static void addField(ExprUniqueTable::Key &K, const Type &T) {
+  K.push_back(T.array);
+  K.push_back(T.kind);
+  K.push_back(T.width);
+}
+
+static void addField(ExprUniqueTable::Key &K, const llvm::APInt &I) {
+  K.push_back(I.getBitWidth());
+  K.append(I.getRawData(), I.getRawData() + I.getNumWords());
+}
+
+template <typename T>
+static void addField(ExprUniqueTable::Key &K, llvm::ArrayRef<T> Xs) {
+  K.push_back(Xs.size());
+  for (const auto &X : Xs)
+    addField(K, X);
+}
+
+template <typename T>
+static void addField(ExprUniqueTable::Key &K, const std::vector<T> &Xs) {
+  addField(K, llvm::ArrayRef<T>(Xs));
+}
+
+static void addFields(ExprUniqueTable::Key &K) {}
+
+template <typename Arg, typename... Args>
+static void addFields(ExprUniqueTable::Key &K, const Arg &First,
+                      const Args &... Rest) {
+  addField(K, First);
+  addFields(K, Rest...);
+}
+
+// The number of bytes needed after a node for the operands which its class
+// stores inline, that is, for its array constructor argument.
+template <typename T> static size_t getTrailingSize(const T &) { return 0; }
+
+template <typename T> static size_t getTrailingSize(llvm::ArrayRef<T> Xs) {
+  return Xs.size() * sizeof(T);
+}
+
+template <typename T>
+static size_t getTrailingSize(const std::vector<T> &Xs) {
+  return Xs.size() * sizeof(T);
+}
+
+static size_t getTrailingSizes() { return 0; }
+
+template <typename Arg, typename... Args>
+static size_t getTrailingSizes(const Arg &First, const Args &... Rest) {
+  return getTrailingSize(First) + getTrailingSizes(Rest...);
+}
+
+template <typename T, typename... Args>
+T *ExprUniqueTable::construct(const Args &... args) {
+  return new (getTrailingSizes(args...)) T(args...);
+}
+
+template <typename T, typename... Args>
+ref<Expr> ExprUniqueTable::create(const Args &... args) {
+  if (!current)
+    return construct<T>(args...);
+
+  Key K;
+  K.push_back(T::staticKind);
+  addFields(K, args...);
+  auto i = current->exprs.find(StoredKey(K));
+  if (i != current->exprs.end())
+    return i->second;
+
+  ref<Expr> E = construct<T>(args...);
+  uint64_t *Fields = current->keyStorage.Allocate<uint64_t>(K.size());
+  std::copy(K.begin(), K.end(), Fields);
+  current->exprs.insert(std::make_pair(StoredKey(Fields, K.size()), E.get()));
+  current->nodes.push_back(E);
+  return E;
+}
+
+// Expressions without side effects are created through the current unique
+// table.  Havocs, loads, atomics, calls and the accesses to instrumentation
+// state are always created afresh.
+template <typename T, typename... Args>
+static ref<Expr> unique(const Args &... args) {
+  return ExprUniqueTable::create<T>(args...);
+}
+
+template <typename T, typename... Args>
+static ref<Expr> construct(const Args &... args) {
+  return ExprUniqueTable::construct<T>(args...);
+}
+
 bool Expr::computeArrayCandidates(std::set<GlobalArray *> &GlobalSet) const {
-  if (auto *GARE = dyn_cast<GlobalArrayRefExpr>(this)) {
+  GlobalArraySet Candidates;
+  if (!computeArrayCandidates(Candidates))
+    return false;
+  Candidates.getArrays(GlobalSet);
+  return true;
+}
+
+// Conditionals selecting between pointers are often nested and share their
+// operands, so each conditional is only visited once per query.
+static bool computeArrayCandidates(const Expr *E, GlobalArraySet &GlobalSet,
+                                   std::set<const Expr *> &Visited) {
+  if (auto *GARE = dyn_cast<GlobalArrayRefExpr>(E)) {
     GlobalSet.insert(GARE->getArray());
     return true;
-  } else if (auto *MOE = dyn_cast<ArrayMemberOfExpr>(this)) {
-    GlobalSet.insert(MOE->getElems().begin(), MOE->getElems().end());
+  } else if (auto *MOE = dyn_cast<ArrayMemberOfExpr>(E)) {
+    for (auto *GA : MOE->getElems())
+      GlobalSet.insert(GA);
     return true;
-  } else if (isa<NullArrayRefExpr>(this)) {
+  } else if (isa<NullArrayRefExpr>(E)) {
     GlobalSet.insert(nullptr);
     return true;
-  } else if (auto *ITE = dyn_cast<IfThenElseExpr>(this)) {
-    return ITE->getTrueExpr()->computeArrayCandidates(GlobalSet) &&
-           ITE->getFalseExpr()->computeArrayCandidates(GlobalSet);
-  } else if (auto *AIE = dyn_cast<ArrayIdExpr>(this)) {
-    return AIE->getSubExpr()->computeArrayCandidates(GlobalSet);
-  } else if (auto *PE = dyn_cast<PointerExpr>(this)) {
-    return PE->getArray()->computeArrayCandidates(GlobalSet);
+  } else if (auto *ITE = dyn_cast<IfThenElseExpr>(E)) {
+    // A conditional seen before has added its candidates already, as the
+    // query would have failed otherwise.
+    if (!Visited.insert(ITE).second)
+      return true;
+    return computeArrayCandidates(ITE->getTrueExpr().get(), GlobalSet,
+                                  Visited) &&
+           computeArrayCandidates(ITE->getFalseExpr().get(), GlobalSet,
+                                  Visited);
+  } else if (auto *AIE = dyn_cast<ArrayIdExpr>(E)) {
+    return computeArrayCandidates(AIE->getSubExpr().get(), GlobalSet, Visited);
+  } else if (auto *PE = dyn_cast<PointerExpr>(E)) {
+    return computeArrayCandidates(PE->getArray().get(), GlobalSet, Visited);
   } else {
     return false;
   }
 }
 
+bool Expr::computeArrayCandidates(GlobalArraySet &GlobalSet) const {
+  std::set<const Expr *> Visited;
+  return ::computeArrayCandidates(this, GlobalSet, Visited);
+}
+
 ref<Expr> BVConstExpr::create(const llvm::APInt &bv) {
-  return new BVConstExpr(bv);
+  return unique<BVConstExpr>(bv);
 }
 
 ref<Expr> BVConstExpr::createZero(unsigned width) {
@@ -41,14 +173,14 @@ ref<Expr> BVConstExpr::create(unsigned width, uint64_t val, bool isSigned) {
   return create(llvm::APInt(width, val, isSigned));
 }
 
-ref<Expr> BoolConstExpr::create(bool val) { return new BoolConstExpr(val); }
+ref<Expr> BoolConstExpr::create(bool val) { return unique<BoolConstExpr>(val); }
 
 ref<Expr> GlobalArrayRefExpr::create(GlobalArray *global) {
-  return new GlobalArrayRefExpr(Type(Type::ArrayOf, global->getRangeType()),
-                                global);
+  return unique<GlobalArrayRefExpr>(
+      Type(Type::ArrayOf, global->getRangeType()), global);
 }
 
-ref<Expr> NullArrayRefExpr::create() { return new NullArrayRefExpr(); }
+ref<Expr> NullArrayRefExpr::create() { return unique<NullArrayRefExpr>(); }
 
 ref<Expr> ConstantArrayRefExpr::create(llvm::ArrayRef<ref<Expr>> array) {
   assert(array.size() > 0);
@@ -59,22 +191,23 @@ ref<Expr> ConstantArrayRefExpr::create(llvm::ArrayRef<ref<Expr>> array) {
   for (auto &A : array)
     A->preventEvalStmt = true;
 
-  return new ConstantArrayRefExpr(array);
+  return unique<ConstantArrayRefExpr>(array);
 }
 
 ref<Expr> PointerExpr::create(ref<Expr> array, ref<Expr> offset) {
   assert(array->getType().array);
   assert(offset->getType().isKind(Type::BV));
 
-  return new PointerExpr(array, offset);
+  return unique<PointerExpr>(array, offset);
 }
 
 ref<Expr> NullFunctionPointerExpr::create(unsigned ptrWidth) {
-  return new NullFunctionPointerExpr(ptrWidth);
+  return unique<NullFunctionPointerExpr>(ptrWidth);
 }
 
-ref<Expr> FunctionPointerExpr::create(std::string funcName, unsigned ptrWidth) {
-  return new FunctionPointerExpr(funcName, ptrWidth);
+ref<Expr> FunctionPointerExpr::create(const std::string &funcName,
+                                      unsigned ptrWidth) {
+  return unique<FunctionPointerExpr>(StringTable::intern(funcName), ptrWidth);
 }
 
 ref<Expr> LoadExpr::create(ref<Expr> array, ref<Expr> offset, Type type,
@@ -101,13 +234,14 @@ ref<Expr> AtomicExpr::create(ref<Expr> array, ref<Expr> offset,
   assert(offset->getType().isKind(Type::BV));
   assert(at.range().isKind(Type::BV));
 
-  return new AtomicExpr(at.range(), array, offset, args, function, parts, part);
+  return construct<AtomicExpr>(at.range(), array, offset, args,
+                               StringTable::intern(function), parts, part);
 }
 
-ref<Expr> VarRefExpr::create(Var *var) { return new VarRefExpr(var); }
+ref<Expr> VarRefExpr::create(Var *var) { return unique<VarRefExpr>(var); }
 
 ref<Expr> SpecialVarRefExpr::create(Type t, const std::string &attr) {
-  return new SpecialVarRefExpr(t, attr);
+  return unique<SpecialVarRefExpr>(t, StringTable::intern(attr));
 }
 
 ref<Expr> BVExtractExpr::create(ref<Expr> expr, unsigned offset,
@@ -129,10 +263,28 @@ ref<Expr> BVExtractExpr::create(ref<Expr> expr, unsigned offset,
       return BVExtractExpr::create(e->getRHS(), offset, width);
     if (offset >= RHSWidth)
       return BVExtractExpr::create(e->getLHS(), offset - RHSWidth, width);
-    if (offset == 0 && RHSWidth < width) {
-      auto EE = BVExtractExpr::create(e->getLHS(), offset, width - RHSWidth);
-      return BVConcatExpr::create(EE, e->getRHS());
-    }
+    // An extract straddling both operands splits between them, which for a
+    // balanced concatenation touches at most two paths through the tree.
+    auto LHSE = BVExtractExpr::create(e->getLHS(), 0,
+                                      offset + width - RHSWidth);
+    auto RHSE = BVExtractExpr::create(e->getRHS(), offset, RHSWidth - offset);
+    return BVConcatExpr::create(LHSE, RHSE);
+  }
+
+  if (auto *e = dyn_cast<VectorBinaryExpr>(expr)) {
+    unsigned LaneWidth = e->getLaneWidth();
+    if (width == LaneWidth && offset % LaneWidth == 0)
+      return VectorBinaryExpr::createLane(
+          e->getOp(), BVExtractExpr::create(e->getLHS(), offset, width),
+          BVExtractExpr::create(e->getRHS(), offset, width));
+  }
+
+  if (auto *e = dyn_cast<VectorShuffleExpr>(expr)) {
+    unsigned LaneWidth = e->getLaneWidth();
+    if (width % LaneWidth == 0 && offset % LaneWidth == 0)
+      return VectorShuffleExpr::create(
+          e->getVec1(), e->getVec2(), LaneWidth,
+          e->getMask().slice(offset / LaneWidth, width / LaneWidth));
   }
 
   if (isa<BVZExtExpr>(expr) || isa<BVSExtExpr>(expr)) {
@@ -141,14 +293,14 @@ ref<Expr> BVExtractExpr::create(ref<Expr> expr, unsigned offset,
       return BVExtractExpr::create(UE->getSubExpr(), offset, width);
   }
 
-  return new BVExtractExpr(expr, offset, width);
+  return unique<BVExtractExpr>(expr, offset, width);
 }
 
 ref<Expr> BVCtlzExpr::create(ref<Expr> val, ref<Expr> isZeroUndef) {
   assert(val->getType().isKind(Type::BV));
   assert(isZeroUndef->getType().isKind(Type::Bool));
 
-  return new BVCtlzExpr(val->getType(), val, isZeroUndef);
+  return unique<BVCtlzExpr>(val->getType(), val, isZeroUndef);
 }
 
 ref<Expr> NotExpr::create(ref<Expr> op) {
@@ -156,7 +308,7 @@ ref<Expr> NotExpr::create(ref<Expr> op) {
   if (auto e = dyn_cast<BoolConstExpr>(op))
     return BoolConstExpr::create(!e->getValue());
 
-  return new NotExpr(Type(Type::Bool), op);
+  return unique<NotExpr>(Type(Type::Bool), op);
 }
 
 Type Expr::getArrayCandidateType(const std::set<GlobalArray *> &Globals) {
@@ -175,9 +327,9 @@ Type Expr::getArrayCandidateType(const std::set<GlobalArray *> &Globals) {
 Type Expr::getPointerRange(ref<Expr> pointer, Type defaultRange) {
   assert(pointer->getType().isKind(Type::Pointer));
   Type range = defaultRange;
-  std::set<GlobalArray *> Globals;
+  GlobalArraySet Globals;
   if (pointer->computeArrayCandidates(Globals))
-    range = getArrayCandidateType(Globals);
+    range = Globals.getRangeType();
   return range;
 }
 
@@ -189,7 +341,7 @@ ref<Expr> ArrayIdExpr::create(ref<Expr> pointer, Type defaultRange) {
 
   Type range = getPointerRange(pointer, defaultRange);
 
-  return new ArrayIdExpr(Type(Type::ArrayOf, range), pointer);
+  return unique<ArrayIdExpr>(Type(Type::ArrayOf, range), pointer);
 }
 
 ref<Expr> ArrayOffsetExpr::create(ref<Expr> pointer) {
@@ -198,7 +350,8 @@ ref<Expr> ArrayOffsetExpr::create(ref<Expr> pointer) {
   if (auto e = dyn_cast<PointerExpr>(pointer))
     return e->getOffset();
 
-  return new ArrayOffsetExpr(Type(Type::BV, pointer->getType().width), pointer);
+  return unique<ArrayOffsetExpr>(Type(Type::BV, pointer->getType().width),
+                                 pointer);
 }
 
 ref<Expr> BVZExtExpr::create(unsigned width, ref<Expr> bv) {
@@ -213,7 +366,7 @@ ref<Expr> BVZExtExpr::create(unsigned width, ref<Expr> bv) {
   if (auto e = dyn_cast<BVConstExpr>(bv))
     return BVConstExpr::create(e->getValue().zext(width));
 
-  return new BVZExtExpr(Type(Type::BV, width), bv);
+  return unique<BVZExtExpr>(Type(Type::BV, width), bv);
 }
 
 ref<Expr> BVSExtExpr::create(unsigned width, ref<Expr> bv) {
@@ -228,7 +381,7 @@ ref<Expr> BVSExtExpr::create(unsigned width, ref<Expr> bv) {
   if (auto e = dyn_cast<BVConstExpr>(bv))
     return BVConstExpr::create(e->getValue().sext(width));
 
-  return new BVSExtExpr(Type(Type::BV, width), bv);
+  return unique<BVSExtExpr>(Type(Type::BV, width), bv);
 }
 
 ref<Expr> FPConvExpr::create(unsigned width, ref<Expr> expr) {
@@ -238,112 +391,112 @@ ref<Expr> FPConvExpr::create(unsigned width, ref<Expr> expr) {
   if (width == ty.width)
     return expr;
 
-  return new FPConvExpr(Type(Type::BV, width), expr);
+  return unique<FPConvExpr>(Type(Type::BV, width), expr);
 }
 
 ref<Expr> FPToSIExpr::create(unsigned width, ref<Expr> expr) {
   assert(expr->getType().isKind(Type::BV));
-  return new FPToSIExpr(Type(Type::BV, width), expr);
+  return unique<FPToSIExpr>(Type(Type::BV, width), expr);
 }
 
 ref<Expr> FPToUIExpr::create(unsigned width, ref<Expr> expr) {
   assert(expr->getType().isKind(Type::BV));
-  return new FPToUIExpr(Type(Type::BV, width), expr);
+  return unique<FPToUIExpr>(Type(Type::BV, width), expr);
 }
 
 ref<Expr> SIToFPExpr::create(unsigned width, ref<Expr> expr) {
   assert(expr->getType().isKind(Type::BV));
-  return new SIToFPExpr(Type(Type::BV, width), expr);
+  return unique<SIToFPExpr>(Type(Type::BV, width), expr);
 }
 
 ref<Expr> UIToFPExpr::create(unsigned width, ref<Expr> expr) {
   assert(expr->getType().isKind(Type::BV));
-  return new UIToFPExpr(Type(Type::BV, width), expr);
+  return unique<UIToFPExpr>(Type(Type::BV, width), expr);
 }
 
 ref<Expr> BVCtpopExpr::create(ref<Expr> expr) {
   assert(expr->getType().isKind(Type::BV));
-  return new BVCtpopExpr(expr->getType(), expr);
+  return unique<BVCtpopExpr>(expr->getType(), expr);
 }
 
 ref<Expr> FAbsExpr::create(ref<Expr> expr) {
   assert(expr->getType().isKind(Type::BV));
-  return new FAbsExpr(expr->getType(), expr);
+  return unique<FAbsExpr>(expr->getType(), expr);
 }
 
 ref<Expr> FCeilExpr::create(ref<Expr> expr) {
   assert(expr->getType().isKind(Type::BV));
-  return new FCeilExpr(expr->getType(), expr);
+  return unique<FCeilExpr>(expr->getType(), expr);
 }
 
 ref<Expr> FCosExpr::create(ref<Expr> expr) {
   assert(expr->getType().isKind(Type::BV));
-  return new FCosExpr(expr->getType(), expr);
+  return unique<FCosExpr>(expr->getType(), expr);
 }
 
 ref<Expr> FExpExpr::create(ref<Expr> expr) {
   assert(expr->getType().isKind(Type::BV));
-  return new FExpExpr(expr->getType(), expr);
+  return unique<FExpExpr>(expr->getType(), expr);
 }
 
 ref<Expr> FExp2Expr::create(ref<Expr> expr) {
   assert(expr->getType().isKind(Type::BV));
-  return new FExp2Expr(expr->getType(), expr);
+  return unique<FExp2Expr>(expr->getType(), expr);
 }
 
 ref<Expr> FLogExpr::create(ref<Expr> expr) {
   assert(expr->getType().isKind(Type::BV));
-  return new FLogExpr(expr->getType(), expr);
+  return unique<FLogExpr>(expr->getType(), expr);
 }
 
 ref<Expr> FLog10Expr::create(ref<Expr> expr) {
   assert(expr->getType().isKind(Type::BV));
-  return new FLog10Expr(expr->getType(), expr);
+  return unique<FLog10Expr>(expr->getType(), expr);
 }
 
 ref<Expr> FLog2Expr::create(ref<Expr> expr) {
   assert(expr->getType().isKind(Type::BV));
-  return new FLog2Expr(expr->getType(), expr);
+  return unique<FLog2Expr>(expr->getType(), expr);
 }
 
 ref<Expr> FrexpExpExpr::create(unsigned width, ref<Expr> expr) {
   assert(expr->getType().isKind(Type::BV));
-  return new FrexpExpExpr(Type(Type::BV, width), expr);
+  return unique<FrexpExpExpr>(Type(Type::BV, width), expr);
 }
 
 ref<Expr> FrexpFracExpr::create(ref<Expr> expr) {
   assert(expr->getType().isKind(Type::BV));
-  return new FrexpFracExpr(expr->getType(), expr);
+  return unique<FrexpFracExpr>(expr->getType(), expr);
 }
 
 ref<Expr> FFloorExpr::create(ref<Expr> expr) {
   assert(expr->getType().isKind(Type::BV));
-  return new FFloorExpr(expr->getType(), expr);
+  return unique<FFloorExpr>(expr->getType(), expr);
 }
 
 ref<Expr> FRintExpr::create(ref<Expr> expr) {
   assert(expr->getType().isKind(Type::BV));
-  return new FRintExpr(expr->getType(), expr);
+  return unique<FRintExpr>(expr->getType(), expr);
 }
 
 ref<Expr> FSinExpr::create(ref<Expr> expr) {
   assert(expr->getType().isKind(Type::BV));
-  return new FSinExpr(expr->getType(), expr);
+  return unique<FSinExpr>(expr->getType(), expr);
 }
 
 ref<Expr> FRsqrtExpr::create(ref<Expr> expr) {
   assert(expr->getType().isKind(Type::BV));
-  return new FRsqrtExpr(expr->getType(), expr);
+  return unique<FRsqrtExpr>(expr->getType(), expr);
 }
 
 ref<Expr> FSqrtExpr::create(ref<Expr> expr) {
   assert(expr->getType().isKind(Type::BV));
-  return new FSqrtExpr(expr->getType(), expr);
+  return unique<FSqrtExpr>(expr->getType(), expr);
 }
 
 ref<Expr> FTruncExpr::create(ref<Expr> expr) {
   assert(expr->getType().isKind(Type::BV));
-  return new FTruncExpr(expr->getType(), expr);
+  return unique<FTruncExpr>(expr->getType(), expr);
 }
 
 ref<Expr> IfThenElseExpr::create(ref<Expr> cond, ref<Expr> trueExpr,
@@ -354,7 +507,7 @@ ref<Expr> IfThenElseExpr::create(ref<Expr> cond, ref<Expr> trueExpr,
   if (auto e = dyn_cast<BoolConstExpr>(cond))
     return e->getValue() ? trueExpr : falseExpr;
 
-  return new IfThenElseExpr(cond, trueExpr, falseExpr);
+  return unique<IfThenElseExpr>(cond, trueExpr, falseExpr);
 }
 
 ref<Expr> HavocExpr::create(Type type) { return new HavocExpr(type); }
@@ -370,7 +523,8 @@ ref<Expr> ArrayMemberOfExpr::create(ref<Expr> expr,
     return GA == nullptr || GA->getRangeType() == Ty;
   }));
 
-  return new ArrayMemberOfExpr(Type(Type::ArrayOf, Ty), expr, elems);
+  std::vector<GlobalArray *> elemVec(elems.begin(), elems.end());
+  return unique<ArrayMemberOfExpr>(Type(Type::ArrayOf, Ty), expr, elemVec);
 }
 
 ref<Expr> BVToPtrExpr::create(unsigned ptrWidth, ref<Expr> bv) {
@@ -384,7 +538,7 @@ ref<Expr> BVToPtrExpr::create(unsigned ptrWidth, ref<Expr> bv) {
       return PointerExpr::create(NullArrayRefExpr::create(),
                                  BVConstExpr::createZero(ptrWidth));
 
-  return new BVToPtrExpr(Type(Type::Pointer, ptrWidth), bv);
+  return unique<BVToPtrExpr>(Type(Type::Pointer, ptrWidth), bv);
 }
 
 ref<Expr> PtrToBVExpr::create(unsigned bvWidth, ref<Expr> ptr) {
@@ -397,7 +551,7 @@ ref<Expr> PtrToBVExpr::create(unsigned bvWidth, ref<Expr> ptr) {
     if (dyn_cast<NullArrayRefExpr>(e->getArray()))
       return BVZExtExpr::create(bvWidth, e->getOffset());
 
-  return new PtrToBVExpr(Type(Type::BV, bvWidth), ptr);
+  return unique<PtrToBVExpr>(Type(Type::BV, bvWidth), ptr);
 }
 
 ref<Expr> SafeBVToPtrExpr::create(unsigned ptrWidth, ref<Expr> bv) {
@@ -411,8 +565,8 @@ ref<Expr> SafeBVToPtrExpr::create(unsigned ptrWidth, ref<Expr> bv) {
       return PointerExpr::create(NullArrayRefExpr::create(),
                                  BVConstExpr::createZero(ptrWidth));
 
-  return new SafeBVToPtrExpr(Type(Type::Pointer, ptrWidth),
-                             BVZExtExpr::create(ptrWidth, bv));
+  return unique<SafeBVToPtrExpr>(Type(Type::Pointer, ptrWidth),
+                                 BVZExtExpr::create(ptrWidth, bv));
 }
 
 ref<Expr> SafePtrToBVExpr::create(unsigned bvWidth, ref<Expr> ptr) {
@@ -426,8 +580,8 @@ ref<Expr> SafePtrToBVExpr::create(unsigned bvWidth, ref<Expr> ptr) {
     if (dyn_cast<NullArrayRefExpr>(e->getArray()))
       return BVZExtExpr::create(bvWidth, e->getOffset());
 
-  return BVZExtExpr::create(bvWidth,
-                            new SafePtrToBVExpr(Type(Type::BV, ty.width), ptr));
+  return BVZExtExpr::create(
+      bvWidth, unique<SafePtrToBVExpr>(Type(Type::BV, ty.width), ptr));
 }
 
 ref<Expr> BVToFuncPtrExpr::create(unsigned ptrWidth, ref<Expr> bv) {
@@ -436,7 +590,7 @@ ref<Expr> BVToFuncPtrExpr::create(unsigned ptrWidth, ref<Expr> bv) {
   if (auto *e = dyn_cast<FuncPtrToBVExpr>(bv))
     return e->getSubExpr();
 
-  return new BVToFuncPtrExpr(Type(Type::FunctionPointer, ptrWidth), bv);
+  return unique<BVToFuncPtrExpr>(Type(Type::FunctionPointer, ptrWidth), bv);
 }
 
 ref<Expr> FuncPtrToBVExpr::create(unsigned bvWidth, ref<Expr> ptr) {
@@ -445,7 +599,7 @@ ref<Expr> FuncPtrToBVExpr::create(unsigned bvWidth, ref<Expr> ptr) {
   if (auto *e = dyn_cast<BVToFuncPtrExpr>(ptr))
     return BVZExtExpr::create(bvWidth, e->getSubExpr());
 
-  return new FuncPtrToBVExpr(Type(Type::BV, bvWidth), ptr);
+  return unique<FuncPtrToBVExpr>(Type(Type::BV, bvWidth), ptr);
 }
 
 ref<Expr> PtrToFuncPtrExpr::create(ref<Expr> ptr) {
@@ -458,7 +612,7 @@ ref<Expr> PtrToFuncPtrExpr::create(ref<Expr> ptr) {
   if (auto *e = dyn_cast<FuncPtrToPtrExpr>(ptr))
     return e->getSubExpr();
 
-  return new PtrToFuncPtrExpr(Type(Type::FunctionPointer, ty.width), ptr);
+  return unique<PtrToFuncPtrExpr>(Type(Type::FunctionPointer, ty.width), ptr);
 }
 
 ref<Expr> FuncPtrToPtrExpr::create(ref<Expr> ptr) {
@@ -471,7 +625,7 @@ ref<Expr> FuncPtrToPtrExpr::create(ref<Expr> ptr) {
   if (auto *e = dyn_cast<PtrToFuncPtrExpr>(ptr))
     return e->getSubExpr();
 
-  return new FuncPtrToPtrExpr(Type(Type::Pointer, ty.width), ptr);
+  return unique<FuncPtrToPtrExpr>(Type(Type::Pointer, ty.width), ptr);
 }
 
 ref<Expr> BVToBoolExpr::create(ref<Expr> bv) {
@@ -481,7 +635,7 @@ ref<Expr> BVToBoolExpr::create(ref<Expr> bv) {
   if (auto *e = dyn_cast<BoolToBVExpr>(bv))
     return e->getSubExpr();
 
-  return new BVToBoolExpr(Type(Type::Bool), bv);
+  return unique<BVToBoolExpr>(Type(Type::Bool), bv);
 }
 
 ref<Expr> BoolToBVExpr::create(ref<Expr> bv) {
@@ -490,7 +644,7 @@ ref<Expr> BoolToBVExpr::create(ref<Expr> bv) {
   if (auto *e = dyn_cast<BVToBoolExpr>(bv))
     return e->getSubExpr();
 
-  return new BoolToBVExpr(Type(Type::BV, 1), bv);
+  return unique<BoolToBVExpr>(Type(Type::BV, 1), bv);
 }
 
 ref<Expr> EqExpr::create(ref<Expr> lhs, ref<Expr> rhs) {
@@ -512,7 +666,7 @@ ref<Expr> EqExpr::create(ref<Expr> lhs, ref<Expr> rhs) {
     if (auto *e2 = dyn_cast<GlobalArrayRefExpr>(rhs))
       return BoolConstExpr::create(e1->getArray() == e2->getArray());
 
-  return new EqExpr(Type(Type::Bool), lhs, rhs);
+  return unique<EqExpr>(Type(Type::Bool), lhs, rhs);
 }
 
 ref<Expr> NeExpr::create(ref<Expr> lhs, ref<Expr> rhs) {
@@ -530,7 +684,7 @@ ref<Expr> NeExpr::create(ref<Expr> lhs, ref<Expr> rhs) {
     if (auto *e2 = dyn_cast<GlobalArrayRefExpr>(rhs))
       return BoolConstExpr::create(e1->getArray() != e2->getArray());
 
-  return new NeExpr(Type(Type::Bool), lhs, rhs);
+  return unique<NeExpr>(Type(Type::Bool), lhs, rhs);
 }
 
 ref<Expr> Expr::createNeZero(ref<Expr> bv) {
@@ -547,7 +701,7 @@ ref<Expr> AndExpr::create(ref<Expr> lhs, ref<Expr> rhs) {
   if (auto *e2 = dyn_cast<BoolConstExpr>(rhs))
     return e2->getValue() ? lhs : rhs;
 
-  return new AndExpr(Type(Type::Bool), lhs, rhs);
+  return unique<AndExpr>(Type(Type::Bool), lhs, rhs);
 }
 
 ref<Expr> OrExpr::create(ref<Expr> lhs, ref<Expr> rhs) {
@@ -560,7 +714,7 @@ ref<Expr> OrExpr::create(ref<Expr> lhs, ref<Expr> rhs) {
   if (auto *e2 = dyn_cast<BoolConstExpr>(rhs))
     return e2->getValue() ? rhs : lhs;
 
-  return new OrExpr(Type(Type::Bool), lhs, rhs);
+  return unique<OrExpr>(Type(Type::Bool), lhs, rhs);
 }
 
 static ref<Expr> reassociateConstAdd(BVAddExpr *nonConstOp,
@@ -601,7 +755,7 @@ ref<Expr> BVAddExpr::create(ref<Expr> lhs, ref<Expr> rhs) {
     }
   }
 
-  return new BVAddExpr(Type(Type::BV, lhsTy.width), lhs, rhs);
+  return unique<BVAddExpr>(Type(Type::BV, lhsTy.width), lhs, rhs);
 }
 
 ref<Expr> BVSubExpr::create(ref<Expr> lhs, ref<Expr> rhs) {
@@ -617,7 +771,7 @@ ref<Expr> BVSubExpr::create(ref<Expr> lhs, ref<Expr> rhs) {
     if (e2->getValue().isMinValue())
       return lhs;
 
-  return new BVSubExpr(Type(Type::BV, lhsTy.width), lhs, rhs);
+  return unique<BVSubExpr>(Type(Type::BV, lhsTy.width), lhs, rhs);
 }
 
 ref<Expr> BVMulExpr::create(ref<Expr> lhs, ref<Expr> rhs) {
@@ -636,7 +790,7 @@ ref<Expr> BVMulExpr::create(ref<Expr> lhs, ref<Expr> rhs) {
     if (e2->getValue().getLimitedValue() == 1)
       return lhs;
 
-  return new BVMulExpr(Type(Type::BV, lhsTy.width), lhs, rhs);
+  return unique<BVMulExpr>(Type(Type::BV, lhsTy.width), lhs, rhs);
 }
 
 ref<Expr> BVSDivExpr::create(ref<Expr> lhs, ref<Expr> rhs) {
@@ -649,7 +803,7 @@ ref<Expr> BVSDivExpr::create(ref<Expr> lhs, ref<Expr> rhs) {
       if (e2->getValue().getSExtValue() != 0)
         return BVConstExpr::create(e1->getValue().sdiv(e2->getValue()));
 
-  return new BVSDivExpr(Type(Type::BV, lhsTy.width), lhs, rhs);
+  return unique<BVSDivExpr>(Type(Type::BV, lhsTy.width), lhs, rhs);
 }
 
 ref<Expr> BVUDivExpr::create(ref<Expr> lhs, ref<Expr> rhs) {
@@ -662,54 +816,22 @@ ref<Expr> BVUDivExpr::create(ref<Expr> lhs, ref<Expr> rhs) {
       if (e2->getValue().getZExtValue() != 0)
         return BVConstExpr::create(e1->getValue().udiv(e2->getValue()));
 
-  return new BVUDivExpr(Type(Type::BV, lhsTy.width), lhs, rhs);
-}
-
-static ref<Expr> createExactBVSDivMul(Expr *nonConstOp, BVConstExpr *constOp,
-                                      int64_t div) {
-  int64_t mul = constOp->getValue().getSExtValue();
-  if (mul % div == 0) {
-    return BVMulExpr::create(nonConstOp,
-                             BVConstExpr::create(nonConstOp->getType().width,
-                                                 (uint64_t)(mul / div)));
-  }
-  return ref<Expr>();
+  return unique<BVUDivExpr>(Type(Type::BV, lhsTy.width), lhs, rhs);
 }
 
 ref<Expr> Expr::createExactBVSDiv(ref<Expr> lhs, uint64_t rhs, Var *base) {
   assert(rhs <= INT64_MAX);
   if (rhs == 1)
     return lhs;
-  if ((rhs & (rhs - 1)) != 0)
+  // A divisor of zero comes from an array of unknown range type.
+  if (rhs == 0 || (rhs & (rhs - 1)) != 0)
     return ref<Expr>();
 
-  if (auto *CE = dyn_cast<BVConstExpr>(lhs)) {
-    int64_t val = CE->getValue().getSExtValue();
-    if (val % ((int64_t)rhs) == 0)
-      return BVConstExpr::create(CE->getType().width,
-                                 (uint64_t)(val / ((int64_t)rhs)));
-  } else if (auto *AE = dyn_cast<BVAddExpr>(lhs)) {
-    auto lhsDiv = createExactBVSDiv(AE->getLHS(), rhs, base);
-    if (lhsDiv.isNull())
-      return ref<Expr>();
-    auto rhsDiv = createExactBVSDiv(AE->getRHS(), rhs, base);
-    if (!rhsDiv.isNull())
-      return BVAddExpr::create(lhsDiv, rhsDiv);
-  } else if (auto *ME = dyn_cast<BVMulExpr>(lhs)) {
-    if (auto *CE = dyn_cast<BVConstExpr>(ME->getLHS()))
-      return createExactBVSDivMul(ME->getRHS().get(), CE, (int64_t)rhs);
-    if (auto *CE = dyn_cast<BVConstExpr>(ME->getRHS()))
-      return createExactBVSDivMul(ME->getLHS().get(), CE, (int64_t)rhs);
-  } else if (base) {
-    if (auto *AOE = dyn_cast<ArrayOffsetExpr>(lhs)) {
-      if (auto *VRE = dyn_cast<VarRefExpr>(AOE->getSubExpr())) {
-        if (VRE->getVar() == base)
-          return lhs;
-      }
-    }
-  }
-
-  return ref<Expr>();
+  AffineForm AF(lhs->getType().width);
+  AF.add(lhs);
+  if (!AF.divideExact(rhs, base))
+    return ref<Expr>();
+  return AF.toExpr();
 }
 
 ref<Expr> BVSRemExpr::create(ref<Expr> lhs, ref<Expr> rhs) {
@@ -722,7 +844,7 @@ ref<Expr> BVSRemExpr::create(ref<Expr> lhs, ref<Expr> rhs) {
       if (e2->getValue().getSExtValue() != 0)
         return BVConstExpr::create(e1->getValue().srem(e2->getValue()));
 
-  return new BVSRemExpr(Type(Type::BV, lhsTy.width), lhs, rhs);
+  return unique<BVSRemExpr>(Type(Type::BV, lhsTy.width), lhs, rhs);
 }
 
 ref<Expr> BVURemExpr::create(ref<Expr> lhs, ref<Expr> rhs) {
@@ -735,7 +857,7 @@ ref<Expr> BVURemExpr::create(ref<Expr> lhs, ref<Expr> rhs) {
       if (e2->getValue().getZExtValue() != 0)
         return BVConstExpr::create(e1->getValue().urem(e2->getValue()));
 
-  return new BVURemExpr(Type(Type::BV, lhsTy.width), lhs, rhs);
+  return unique<BVURemExpr>(Type(Type::BV, lhsTy.width), lhs, rhs);
 }
 
 ref<Expr> BVShlExpr::create(ref<Expr> lhs, ref<Expr> rhs) {
@@ -747,7 +869,7 @@ ref<Expr> BVShlExpr::create(ref<Expr> lhs, ref<Expr> rhs) {
     if (auto e2 = dyn_cast<BVConstExpr>(rhs))
       return BVConstExpr::create(e1->getValue().shl(e2->getValue()));
 
-  return new BVShlExpr(Type(Type::BV, lhsTy.width), lhs, rhs);
+  return unique<BVShlExpr>(Type(Type::BV, lhsTy.width), lhs, rhs);
 }
 
 ref<Expr> BVAShrExpr::create(ref<Expr> lhs, ref<Expr> rhs) {
@@ -759,7 +881,7 @@ ref<Expr> BVAShrExpr::create(ref<Expr> lhs, ref<Expr> rhs) {
     if (auto e2 = dyn_cast<BVConstExpr>(rhs))
       return BVConstExpr::create(e1->getValue().ashr(e2->getValue()));
 
-  return new BVAShrExpr(Type(Type::BV, lhsTy.width), lhs, rhs);
+  return unique<BVAShrExpr>(Type(Type::BV, lhsTy.width), lhs, rhs);
 }
 
 ref<Expr> BVLShrExpr::create(ref<Expr> lhs, ref<Expr> rhs) {
@@ -771,7 +893,7 @@ ref<Expr> BVLShrExpr::create(ref<Expr> lhs, ref<Expr> rhs) {
     if (auto e2 = dyn_cast<BVConstExpr>(rhs))
       return BVConstExpr::create(e1->getValue().lshr(e2->getValue()));
 
-  return new BVLShrExpr(Type(Type::BV, lhsTy.width), lhs, rhs);
+  return unique<BVLShrExpr>(Type(Type::BV, lhsTy.width), lhs, rhs);
 }
 
 ref<Expr> BVAndExpr::create(ref<Expr> lhs, ref<Expr> rhs) {
@@ -783,7 +905,7 @@ ref<Expr> BVAndExpr::create(ref<Expr> lhs, ref<Expr> rhs) {
     if (auto e2 = dyn_cast<BVConstExpr>(rhs))
       return BVConstExpr::create(e1->getValue() & e2->getValue());
 
-  return new BVAndExpr(Type(Type::BV, lhsTy.width), lhs, rhs);
+  return unique<BVAndExpr>(Type(Type::BV, lhsTy.width), lhs, rhs);
 }
 
 ref<Expr> BVOrExpr::create(ref<Expr> lhs, ref<Expr> rhs) {
@@ -795,7 +917,7 @@ ref<Expr> BVOrExpr::create(ref<Expr> lhs, ref<Expr> rhs) {
     if (auto e2 = dyn_cast<BVConstExpr>(rhs))
       return BVConstExpr::create(e1->getValue() | e2->getValue());
 
-  return new BVOrExpr(Type(Type::BV, lhsTy.width), lhs, rhs);
+  return unique<BVOrExpr>(Type(Type::BV, lhsTy.width), lhs, rhs);
 }
 
 ref<Expr> BVXorExpr::create(ref<Expr> lhs, ref<Expr> rhs) {
@@ -807,7 +929,7 @@ ref<Expr> BVXorExpr::create(ref<Expr> lhs, ref<Expr> rhs) {
     if (auto e2 = dyn_cast<BVConstExpr>(rhs))
       return BVConstExpr::create(e1->getValue() ^ e2->getValue());
 
-  return new BVXorExpr(Type(Type::BV, lhsTy.width), lhs, rhs);
+  return unique<BVXorExpr>(Type(Type::BV, lhsTy.width), lhs, rhs);
 }
 
 ref<Expr> BVConcatExpr::create(ref<Expr> lhs, ref<Expr> rhs) {
@@ -823,13 +945,25 @@ ref<Expr> BVConcatExpr::create(ref<Expr> lhs, ref<Expr> rhs) {
       return BVConstExpr::create(Tmp);
     }
 
-  return new BVConcatExpr(Type(Type::BV, resWidth), lhs, rhs);
+  return unique<BVConcatExpr>(Type(Type::BV, resWidth), lhs, rhs);
+}
+
+// Concatenate the expressions in [begin, end), the first being the least
+// significant, as a balanced tree.  Extracting a single element from the
+// result then takes time logarithmic in the number of elements, and the
+// writer recurses no deeper.
+static ref<Expr> createBVConcatRange(const ref<Expr> *begin,
+                                     const ref<Expr> *end) {
+  if (end - begin == 1)
+    return *begin;
+  const ref<Expr> *mid = begin + (end - begin) / 2;
+  return BVConcatExpr::create(createBVConcatRange(mid, end),
+                              createBVConcatRange(begin, mid));
 }
 
 ref<Expr> Expr::createBVConcatN(const std::vector<ref<Expr>> &exprs) {
   assert(!exprs.empty());
-  return fold(exprs.back(), exprs.rbegin() + 1, exprs.rend(),
-              BVConcatExpr::create);
+  return createBVConcatRange(exprs.data(), exprs.data() + exprs.size());
 }
 
 #define ICMP_EXPR_CREATE(cls, method)                                          \
@@ -841,7 +975,7 @@ ref<Expr> Expr::createBVConcatN(const std::vector<ref<Expr>> &exprs) {
       if (auto e2 = dyn_cast<BVConstExpr>(rhs))                                \
         return BoolConstExpr::create(e1->getValue().method(e2->getValue()));   \
                                                                                \
-    return new cls(Type(Type::Bool), lhs, rhs);                                \
+    return unique<cls>(Type(Type::Bool), lhs, rhs);                            \
   }
 
 ICMP_EXPR_CREATE(BVUgtExpr, ugt)
@@ -857,84 +991,84 @@ ref<Expr> FAddExpr::create(ref<Expr> lhs, ref<Expr> rhs) {
   assert(lhs->getType().isKind(Type::BV));
   assert(lhs->getType() == rhs->getType());
 
-  return new FAddExpr(lhs->getType(), lhs, rhs);
+  return unique<FAddExpr>(lhs->getType(), lhs, rhs);
 }
 
 ref<Expr> FSubExpr::create(ref<Expr> lhs, ref<Expr> rhs) {
   assert(lhs->getType().isKind(Type::BV));
   assert(lhs->getType() == rhs->getType());
 
-  return new FSubExpr(lhs->getType(), lhs, rhs);
+  return unique<FSubExpr>(lhs->getType(), lhs, rhs);
 }
 
 ref<Expr> FMulExpr::create(ref<Expr> lhs, ref<Expr> rhs) {
   assert(lhs->getType().isKind(Type::BV));
   assert(lhs->getType() == rhs->getType());
 
-  return new FMulExpr(lhs->getType(), lhs, rhs);
+  return unique<FMulExpr>(lhs->getType(), lhs, rhs);
 }
 
 ref<Expr> FDivExpr::create(ref<Expr> lhs, ref<Expr> rhs) {
   assert(lhs->getType().isKind(Type::BV));
   assert(lhs->getType() == rhs->getType());
 
-  return new FDivExpr(lhs->getType(), lhs, rhs);
+  return unique<FDivExpr>(lhs->getType(), lhs, rhs);
 }
 
 ref<Expr> FRemExpr::create(ref<Expr> lhs, ref<Expr> rhs) {
   assert(lhs->getType().isKind(Type::BV));
   assert(lhs->getType() == rhs->getType());
 
-  return new FRemExpr(lhs->getType(), lhs, rhs);
+  return unique<FRemExpr>(lhs->getType(), lhs, rhs);
 }
 
 ref<Expr> FPowExpr::create(ref<Expr> lhs, ref<Expr> rhs) {
   assert(lhs->getType().isKind(Type::BV));
   assert(lhs->getType() == rhs->getType());
 
-  return new FPowExpr(lhs->getType(), lhs, rhs);
+  return unique<FPowExpr>(lhs->getType(), lhs, rhs);
 }
 
 ref<Expr> FMaxExpr::create(ref<Expr> lhs, ref<Expr> rhs) {
   assert(lhs->getType().isKind(Type::BV));
   assert(lhs->getType() == rhs->getType());
 
-  return new FMaxExpr(lhs->getType(), lhs, rhs);
+  return unique<FMaxExpr>(lhs->getType(), lhs, rhs);
 }
 
 ref<Expr> FMinExpr::create(ref<Expr> lhs, ref<Expr> rhs) {
   assert(lhs->getType().isKind(Type::BV));
   assert(lhs->getType() == rhs->getType());
 
-  return new FMinExpr(lhs->getType(), lhs, rhs);
+  return unique<FMinExpr>(lhs->getType(), lhs, rhs);
 }
 
 ref<Expr> FPowiExpr::create(ref<Expr> lhs, ref<Expr> rhs) {
   assert(lhs->getType().isKind(Type::BV));
   assert(rhs->getType().isKind(Type::BV));
 
-  return new FPowiExpr(lhs->getType(), lhs, rhs);
+  return unique<FPowiExpr>(lhs->getType(), lhs, rhs);
 }
 
 ref<Expr> FLtExpr::create(ref<Expr> lhs, ref<Expr> rhs) {
   assert(lhs->getType().isKind(Type::BV));
   assert(lhs->getType() == rhs->getType());
 
-  return new FLtExpr(Type(Type::Bool), lhs, rhs);
+  return unique<FLtExpr>(Type(Type::Bool), lhs, rhs);
 }
 
 ref<Expr> FEqExpr::create(ref<Expr> lhs, ref<Expr> rhs) {
   assert(lhs->getType().isKind(Type::BV));
   assert(lhs->getType() == rhs->getType());
 
-  return new FEqExpr(Type(Type::Bool), lhs, rhs);
+  return unique<FEqExpr>(Type(Type::Bool), lhs, rhs);
 }
 
 ref<Expr> FUnoExpr::create(ref<Expr> lhs, ref<Expr> rhs) {
   assert(lhs->getType().isKind(Type::BV));
   assert(lhs->getType() == rhs->getType());
 
-  return new FUnoExpr(Type(Type::Bool), lhs, rhs);
+  return unique<FUnoExpr>(Type(Type::Bool), lhs, rhs);
 }
 
 ref<Expr> Expr::createPtrLt(ref<Expr> lhs, ref<Expr> rhs, Type defaultRange) {
@@ -959,7 +1093,7 @@ ref<Expr> PtrLtExpr::create(ref<Expr> lhs, ref<Expr> rhs) {
   assert(lhs->getType().isKind(Type::Pointer));
   assert(rhs->getType().isKind(Type::Pointer));
 
-  return new PtrLtExpr(Type(Type::Bool), lhs, rhs);
+  return unique<PtrLtExpr>(Type(Type::Bool), lhs, rhs);
 }
 
 ref<Expr> Expr::createFuncPtrLt(ref<Expr> lhs, ref<Expr> rhs) {
@@ -976,19 +1110,19 @@ ref<Expr> FuncPtrLtExpr::create(ref<Expr> lhs, ref<Expr> rhs) {
   assert(lhs->getType().isKind(Type::FunctionPointer));
   assert(rhs->getType().isKind(Type::FunctionPointer));
 
-  return new FuncPtrLtExpr(Type(Type::Bool), lhs, rhs);
+  return unique<FuncPtrLtExpr>(Type(Type::Bool), lhs, rhs);
 }
 
 ref<Expr> ImpliesExpr::create(ref<Expr> lhs, ref<Expr> rhs) {
   assert(lhs->getType().isKind(Type::Bool));
   assert(rhs->getType().isKind(Type::Bool));
 
-  return new ImpliesExpr(Type(Type::Bool), lhs, rhs);
+  return unique<ImpliesExpr>(Type(Type::Bool), lhs, rhs);
 }
 
 ref<Expr> CallExpr::create(Function *f, const std::vector<ref<Expr>> &args) {
   assert(f->return_begin() + 1 == f->return_end());
-  return new CallExpr((*f->return_begin())->getType(), f, args);
+  return construct<CallExpr>((*f->return_begin())->getType(), f, args);
 }
 
 ref<Expr> CallMemberOfExpr::create(ref<Expr> f, std::vector<ref<Expr>> &ces) {
@@ -1001,33 +1135,33 @@ ref<Expr> CallMemberOfExpr::create(ref<Expr> f, std::vector<ref<Expr>> &ces) {
     return cast<CallExpr>(E)->getType() == Ty;
   }));
 
-  return new CallMemberOfExpr(Ty, f, ces);
+  return construct<CallMemberOfExpr>(Ty, f, ces);
 }
 
 ref<Expr> OldExpr::create(ref<Expr> op) {
-  return new OldExpr(op->getType(), op);
+  return unique<OldExpr>(op->getType(), op);
 }
 
 ref<Expr> GetImageWidthExpr::create(ref<Expr> op) {
-  return new GetImageWidthExpr(Type(Type::BV, 32), op);
+  return unique<GetImageWidthExpr>(Type(Type::BV, 32), op);
 }
 
 ref<Expr> GetImageHeightExpr::create(ref<Expr> op) {
-  return new GetImageHeightExpr(Type(Type::BV, 32), op);
+  return unique<GetImageHeightExpr>(Type(Type::BV, 32), op);
 }
 
 ref<Expr> OtherBoolExpr::create(ref<Expr> op) {
   assert(op->getType().isKind(Type::Bool));
-  return new OtherBoolExpr(Type(Type::Bool), op);
+  return unique<OtherBoolExpr>(Type(Type::Bool), op);
 }
 
 ref<Expr> OtherIntExpr::create(ref<Expr> op) {
   assert(op->getType().isKind(Type::BV));
-  return new OtherIntExpr(Type(Type::BV, op->getType().width), op);
+  return unique<OtherIntExpr>(Type(Type::BV, op->getType().width), op);
 }
 
 ref<Expr> OtherPtrBaseExpr::create(ref<Expr> op) {
-  return new OtherPtrBaseExpr(op->getType(), op);
+  return unique<OtherPtrBaseExpr>(op->getType(), op);
 }
 
 ref<Expr> AccessHasOccurredExpr::create(ref<Expr> array, bool isWrite) {
@@ -1051,7 +1185,7 @@ ref<Expr> ArraySnapshotExpr::create(ref<Expr> dst, ref<Expr> src) {
 ref<Expr> UnderlyingArrayExpr::create(ref<Expr> array) {
   assert(array->getType().array);
 
-  return new UnderlyingArrayExpr(array);
+  return unique<UnderlyingArrayExpr>(array);
 }
 
 ref<Expr> AddNoovflExpr::create(ref<Expr> first, ref<Expr> second,
@@ -1060,7 +1194,7 @@ ref<Expr> AddNoovflExpr::create(ref<Expr> first, ref<Expr> second,
   assert(second->getType().isKind(Type::BV));
   assert(first->getType().width == second->getType().width);
 
-  return new AddNoovflExpr(first, second, isSigned);
+  return unique<AddNoovflExpr>(first, second, isSigned);
 }
 
 ref<Expr> AddNoovflPredicateExpr::create(const std::vector<ref<Expr>> &exprs) {
@@ -1070,13 +1204,14 @@ ref<Expr> AddNoovflPredicateExpr::create(const std::vector<ref<Expr>> &exprs) {
            E->getType().width == exprs[0]->getType().width;
   }));
 
-  return new AddNoovflPredicateExpr(exprs);
+  return unique<AddNoovflPredicateExpr>(exprs);
 }
 
 ref<Expr>
 UninterpretedFunctionExpr::create(const std::string &name, Type returnType,
                                   const std::vector<ref<Expr>> &args) {
-  return new UninterpretedFunctionExpr(name, returnType, args);
+  return unique<UninterpretedFunctionExpr>(StringTable::intern(name),
+                                           returnType, args);
 }
 
 ref<Expr> AtomicHasTakenValueExpr::create(ref<Expr> atomicArray,
@@ -1100,3 +1235,100 @@ ref<Expr> AsyncWorkGroupCopyExpr::create(ref<Expr> dst, ref<Expr> dstOffset,
   return new AsyncWorkGroupCopyExpr(dst, dstOffset, src, srcOffset, size,
                                     handle);
 }
+
+ref<Expr> VectorBinaryExpr::create(Kind op, unsigned lanes, ref<Expr> lhs,
+                                   ref<Expr> rhs) {
+  assert(lhs->getType().isKind(Type::BV));
+  assert(lhs->getType() == rhs->getType());
+  assert(lanes != 0 && lhs->getType().width % lanes == 0);
+
+  if (lanes == 1)
+    return createLane(op, lhs, rhs);
+
+  // Lanes of constant vectors fold to constants, so the vector does too.
+  if (op >= BVAdd && op <= BVXor && isa<BVConstExpr>(lhs) &&
+      isa<BVConstExpr>(rhs)) {
+    unsigned LaneWidth = lhs->getType().width / lanes;
+    std::vector<ref<Expr>> Lanes;
+    for (unsigned i = 0; i < lanes; ++i)
+      Lanes.push_back(
+          createLane(op, BVExtractExpr::create(lhs, i * LaneWidth, LaneWidth),
+                     BVExtractExpr::create(rhs, i * LaneWidth, LaneWidth)));
+    return createBVConcatN(Lanes);
+  }
+
+  return unique<VectorBinaryExpr>(op, lanes, lhs, rhs);
+}
+
+// The lane of a shuffle picked by the given mask value.
+static ref<Expr> createShuffleLane(ref<Expr> vec1, ref<Expr> vec2,
+                                   unsigned laneWidth, int maskVal) {
+  if (maskVal < 0)
+    return BVConstExpr::createZero(laneWidth);
+  unsigned Vec1Lanes = vec1->getType().width / laneWidth;
+  unsigned Lane = maskVal;
+  if (Lane < Vec1Lanes)
+    return BVExtractExpr::create(vec1, Lane * laneWidth, laneWidth);
+  return BVExtractExpr::create(vec2, (Lane - Vec1Lanes) * laneWidth,
+                               laneWidth);
+}
+
+ref<Expr> VectorShuffleExpr::create(ref<Expr> vec1, ref<Expr> vec2,
+                                    unsigned laneWidth,
+                                    llvm::ArrayRef<int> mask) {
+  assert(vec1->getType().isKind(Type::BV));
+  assert(vec2->getType().isKind(Type::BV));
+  assert(laneWidth != 0 && !mask.empty());
+  assert(vec1->getType().width % laneWidth == 0);
+  assert(vec2->getType().width % laneWidth == 0);
+
+  if (mask.size() == 1)
+    return createShuffleLane(vec1, vec2, laneWidth, mask[0]);
+
+  // A mask picking the lanes of vec1 in order leaves it unchanged.
+  unsigned Vec1Lanes = vec1->getType().width / laneWidth;
+  bool Identity = mask.size() == Vec1Lanes;
+  for (unsigned i = 0; Identity && i < mask.size(); ++i)
+    Identity = mask[i] == (int)i;
+  if (Identity)
+    return vec1;
+
+  // Lanes of constant vectors fold to constants, so the vector does too.
+  if (isa<BVConstExpr>(vec1) && isa<BVConstExpr>(vec2)) {
+    std::vector<ref<Expr>> Lanes;
+    for (int M : mask)
+      Lanes.push_back(createShuffleLane(vec1, vec2, laneWidth, M));
+    return createBVConcatN(Lanes);
+  }
+
+  return unique<VectorShuffleExpr>(Type(Type::BV, laneWidth * mask.size()),
+                                   vec1, vec2, laneWidth, mask);
+}
+
+ref<Expr> VectorBinaryExpr::createLane(Kind op, ref<Expr> lhs, ref<Expr> rhs) {
+  switch (op) {
+  case BVAdd:  return BVAddExpr::create(lhs, rhs);
+  case BVSub:  return BVSubExpr::create(lhs, rhs);
+  case BVMul:  return BVMulExpr::create(lhs, rhs);
+  case BVSDiv: return BVSDivExpr::create(lhs, rhs);
+  case BVUDiv: return BVUDivExpr::create(lhs, rhs);
+  case BVSRem: return BVSRemExpr::create(lhs, rhs);
+  case BVURem: return BVURemExpr::create(lhs, rhs);
+  case BVShl:  return BVShlExpr::create(lhs, rhs);
+  case BVAShr: return BVAShrExpr::create(lhs, rhs);
+  case BVLShr: return BVLShrExpr::create(lhs, rhs);
+  case BVAnd:  return BVAndExpr::create(lhs, rhs);
+  case BVOr:   return BVOrExpr::create(lhs, rhs);
+  case BVXor:  return BVXorExpr::create(lhs, rhs);
+  case FAdd:   return FAddExpr::create(lhs, rhs);
+  case FSub:   return FSubExpr::create(lhs, rhs);
+  case FMul:   return FMulExpr::create(lhs, rhs);
+  case FDiv:   return FDivExpr::create(lhs, rhs);
+  case FRem:   return FRemExpr::create(lhs, rhs);
+  case FPow:   return FPowExpr::create(lhs, rhs);
+  case FMax:   return FMaxExpr::create(lhs, rhs);
+  case FMin:   return FMinExpr::create(lhs, rhs);
+  default:
+    llvm_unreachable("Unsupported vector binary expr opcode");
+  }
+}
@@ -0,0 +1,48 @@
+#include "bugle/GlobalArraySet.h"
+#include "bugle/GlobalArray.h"
+#include "bugle/Module.h"
+
+using namespace bugle;
+
+void GlobalArraySet::addRangeType(Type t) {
+  if (rangeType.isKind(Type::Any) || t.isKind(Type::Unknown))
+    rangeType = t;
+  else if (!t.isKind(Type::Any) && rangeType != t)
+    rangeType = Type(Type::Unknown);
+}
+
+void GlobalArraySet::insert(GlobalArray *array) {
+  if (!array) {
+    null = true;
+    return;
+  }
+
+  assert((!module || module == array->getModule()) &&
+         "Arrays of different modules");
+  module = array->getModule();
+  unsigned index = array->getIndex();
+  if (index >= arrays.size())
+    arrays.resize(module->global_size());
+  if (arrays.test(index))
+    return;
+  arrays.set(index);
+  addRangeType(array->getRangeType());
+}
+
+void GlobalArraySet::insert(const GlobalArraySet &other) {
+  if (other.module) {
+    assert((!module || module == other.module) &&
+           "Arrays of different modules");
+    module = other.module;
+    arrays |= other.arrays;
+  }
+  null |= other.null;
+  addRangeType(other.rangeType);
+}
+
+void GlobalArraySet::getArrays(std::set<GlobalArray *> &Set) const {
+  for (int i = arrays.find_first(); i != -1; i = arrays.find_next(i))
+    Set.insert(module->getGlobal(i));
+  if (null)
+    Set.insert(nullptr);
+}
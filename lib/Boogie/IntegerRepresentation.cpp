@@ -0,0 +1,40 @@
+#include "bugle/IntegerRepresentation.h"
+#include "llvm/Support/raw_ostream.h"
+
+namespace bugle {
+
+const std::string &IntegerRepresentation::getType(unsigned bitWidth) {
+  {
+    llvm::sys::SmartScopedReader<true> Reader(Lock);
+    auto i = Types.find(bitWidth);
+    if (i != Types.end())
+      return i->second;
+  }
+  llvm::sys::SmartScopedWriter<true> Writer(Lock);
+  auto i = Types.find(bitWidth);
+  if (i == Types.end())
+    i = Types.insert(std::make_pair(bitWidth, makeType(bitWidth))).first;
+  return i->second;
+}
+
+const std::string &IntegerRepresentation::getLiteralSuffix(unsigned bitWidth) {
+  {
+    llvm::sys::SmartScopedReader<true> Reader(Lock);
+    auto i = LiteralSuffixes.find(bitWidth);
+    if (i != LiteralSuffixes.end())
+      return i->second;
+  }
+  llvm::sys::SmartScopedWriter<true> Writer(Lock);
+  auto i = LiteralSuffixes.find(bitWidth);
+  if (i == LiteralSuffixes.end())
+    i = LiteralSuffixes.insert(std::make_pair(bitWidth,
+                                              makeLiteralSuffix(bitWidth)))
+            .first;
+  return i->second;
+}
+
+void IntegerRepresentation::writeLiteral(llvm::raw_ostream &OS,
+                                         uint64_t literal, unsigned bitWidth) {
+  OS << literal << getLiteralSuffix(bitWidth);
+}
+}
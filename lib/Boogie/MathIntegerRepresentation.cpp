@@ -4,51 +4,41 @@
 
 namespace bugle {
 
-std::string MathIntegerRepresentation::getType(unsigned bitWidth) {
+std::string MathIntegerRepresentation::makeType(unsigned bitWidth) {
   return "int";
 }
 
-std::string MathIntegerRepresentation::getLiteralSuffix(unsigned bitWidth) {
+std::string MathIntegerRepresentation::makeLiteralSuffix(unsigned bitWidth) {
   return "";
 }
 
-std::string MathIntegerRepresentation::getLiteral(unsigned literal,
-                                                  unsigned bitWidth) {
-  std::string S; llvm::raw_string_ostream SS(S);
-  SS << literal;
-  return SS.str();
-}
-
-std::string MathIntegerRepresentation::getZeroExtend(unsigned FromWidth,
-                                                     unsigned ToWidth) {
-  std::string S;
-  llvm::raw_string_ostream SS(S);
-  SS << "function {:inline true} BV" << FromWidth << "_ZEXT" << ToWidth
+void MathIntegerRepresentation::writeZeroExtend(llvm::raw_ostream &OS,
+                                                unsigned FromWidth,
+                                                unsigned ToWidth) {
+  OS << "function {:inline true} BV" << FromWidth << "_ZEXT" << ToWidth
      << "(x : int) : int {\n"
      << "  if x >= 0 then x "
      << "else BV" << FromWidth << "_ZEXT" << ToWidth << "_UF(x)\n"
      << "}\n"
      << "function BV" << FromWidth << "_ZEXT" << ToWidth << "_UF(int) : int;";
-  return SS.str();
 }
 
-std::string MathIntegerRepresentation::getSignExtend(unsigned FromWidth,
-                                                     unsigned ToWidth) {
-  std::string S;
-  llvm::raw_string_ostream SS(S);
-  SS << "function {:inline true} BV" << FromWidth << "_SEXT" << ToWidth
+void MathIntegerRepresentation::writeSignExtend(llvm::raw_ostream &OS,
+                                                unsigned FromWidth,
+                                                unsigned ToWidth) {
+  OS << "function {:inline true} BV" << FromWidth << "_SEXT" << ToWidth
      << "(x : int) : int {\n"
      << "  if x <= 0 then x "
      << "else BV" << FromWidth << "_SEXT" << ToWidth << "_UF(x)\n"
      << "}\n"
      << "function BV" << FromWidth << "_SEXT" << ToWidth << "_UF(int) : int;";
-  return SS.str();
 }
 
-std::string MathIntegerRepresentation::getArithmeticBinary(
-    std::string Name, bugle::Expr::Kind Kind, unsigned Width) {
-  std::string S; llvm::raw_string_ostream SS(S);
-  SS << "function ";
+void MathIntegerRepresentation::writeArithmeticBinary(llvm::raw_ostream &OS,
+                                                      llvm::StringRef Name,
+                                                      bugle::Expr::Kind Kind,
+                                                      unsigned Width) {
+  OS << "function ";
 
   switch (Kind) {
   case Expr::BVAdd:
@@ -70,83 +60,84 @@ std::string MathIntegerRepresentation::getArithmeticBinary(
     default:
       llvm_unreachable("huh?");
     }
-    SS << "{:inline true} BV" << Width << "_" << Name
+    OS << "{:inline true} BV" << Width << "_" << Name
        << "(x : int, y : int) : int {\n"
        << "  x " << infixOp << " y\n"
        << "}";
-    return SS.str();
+    return;
   default:
     /* do nothing */
     break;
   }
 
   if (Kind == Expr::BVAnd) {
-    SS << "{:inline true} BV" << Width << "_" << Name
+    OS << "{:inline true} BV" << Width << "_" << Name
        << "(x : int, y : int) : int {\n"
        << "  if x == y then x "
        << "else (if x == 0 || y == 0 then 0 "
        << "else BV" << Width << "_" << Name << "_UF(x, y))\n"
        << "}\n"
        << "function BV" << Width << "_" << Name << "_UF(int, int) : int;";
-    return SS.str();
+    return;
   }
 
   if (Kind == Expr::BVOr) {
-    SS << "{:inline true} BV" << Width << "_" << Name
+    OS << "{:inline true} BV" << Width << "_" << Name
        << "(x : int, y : int) : int {\n"
        << "  if x == y then x "
        << "else (if x == 0 then y else (if y == 0 then x "
        << "else BV" << Width << "_" << Name << "_UF(x, y)))\n"
        << "}\n"
        << "function BV" << Width << "_" << Name << "_UF(int, int) : int;";
-    return SS.str();
+    return;
   }
 
   if (Kind == Expr::BVXor) {
-    SS << "{:inline true} BV" << Width << "_" << Name
+    OS << "{:inline true} BV" << Width << "_" << Name
        << "(x : int, y : int) : int {\n";
 
     if (Width == 1) {
-      SS << "  if (x == 1 || x == -1) && (y == 1 || y == -1) then 0 else (\n"
+      OS << "  if (x == 1 || x == -1) && (y == 1 || y == -1) then 0 else (\n"
          << "    if (x == 1 || x == -1) && y == 0 then 1 else (\n"
          << "      if x == 0 && (y == 1 || y == -1) then 1 else (\n"
          << "        if x == y then 0 else BV" << Width << "_"
                                                << Name << "_UF(x, y))))\n";
     } else {
-      SS << "  if x == y then 0 "
+      OS << "  if x == y then 0 "
          << "else (if x == 0 then y else (if y == 0 then x "
          << "else BV" << Width << "_" << Name << "_UF(x, y)))\n";
     }
 
-    SS << "}\n"
+    OS << "}\n"
        << "function BV" << Width << "_" << Name << "_UF(int, int) : int;";
-    return SS.str();
+    return;
   }
 
   if (Kind == Expr::BVShl) {
-    SS << "{:inline true} BV" << Width << "_" << Name
+    OS << "{:inline true} BV" << Width << "_" << Name
        << "(x : int, y : int) : int {\n"
        << "  if x >= 0 && y == 1 then x*2 else BV" << Width << "_"
                                                    << Name << "_UF(x,y)\n"
        << "}\n"
        << "function BV" << Width << "_" << Name << "_UF(int, int) : int;";
-    return SS.str();
+    return;
   }
 
   switch (Kind) {
   case Expr::BVAShr:
   case Expr::BVLShr:
-    SS << " BV" << Width << "_" << Name
+    OS << " BV" << Width << "_" << Name
        << "(int, int) : int;";
-    return SS.str();
+    return;
   default:
     llvm_unreachable("huh?");
   }
 }
 
-std::string MathIntegerRepresentation::getBooleanBinary(std::string Name,
-                                                        bugle::Expr::Kind Kind,
-                                                        unsigned Width) {
+void MathIntegerRepresentation::writeBooleanBinary(llvm::raw_ostream &OS,
+                                                   llvm::StringRef Name,
+                                                   bugle::Expr::Kind Kind,
+                                                   unsigned Width) {
   const char *infixOp;
   switch (Kind) {
   case Expr::BVUgt: infixOp = ">";  break;
@@ -161,12 +152,10 @@ std::string MathIntegerRepresentation::getBooleanBinary(std::string Name,
     llvm_unreachable("huh?");
   }
 
-  std::string S; llvm::raw_string_ostream SS(S);
-  SS << "function {:inline true} BV" << Width << "_" << Name
+  OS << "function {:inline true} BV" << Width << "_" << Name
      << "(x : int, y : int) : bool {\n"
      << "  x " << infixOp << " y\n"
      << "}";
-  return SS.str();
 }
 
 void MathIntegerRepresentation::printVal(llvm::raw_ostream &OS,
@@ -174,36 +163,41 @@ void MathIntegerRepresentation::printVal(llvm::raw_ostream &OS,
   Val.print(OS, /*isSigned=*/true);
 }
 
-std::string MathIntegerRepresentation::getExtractExpr(const std::string &Expr,
-                                                      unsigned UpperBit,
-                                                      unsigned LowerBit) {
-  std::string S; llvm::raw_string_ostream SS(S);
-  SS << "BV_EXTRACT(" << Expr << ", " << UpperBit << ", " << LowerBit << ")";
-  return SS.str();
+void MathIntegerRepresentation::writeExtractExpr(llvm::raw_ostream &OS,
+                                                 OperandWriter Expr,
+                                                 unsigned UpperBit,
+                                                 unsigned LowerBit) {
+  OS << "BV_EXTRACT(";
+  Expr(OS);
+  OS << ", " << UpperBit << ", " << LowerBit << ")";
 }
 
 bool MathIntegerRepresentation::abstractsExtract() { return true; }
 
-std::string MathIntegerRepresentation::getExtract() {
-  return "function BV_EXTRACT(int, int, int) : int;";
+void MathIntegerRepresentation::writeExtract(llvm::raw_ostream &OS) {
+  OS << "function BV_EXTRACT(int, int, int) : int;";
 }
 
 bool MathIntegerRepresentation::abstractsConcat() { return true; }
 
-std::string MathIntegerRepresentation::getConcat() {
-  return "function BV_CONCAT(int, int) : int;";
+void MathIntegerRepresentation::writeConcat(llvm::raw_ostream &OS) {
+  OS << "function BV_CONCAT(int, int) : int;";
 }
 
-std::string MathIntegerRepresentation::getConcatExpr(const std::string &Lhs,
-                                                     const std::string &Rhs) {
-  return "BV_CONCAT(" + Lhs + ", " + Rhs + ")";
+void MathIntegerRepresentation::writeConcatExpr(llvm::raw_ostream &OS,
+                                                OperandWriter Lhs,
+                                                OperandWriter Rhs) {
+  OS << "BV_CONCAT(";
+  Lhs(OS);
+  OS << ", ";
+  Rhs(OS);
+  OS << ")";
 }
 
-std::string MathIntegerRepresentation::getCtlz(unsigned Width) {
-  std::string S; llvm::raw_string_ostream SS(S);
-  SS << "procedure BV" << Width << "_CTLZ"
+void MathIntegerRepresentation::writeCtlz(llvm::raw_ostream &OS,
+                                          unsigned Width) {
+  OS << "procedure BV" << Width << "_CTLZ"
      << "(val : int, isZeroUndef : bool) "
      << "returns (count : int);";
-  return SS.str();
 }
 }
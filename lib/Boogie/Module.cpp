@@ -0,0 +1,49 @@
+#include "bugle/Module.h"
+#include "bugle/Expr.h"
+#include <algorithm>
+
+using namespace bugle;
+
+static bool isSameConstant(Expr *E1, Expr *E2) {
+  if (E1 == E2)
+    return true;
+  auto *C1 = dyn_cast<BVConstExpr>(E1), *C2 = dyn_cast<BVConstExpr>(E2);
+  return C1 && C2 && C1->getValue() == C2->getValue();
+}
+
+void Module::addGlobalInit(GlobalArray *array, uint64_t offset,
+                           ref<Expr> init, uint64_t count) {
+  if (count == 0)
+    return;
+  if (!globalInits.empty()) {
+    GlobalInit &Last = globalInits.back();
+    if (Last.array == array && Last.offset + Last.count == offset &&
+        isSameConstant(Last.init.get(), init.get())) {
+      Last.count += count;
+      return;
+    }
+  }
+  globalInits.push_back(GlobalInit(array, offset, init, count));
+}
+
+void Module::adoptFunctions(Module &from, const std::set<Function *> &fns) {
+  auto i = std::stable_partition(
+      from.functions.begin(), from.functions.end(),
+      [&](Function *F) { return fns.find(F) == fns.end(); });
+  for (auto j = i; j != from.functions.end(); ++j) {
+    (*j)->name = functionNames.makeName((*j)->name);
+    functions.push_back(*j);
+  }
+  from.functions.erase(i, from.functions.end());
+}
+
+void Module::adoptGlobal(Module &from, GlobalArray *GA) {
+  auto i = std::find(from.globals.begin(), from.globals.end(), GA);
+  assert(i != from.globals.end() && "Array not in module");
+  for (auto j = from.globals.erase(i); j != from.globals.end(); ++j)
+    --(*j)->index;
+  GA->name = globalNames.makeName(GA->name);
+  GA->module = this;
+  GA->index = globals.size();
+  globals.push_back(GA);
+}
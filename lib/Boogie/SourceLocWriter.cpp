@@ -1,25 +1,134 @@
 #include "bugle/SourceLocWriter.h"
 #include "bugle/SourceLoc.h"
+#include "bugle/util/SourceLocReader.h"
+#include "llvm/Support/CommandLine.h"
+#include "llvm/Support/Endian.h"
 #include "llvm/Support/raw_ostream.h"
 #include "llvm/Support/ToolOutputFile.h"
 
 using namespace bugle;
 
+static llvm::cl::opt<bool> InternSourceLocStrings(
+    "intern-source-loc-strings", llvm::cl::init(false),
+    llvm::cl::desc("Write the file names and paths of source locations once, "
+                   "in a table at the start of the source location file"));
+
+static llvm::cl::opt<bool> BinarySourceLocs(
+    "binary-source-locs", llvm::cl::init(false),
+    llvm::cl::desc("Write the source location file in an indexed binary "
+                   "format, for lookup without reading the whole file"));
+
+SourceLocWriter::SourceLocWriter(llvm::ToolOutputFile *L)
+    : OS(L ? &L->os() : nullptr),
+      Intern(InternSourceLocStrings || BinarySourceLocs),
+      Binary(BinarySourceLocs) {}
+
+bool SourceLocWriter::writesBinary() { return BinarySourceLocs; }
+
+static void writeWord(llvm::raw_ostream &OS, uint32_t Word) {
+  char Bytes[4];
+  llvm::support::endian::write32le(Bytes, Word);
+  OS.write(Bytes, 4);
+}
+
+unsigned SourceLocWriter::intern(const std::string &S) {
+  auto i = StringIds.insert(std::make_pair(S, Strings.size()));
+  if (i.second)
+    Strings.push_back(&i.first->first);
+  return i.first->second;
+}
+
 unsigned SourceLocWriter::writeSourceLocs(const SourceLocsRef &SourceLocs) {
-  ++SourceLocCounter;
-  if (L == nullptr)
-    return SourceLocCounter - 1;
+  auto i = NumbersByIdentity.find(SourceLocs);
+  if (i != NumbersByIdentity.end())
+    return i->second;
+
+  std::string Group;
+  llvm::raw_string_ostream GS(Group);
+  for (const auto &SL : *SourceLocs) {
+    GS << SL.getLineNo() << "\x1F";   // unit separator
+    GS << SL.getColNo() << "\x1F";    // unit separator
+    GS << SL.getFileName() << "\x1F"; // unit separator
+    GS << SL.getPath() << "\x1F";     // unit separator
+    GS << "\x1E";                     // record separator
+  }
+  GS << "\x1D"; // group separator
+  GS.flush();
+
+  auto j = NumbersByValue.insert(std::make_pair(Group, Numbered.size()));
+  NumbersByIdentity[SourceLocs] = j.first->second;
+  if (!j.second)
+    return j.first->second;
+
+  Numbered.push_back(SourceLocs);
+  if (OS == nullptr)
+    return j.first->second;
 
-  llvm::raw_ostream &OS = L->os();
+  if (!Intern) {
+    *OS << Group;
+    return j.first->second;
+  }
+
+  llvm::raw_string_ostream RS(Records);
+  if (Binary) {
+    ChainStarts.push_back(Records.size() / BinarySourceLocFormat::RecordSize);
+    for (const auto &SL : *SourceLocs) {
+      writeWord(RS, SL.getLineNo());
+      writeWord(RS, SL.getColNo());
+      writeWord(RS, intern(SL.getFileName()));
+      writeWord(RS, intern(SL.getPath()));
+    }
+    RS.flush();
+    return j.first->second;
+  }
 
   for (const auto &SL : *SourceLocs) {
-    OS << SL.getLineNo() << "\x1F";   // unit separator
-    OS << SL.getColNo() << "\x1F";    // unit separator
-    OS << SL.getFileName() << "\x1F"; // unit separator
-    OS << SL.getPath() << "\x1F";     // unit separator
-    OS << "\x1E";                     // record separator
+    RS << SL.getLineNo() << "\x1F";
+    RS << SL.getColNo() << "\x1F";
+    RS << intern(SL.getFileName()) << "\x1F";
+    RS << intern(SL.getPath()) << "\x1F";
+    RS << "\x1E";
+  }
+  RS << "\x1D";
+  RS.flush();
+  return j.first->second;
+}
+
+void SourceLocWriter::writeBinary() {
+  writeWord(*OS, BinarySourceLocFormat::Magic);
+  writeWord(*OS, BinarySourceLocFormat::Version);
+  writeWord(*OS, ChainStarts.size());
+  writeWord(*OS, Strings.size());
+
+  for (uint32_t Start : ChainStarts)
+    writeWord(*OS, Start);
+  writeWord(*OS, Records.size() / BinarySourceLocFormat::RecordSize);
+
+  uint32_t Offset = 0;
+  for (const auto *S : Strings) {
+    writeWord(*OS, Offset);
+    Offset += S->size();
+  }
+  writeWord(*OS, Offset);
+
+  *OS << Records;
+  for (const auto *S : Strings)
+    *OS << *S;
+}
+
+void SourceLocWriter::finish() {
+  if (OS == nullptr || !Intern)
+    return;
+
+  if (Binary) {
+    writeBinary();
+    Records.clear();
+    return;
   }
-  OS << "\x1D"; // group separator
 
-  return SourceLocCounter - 1;
+  *OS << "\x1C"; // file separator
+  for (const auto *S : Strings)
+    *OS << *S << "\x1F";
+  *OS << "\x1C" << Records;
+  Records.clear();
 }
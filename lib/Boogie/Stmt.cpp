@@ -110,3 +110,29 @@ WaitGroupEventStmt::create(ref<Expr> handle, const SourceLocsRef &sourcelocs) {
   assert(handle->getType().isKind(Type::BV));
   return new WaitGroupEventStmt(handle, sourcelocs);
 }
+
+AssumeElementsStmt *AssumeElementsStmt::createFill(ref<Expr> array,
+                                                   ref<Expr> offset,
+                                                   ref<Expr> count,
+                                                   ref<Expr> value) {
+  assert(array->getType().array);
+  assert(offset->getType().isKind(Type::BV));
+  assert(count->getType() == offset->getType());
+  assert(value->getType().width == array->getType().width);
+  return new AssumeElementsStmt(array, offset, count, value, ref<Expr>(),
+                                ref<Expr>());
+}
+
+AssumeElementsStmt *AssumeElementsStmt::createCopy(ref<Expr> array,
+                                                   ref<Expr> offset,
+                                                   ref<Expr> count,
+                                                   ref<Expr> srcArray,
+                                                   ref<Expr> srcOffset) {
+  assert(array->getType().array && srcArray->getType().array);
+  assert(array->getType().range() == srcArray->getType().range());
+  assert(offset->getType().isKind(Type::BV));
+  assert(count->getType() == offset->getType());
+  assert(srcOffset->getType() == offset->getType());
+  return new AssumeElementsStmt(array, offset, count, ref<Expr>(), srcArray,
+                                srcOffset);
+}
@@ -0,0 +1,14 @@
+#include "bugle/StringTable.h"
+#include "llvm/Support/ErrorHandling.h"
+
+using namespace bugle;
+
+StringTable *StringTable::current = nullptr;
+
+const std::string *StringTable::intern(const std::string &s) {
+  if (!current)
+    llvm::report_fatal_error("No current string table");
+
+  std::lock_guard<std::mutex> Lock(current->mutex);
+  return &*current->strings.insert(s).first;
+}
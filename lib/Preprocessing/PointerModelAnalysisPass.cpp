@@ -0,0 +1,384 @@
+#include "bugle/Preprocessing/PointerModelAnalysisPass.h"
+#include "bugle/Translator/TranslateFunction.h"
+#include "klee/util/GetElementPtrTypeIterator.h"
+#include "llvm/Pass.h"
+#include "llvm/ADT/STLExtras.h"
+#include "llvm/IR/Constants.h"
+#include "llvm/IR/Function.h"
+#include "llvm/IR/Instructions.h"
+#include "llvm/IR/Module.h"
+#include "llvm/Support/MathExtras.h"
+#include "llvm/Support/raw_ostream.h"
+
+using namespace llvm;
+using namespace bugle;
+
+// Mirrors TranslateModule::translateArrayRangeType, except that types which
+// need special treatment by the translator are reported as unknown.
+bugle::Type PointerModelAnalysisPass::getRangeType(llvm::Type *T) {
+  if (!T->isSized())
+    return bugle::Type(bugle::Type::Unknown);
+
+  bugle::Type ElTy(bugle::Type::Unknown);
+  if (auto *AT = dyn_cast<ArrayType>(T)) {
+    ElTy = getRangeType(AT->getElementType());
+  } else if (auto *VT = dyn_cast<VectorType>(T)) {
+    ElTy = getRangeType(VT->getElementType());
+  } else if (auto *ST = dyn_cast<StructType>(T)) {
+    if (ST->getNumElements() == 0)
+      return bugle::Type(bugle::Type::BV, 8);
+
+    ElTy = getRangeType(*ST->element_begin());
+    for (auto i = std::next(ST->element_begin()), e = ST->element_end(); i != e;
+         ++i) {
+      auto ITy = getRangeType(*i);
+      if (ElTy.isKind(bugle::Type::Unknown) || ITy.isKind(bugle::Type::Unknown))
+        return bugle::Type(bugle::Type::Unknown);
+      auto Kind = ElTy.kind == ITy.kind ? ElTy.kind : bugle::Type::BV;
+      ElTy = bugle::Type(Kind, GreatestCommonDivisor64(ElTy.width, ITy.width));
+    }
+  } else if (T->isPointerTy()) {
+    return bugle::Type(T->getPointerElementType()->isFunctionTy()
+                           ? bugle::Type::FunctionPointer
+                           : bugle::Type::Pointer,
+                       TD->getTypeSizeInBits(T));
+  } else {
+    return bugle::Type(bugle::Type::BV, TD->getTypeSizeInBits(T));
+  }
+
+  if (ElTy.isKind(bugle::Type::Unknown))
+    return ElTy;
+
+  // Padding, see TranslateModule::handlePadding.
+  unsigned Padding = TD->getTypeAllocSizeInBits(T) - TD->getTypeSizeInBits(T);
+  if (Padding % ElTy.width == 0)
+    return ElTy;
+  else
+    return bugle::Type(bugle::Type::BV,
+                       GreatestCommonDivisor64(Padding, ElTy.width));
+}
+
+bugle::Type PointerModelAnalysisPass::getArrayRangeType(llvm::Value *V) {
+  if (ByteArrayModels.find(V) != ByteArrayModels.end())
+    return bugle::Type(bugle::Type::BV, 8);
+
+  return getRangeType(V->getType()->getPointerElementType());
+}
+
+// Whether the translator models V as an array of its own.
+bool PointerModelAnalysisPass::isArray(llvm::Value *V) {
+  if (isa<GlobalVariable>(V) || isa<AllocaInst>(V))
+    return true;
+
+  if (auto *Arg = dyn_cast<Argument>(V)) {
+    return Arg->getType()->isPointerTy() &&
+           !Arg->getType()->getPointerElementType()->isFunctionTy() &&
+           TranslateModule::isGPUEntryPoint(Arg->getParent(), M, SL,
+                                            GPUEntryPoints);
+  }
+
+  return false;
+}
+
+bool PointerModelAnalysisPass::isTranslated(llvm::Function &F) {
+  return !F.isIntrinsic() && !F.isDeclaration() &&
+         !TranslateFunction::isSpecialFunction(SL, F.getName());
+}
+
+PointerModelAnalysisPass::Provenance
+PointerModelAnalysisPass::getProvenance(llvm::Value *V) {
+  Provenance P;
+
+  if (isa<ConstantPointerNull>(V)) {
+    P.K = Provenance::Known;
+    P.MayBeNull = true;
+    return P;
+  }
+
+  if (isArray(V)) {
+    P.K = Provenance::Known;
+    P.Arrays.insert(V);
+    P.Direct = P.ConstantOffset = true;
+    return P;
+  }
+
+  if (auto *O = dyn_cast<Operator>(V)) {
+    switch (O->getOpcode()) {
+    case Instruction::BitCast:
+    case Instruction::AddrSpaceCast:
+      if (O->getOperand(0)->getType()->isPointerTy())
+        return getProvenance(O->getOperand(0));
+      break;
+    case Instruction::GetElementPtr:
+      return getGEPProvenance(cast<GEPOperator>(O));
+    default:
+      break;
+    }
+  }
+
+  llvm::Value *Model = nullptr;
+  if (isa<PHINode>(V))
+    Model = V;
+  else if (auto *CI = dyn_cast<CallInst>(V))
+    Model = CI->getCalledFunction();
+
+  auto MI = Models.find(Model);
+  if (Model && MI != Models.end()) {
+    P = MI->second;
+    P.Direct = P.ConstantOffset = false;
+    return P;
+  }
+
+  P.K = Provenance::Unknown;
+  return P;
+}
+
+// Follows TranslateModule::translateGEP.  Each constant index gives a constant
+// term of the offset and each other index gives a term which is a multiple of
+// the element size.
+PointerModelAnalysisPass::Provenance
+PointerModelAnalysisPass::getGEPProvenance(llvm::GEPOperator *GEP) {
+  if (!GEP->getType()->isPointerTy()) {
+    Provenance P;
+    P.K = Provenance::Unknown;
+    return P;
+  }
+
+  Provenance P = getProvenance(GEP->getPointerOperand());
+  if (P.K != Provenance::Known)
+    return P;
+
+  for (auto i = klee::gep_type_begin(GEP), e = klee::gep_type_end(GEP); i != e;
+       ++i) {
+    uint64_t Term;
+    if (auto *ST = dyn_cast<StructType>(*i)) {
+      const StructLayout *SL = TD->getStructLayout(ST);
+      const ConstantInt *CI = cast<ConstantInt>(i.getOperand());
+      Term = SL->getElementOffset((unsigned)CI->getZExtValue());
+    } else {
+      llvm::Type *ElTy = isa<SequentialType>(*i)
+                             ? cast<SequentialType>(*i)->getElementType()
+                             : cast<PointerType>(*i)->getElementType();
+      Term = TD->getTypeAllocSize(ElTy);
+      if (auto *CI = dyn_cast<ConstantInt>(i.getOperand()))
+        Term *= CI->getZExtValue();
+      else
+        P.ConstantOffset = false;
+    }
+
+    if (P.ConstantOffset)
+      P.Offset += Term;
+    if (Term != 0) {
+      uint64_t Align = Term & -Term;
+      if (P.Alignment == 0 || Align < P.Alignment)
+        P.Alignment = Align;
+    }
+  }
+
+  return P;
+}
+
+// Recompute the provenance of each phi node and return value from its
+// incoming values.  Returns true if any provenance changed.
+bool PointerModelAnalysisPass::computeModels() {
+  bool Changed = false;
+
+  for (auto &Model : Models) {
+    Provenance &Old = Model.second;
+    if (Old.K == Provenance::Unknown)
+      continue;
+
+    std::vector<llvm::Value *> Incoming;
+    if (auto *PN = dyn_cast<PHINode>(Model.first)) {
+      for (auto &V : PN->incoming_values())
+        Incoming.push_back(V);
+    } else {
+      for (auto &BB : *cast<llvm::Function>(Model.first))
+        if (auto *RI = dyn_cast<ReturnInst>(BB.getTerminator()))
+          Incoming.push_back(RI->getReturnValue());
+    }
+
+    Provenance New;
+    for (auto *V : Incoming) {
+      Provenance P = getProvenance(V);
+      if (P.K == Provenance::None)
+        continue;
+      if (P.K == Provenance::Unknown) {
+        New.K = Provenance::Unknown;
+        break;
+      }
+
+      New.K = Provenance::Known;
+      New.Arrays.insert(P.Arrays.begin(), P.Arrays.end());
+      New.MayBeNull |= P.MayBeNull;
+      if (New.Alignment == 0 ||
+          (P.Alignment != 0 && P.Alignment < New.Alignment))
+        New.Alignment = P.Alignment;
+    }
+
+    if (New.K != Old.K || New.Arrays != Old.Arrays ||
+        New.MayBeNull != Old.MayBeNull || New.Alignment != Old.Alignment) {
+      Old = New;
+      Changed = true;
+    }
+  }
+
+  return Changed;
+}
+
+// The translator models a value as an offset into its arrays if every offset
+// can be divided exactly by the width of the arrays' range type.  Only values
+// referring to a single array are considered here, which means that models
+// found later by the translator cannot give the array set mixed range types.
+bool PointerModelAnalysisPass::isModelled(Provenance &P) {
+  if (P.K != Provenance::Known || P.Arrays.size() != 1)
+    return false;
+
+  auto RT = getArrayRangeType(*P.Arrays.begin());
+  if (!(RT.isKind(bugle::Type::BV) || RT.isKind(bugle::Type::Pointer)) ||
+      RT.width % 8 != 0)
+    return false;
+
+  uint64_t Div = RT.width / 8;
+  return isPowerOf2_64(Div) && (P.Alignment == 0 || P.Alignment % Div == 0);
+}
+
+// Follows the load and store translation in TranslateFunction: an array is
+// modelled as a byte array if it is accessed at a type which its range type
+// cannot express, or at an offset which is not a multiple of the access size.
+void PointerModelAnalysisPass::computeByteArrayModel(llvm::Value *Ptr,
+                                                     llvm::Type *AccessTy) {
+  Provenance P = getProvenance(Ptr);
+  if (P.K != Provenance::Known || !P.Direct || P.MayBeNull ||
+      P.Arrays.size() != 1 || AccessTy->isAggregateType())
+    return;
+
+  llvm::Value *V = *P.Arrays.begin();
+  auto ArrRangeTy = getRangeType(V->getType()->getPointerElementType());
+  auto AccessElTy = getRangeType(AccessTy);
+  if (ArrRangeTy.isKind(bugle::Type::Unknown) ||
+      AccessElTy.isKind(bugle::Type::Unknown))
+    return;
+  unsigned AccessWidth = TD->getTypeSizeInBits(AccessTy);
+
+  auto IsDivisible = [&](unsigned Width) {
+    uint64_t Div = Width / 8;
+    if (Div == 1)
+      return true;
+    if (!isPowerOf2_64(Div))
+      return false;
+    return !P.ConstantOffset || P.Offset % Div == 0;
+  };
+
+  if (ArrRangeTy.width % 8 != 0 || AccessElTy.width % 8 != 0)
+    return;
+  if (ArrRangeTy == AccessElTy && IsDivisible(AccessElTy.width))
+    return;
+  if (ArrRangeTy.isKind(bugle::Type::BV) &&
+      AccessWidth % ArrRangeTy.width == 0 && IsDivisible(ArrRangeTy.width))
+    return;
+
+  ByteArrayModels.insert(V);
+}
+
+bool PointerModelAnalysisPass::runOnModule(llvm::Module &M) {
+  this->M = &M;
+  TD = &M.getDataLayout();
+
+  for (auto &F : M) {
+    if (!isTranslated(F))
+      continue;
+
+    for (auto &BB : F) {
+      for (auto &I : BB) {
+        if (auto *LI = dyn_cast<LoadInst>(&I))
+          computeByteArrayModel(LI->getPointerOperand(), LI->getType());
+        else if (auto *SI = dyn_cast<StoreInst>(&I))
+          computeByteArrayModel(SI->getPointerOperand(),
+                                SI->getValueOperand()->getType());
+      }
+    }
+  }
+
+  for (auto &F : M) {
+    if (!isTranslated(F))
+      continue;
+
+    auto *RT = F.getReturnType();
+    if (RT->isPointerTy() && !RT->getPointerElementType()->isFunctionTy())
+      Models[&F] = Provenance();
+
+    for (auto &BB : F) {
+      for (auto &I : BB) {
+        auto *T = I.getType();
+        if (isa<PHINode>(I) && T->isPointerTy() &&
+            !T->getPointerElementType()->isFunctionTy())
+          Models[&I] = Provenance();
+      }
+    }
+  }
+
+  // A value whose provenance is known may still not be modelled by the
+  // translator, in which case neither are the values computed from it.
+  bool Demoted;
+  do {
+    while (computeModels())
+      ;
+
+    Demoted = false;
+    for (auto &Model : Models) {
+      if (Model.second.K != Provenance::Unknown && !isModelled(Model.second)) {
+        Model.second = Provenance();
+        Model.second.K = Provenance::Unknown;
+        Demoted = true;
+      }
+    }
+  } while (Demoted);
+
+  for (auto &Model : Models) {
+    if (Model.second.K != Provenance::Known)
+      continue;
+
+    GlobalOffsetModels[Model.first] = Model.second.Arrays;
+    if (Model.second.MayBeNull)
+      MayBeNull.insert(Model.first);
+  }
+
+  return false;
+}
+
+// Once every array is modelled as a byte array, the translator no longer
+// computes models of values, so those predicted can only be checked against
+// the models it computed before.
+bool PointerModelAnalysisPass::checkModels(const TranslateModule &TM,
+                                           llvm::raw_ostream &OS) const {
+  bool AllAsByteArray = TM.modelsAllAsByteArray();
+  bool OK = true;
+  auto Report = [&](const char *Model, llvm::Value *V) {
+    OS << "Pointer model analysis: " << Model << " model of ";
+    V->printAsOperand(OS, /*PrintType=*/false);
+    OS << " is not reached by translation\n";
+    OK = false;
+  };
+
+  if (!AllAsByteArray) {
+    for (auto *V : ByteArrayModels)
+      if (!TM.getByteArrayModels().count(V))
+        Report("byte array", V);
+  }
+
+  auto &GlobalOffsets = TM.getGlobalOffsetModels();
+  for (auto &GO : GlobalOffsetModels) {
+    auto i = GlobalOffsets.find(GO.first);
+    if (i == GlobalOffsets.end() ? !AllAsByteArray : i->second != GO.second)
+      Report("global offset", GO.first);
+  }
+
+  for (auto *V : MayBeNull)
+    if (GlobalOffsets.count(V) && !TM.getMayBeNull().count(V))
+      Report("may be null", V);
+
+  return OK;
+}
+
+char PointerModelAnalysisPass::ID = 0;
@@ -22,6 +22,12 @@ bool isTemporal(Expr *e) {
          isa<AsyncWorkGroupCopyExpr>(e) || isa<BVCtlzExpr>(e);
 }
 
+// Packed vectors are written lane by lane, each lane repeating the vector
+// operands, so an operand is only written once if it is referred to by name.
+bool isPackedVector(Expr *e) {
+  return isa<VectorBinaryExpr>(e) || isa<VectorShuffleExpr>(e);
+}
+
 void ProcessBasicBlock(BasicBlock *BB) {
   OwningPtrVector<Stmt> &V = BB->getStmtVector();
   if (V.empty())
@@ -39,7 +45,7 @@ void ProcessBasicBlock(BasicBlock *BB) {
 
       if ((E->refCount == 1 && !dyn_cast<LoadExpr>(E) &&
            !dyn_cast<AsyncWorkGroupCopyExpr>(E)) ||
-          (!isTemporal(E) && E->refCount <= 2)) {
+          (!isTemporal(E) && !isPackedVector(E) && E->refCount <= 2)) {
         auto ii = i;
         bool begin = false;
         if (i == V.begin())
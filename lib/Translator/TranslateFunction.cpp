@@ -1,5 +1,6 @@
 #include "bugle/Translator/TranslateFunction.h"
 #include "bugle/Translator/TranslateModule.h"
+#include "bugle/Translator/TranslationTrace.h"
 #include "bugle/BPLFunctionWriter.h"
 #include "bugle/BPLModuleWriter.h"
 #include "bugle/BasicBlock.h"
@@ -9,6 +10,7 @@
 #include "bugle/RaceInstrumenter.h"
 #include "bugle/util/ErrorReporter.h"
 #include "bugle/util/Functional.h"
+#include "llvm/Analysis/ValueTracking.h"
 #include "llvm/IR/BasicBlock.h"
 #include "llvm/IR/CallSite.h"
 #include "llvm/IR/CFG.h"
@@ -19,6 +21,8 @@
 #include "llvm/IR/IntrinsicInst.h"
 #include "llvm/IR/Intrinsics.h"
 #include "llvm/IR/Metadata.h"
+#include "llvm/Support/CommandLine.h"
+#include "llvm/Support/KnownBits.h"
 #include "llvm/Support/raw_ostream.h"
 #include <string>
 #include <vector>
@@ -28,6 +32,32 @@ using namespace llvm;
 
 typedef std::vector<ref<Expr>> ExprVec;
 
+static cl::opt<unsigned> MemoryUnrollThreshold(
+    "memory-unroll-threshold", cl::init(64),
+    cl::desc("Write the elements of memset and memcpy calls one by one if "
+             "there are at most this many, and in a loop otherwise"));
+
+// Apply a binary operation to scalars, or lane-wise to vectors.  Vectors are
+// kept packed rather than split into a statement per lane.
+static ref<Expr> createLaneWise(Expr::Kind K, llvm::Type *Ty, ref<Expr> LHS,
+                                ref<Expr> RHS) {
+  if (auto *VT = dyn_cast<VectorType>(Ty))
+    return VectorBinaryExpr::create(K, VT->getNumElements(), LHS, RHS);
+  return VectorBinaryExpr::createLane(K, LHS, RHS);
+}
+
+// Record the low bits which LLVM knows to be zero in the integer value Val,
+// modelled by V, so that exact division of offsets built from V can use them.
+// Phi nodes of induction variables with aligned start and step are included.
+static void addKnownTrailingZeros(Var *V, llvm::Value *Val,
+                                  const llvm::DataLayout &TD) {
+  if (!Val->getType()->isIntegerTy() || !V->getType().isKind(bugle::Type::BV) ||
+      V->getType().width != Val->getType()->getIntegerBitWidth())
+    return;
+  llvm::KnownBits Known = llvm::computeKnownBits(Val, TD);
+  V->setKnownTrailingZeros(Known.countMinTrailingZeros());
+}
+
 TranslateFunction::SpecialFnMapTy
     TranslateFunction::SpecialFunctionMaps[TranslateModule::SL_Count];
 
@@ -565,6 +595,7 @@ void TranslateFunction::translate() {
     } else {
       Var *V = BF->addArgument(TM->getModelledType(&Arg),
                                TranslateModule::getSourceName(&Arg, F));
+      addKnownTrailingZeros(V, &Arg, TM->TD);
       ValueExprMap[&Arg] = TM->unmodelValue(&Arg, VarRefExpr::create(V));
     }
   }
@@ -604,13 +635,14 @@ void TranslateFunction::translate() {
     std::set<llvm::PHINode *> foundPhiNodes;
     foundPhiNodes.insert(Phi.first);
     computeClosure(Phi.second, foundPhiNodes, assigns);
-    TM->computeValueModel(Phi.first, PhiVarMap[Phi.first], assigns);
+    TM->computeValueModel(Phi.first, PhiVarMap[Phi.first], assigns,
+                          PhiAssignCauses[Phi.first]);
   }
 
   // See if we can model the return value. This requires the function to have
   // a body.
   if (!BBList.empty())
-    TM->computeValueModel(F, nullptr, ReturnVals);
+    TM->computeValueModel(F, nullptr, ReturnVals, ReturnCause);
 }
 
 void TranslateFunction::computeClosure(std::vector<PhiPair> &currentAssigns,
@@ -671,6 +703,7 @@ Var *TranslateFunction::getPhiVariable(llvm::PHINode *PN) {
     return V;
 
   V = BF->addLocal(TM->getModelledType(PN), PN->getName());
+  addKnownTrailingZeros(V, PN, TM->TD);
   return V;
 }
 
@@ -689,6 +722,7 @@ void TranslateFunction::addPhiAssigns(bugle::BasicBlock *BBB,
     Exprs.push_back(Val);
     PhiPair pair = std::make_pair(PN.getIncomingValue(idx), Val);
     PhiAssignsMap[&PN].push_back(pair);
+    PhiAssignCauses.insert(std::make_pair(&PN, Pred->getTerminator()));
   }
 
   if (!Vars.empty())
@@ -931,6 +965,7 @@ ref<Expr> TranslateFunction::handleReadsFrom(bugle::BasicBlock *BBB,
                                              llvm::CallInst *CI,
                                              const ExprVec &Args) {
   ref<Expr> arrayIdExpr = ArrayIdExpr::create(Args[0], TM->defaultRange());
+  TM->addInstrumentedArray(arrayIdExpr);
   BF->addModifies(AccessHasOccurredExpr::create(arrayIdExpr, false),
                   extractSourceLocs(CI));
 
@@ -950,6 +985,7 @@ ref<Expr> TranslateFunction::handleWritesTo(bugle::BasicBlock *BBB,
                                             llvm::CallInst *CI,
                                             const ExprVec &Args) {
   ref<Expr> arrayIdExpr = ArrayIdExpr::create(Args[0], TM->defaultRange());
+  TM->addInstrumentedArray(arrayIdExpr);
   BF->addModifies(AccessHasOccurredExpr::create(arrayIdExpr, true),
                   extractSourceLocs(CI));
 
@@ -1036,6 +1072,7 @@ ref<Expr> TranslateFunction::handleReadHasOccurred(bugle::BasicBlock *BBB,
                                                    llvm::CallInst *CI,
                                                    const ExprVec &Args) {
   ref<Expr> arrayIdExpr = ArrayIdExpr::create(Args[0], TM->defaultRange());
+  TM->addInstrumentedArray(arrayIdExpr);
   ref<Expr> result =
       BoolToBVExpr::create(AccessHasOccurredExpr::create(arrayIdExpr, false));
 
@@ -1049,6 +1086,7 @@ ref<Expr> TranslateFunction::handleWriteHasOccurred(bugle::BasicBlock *BBB,
                                                     llvm::CallInst *CI,
                                                     const ExprVec &Args) {
   ref<Expr> arrayIdExpr = ArrayIdExpr::create(Args[0], TM->defaultRange());
+  TM->addInstrumentedArray(arrayIdExpr);
   ref<Expr> result =
       BoolToBVExpr::create(AccessHasOccurredExpr::create(arrayIdExpr, true));
 
@@ -1062,6 +1100,7 @@ ref<Expr> TranslateFunction::handleReadOffset(bugle::BasicBlock *BBB,
                                               llvm::CallInst *CI,
                                               const ExprVec &Args) {
   ref<Expr> arrayIdExpr = ArrayIdExpr::create(Args[0], TM->defaultRange());
+  TM->addInstrumentedArray(arrayIdExpr);
   ref<Expr> result = AccessOffsetExpr::create(
       arrayIdExpr, TM->TD.getPointerSizeInBits(), false);
   Type range = arrayIdExpr->getType().range();
@@ -1092,6 +1131,7 @@ ref<Expr> TranslateFunction::handleWriteOffset(bugle::BasicBlock *BBB,
                                                llvm::CallInst *CI,
                                                const ExprVec &Args) {
   ref<Expr> arrayIdExpr = ArrayIdExpr::create(Args[0], TM->defaultRange());
+  TM->addInstrumentedArray(arrayIdExpr);
   ref<Expr> result = AccessOffsetExpr::create(
       arrayIdExpr, TM->TD.getPointerSizeInBits(), true);
   Type range = arrayIdExpr->getType().range();
@@ -1231,7 +1271,7 @@ ref<Expr> TranslateFunction::handleBarrierInvariant(bugle::BasicBlock *BBB,
     std::string S = F->getName().str();
     llvm::raw_string_ostream SS(S);
     SS << (CI->getNumArgOperands() - 1);
-    BF = TM->BM->addFunction(SS.str(), TM->getSourceFunctionName(F));
+    BF = TM->addHelperFunction(SS.str(), TM->getSourceFunctionName(F));
 
     for (size_t i = 0; i < Args.size(); ++i) {
       std::string S;
@@ -1266,7 +1306,7 @@ TranslateFunction::handleBarrierInvariantBinary(bugle::BasicBlock *BBB,
     std::string S = F->getName().str();
     llvm::raw_string_ostream SS(S);
     SS << ((CI->getNumArgOperands() - 1) / 2);
-    BF = TM->BM->addFunction(SS.str(), TM->getSourceFunctionName(F));
+    BF = TM->addHelperFunction(SS.str(), TM->getSourceFunctionName(F));
 
     for (size_t i = 0; i < Args.size(); ++i) {
       std::string S;
@@ -1289,19 +1329,81 @@ TranslateFunction::handleBarrierInvariantBinary(bugle::BasicBlock *BBB,
   return nullptr;
 }
 
+// Writes the elements [0, Count) of a bulk memory operation, one by one if
+// there are few enough of them, and otherwise in a loop, after which the
+// translation continues.  The loop invariant only bounds the index, so the
+// caller states the contents of the elements written in the exit block of the
+// loop, which is returned, or null if the writes were unrolled.
+bugle::BasicBlock *TranslateFunction::addElementWrites(
+    bugle::BasicBlock *BBB, ref<Expr> Count,
+    const std::function<void(bugle::BasicBlock *, ref<Expr>)> &WriteElement) {
+  unsigned Width = Count->getType().width;
+  if (auto *CE = dyn_cast<BVConstExpr>(Count)) {
+    uint64_t NumElements = CE->getValue().getZExtValue();
+    if (NumElements <= MemoryUnrollThreshold) {
+      for (uint64_t i = 0; i != NumElements; ++i)
+        WriteElement(BBB, BVConstExpr::create(Width, i));
+      return nullptr;
+    }
+  }
+
+  Var *Index = BF->addLocal(Type(Type::BV, Width), "memidx");
+  ref<Expr> IndexRef = VarRefExpr::create(Index);
+  BBB->addStmt(VarAssignStmt::create(Index, BVConstExpr::createZero(Width)));
+
+  bugle::BasicBlock *HeadBB = BF->addBasicBlockAfter(BBB, "memloop");
+  bugle::BasicBlock *BodyBB = BF->addBasicBlockAfter(HeadBB, "memloopbody");
+  bugle::BasicBlock *ExitBB = BF->addBasicBlockAfter(BodyBB, "memloopexit");
+  BBB->addStmt(GotoStmt::create(HeadBB));
+
+  ref<Expr> Cond = BVUltExpr::create(IndexRef, Count);
+  HeadBB->addStmt(AssertStmt::createInvariant(
+      BVUleExpr::create(IndexRef, Count), /*global=*/false,
+      /*candidate=*/false, currentSourceLocs));
+  HeadBB->addEvalStmt(Cond, currentSourceLocs);
+  std::vector<bugle::BasicBlock *> BBs;
+  BBs.push_back(BodyBB);
+  BBs.push_back(ExitBB);
+  HeadBB->addStmt(GotoStmt::create(BBs));
+
+  BodyBB->addStmt(AssumeStmt::createPartition(Cond));
+  BodyBB->addStmt(AssertStmt::createBlockSourceLoc(currentSourceLocs));
+  {
+    // The body does not dominate the exit block, in which the translation
+    // continues, so the expressions it evaluates may not be shared with it.
+    ExprUniqueTable BodyExprs;
+    ExprUniqueTable::Scope UniqueScope(TM->uniqueExprs() ? &BodyExprs
+                                                         : nullptr);
+    WriteElement(BodyBB, IndexRef);
+    BodyBB->addStmt(VarAssignStmt::create(
+        Index, BVAddExpr::create(IndexRef, BVConstExpr::create(Width, 1))));
+  }
+  BodyBB->addStmt(GotoStmt::create(HeadBB));
+
+  ExitBB->addStmt(AssumeStmt::createPartition(NotExpr::create(Cond)));
+  ExitBB->addStmt(AssertStmt::createBlockSourceLoc(currentSourceLocs));
+  NextBBB = ExitBB;
+  return ExitBB;
+}
+
+// The number of elements of the given width in Length bytes, at the width of
+// Offset, or null if Length is not known to be a multiple of the width.
+static ref<Expr> getElementCount(ref<Expr> Length, ref<Expr> Offset,
+                                 unsigned ElemWidth) {
+  unsigned Width = Offset->getType().width;
+  if (Length->getType().width < Width)
+    Length = BVZExtExpr::create(Width, Length);
+  else if (Length->getType().width > Width)
+    Length = BVExtractExpr::create(Length, 0, Width);
+  return Expr::createExactBVSDiv(Length, ElemWidth / 8);
+}
+
 ref<Expr> TranslateFunction::handleMemset(bugle::BasicBlock *BBB,
                                           llvm::CallInst *CI,
                                           const ExprVec &Args) {
   // Args[0] == cast<MemSetInst>(CI)->getDest()
   // Args[1] == cast<MemSetInst>(CI)->getValue()
   // Args[2] == cast<MemSetInst>(CI)->getLength()
-  auto Length = dyn_cast<BVConstExpr>(Args[2]);
-  if (!Length) {
-    // Could emit a loop
-    ErrorReporter::reportImplementationLimitation(
-        "memset with non-integer constant length not supported");
-  }
-
   auto Value = dyn_cast<BVConstExpr>(Args[1]);
   if (!Value) {
     // Could deal with expr
@@ -1312,7 +1414,6 @@ ref<Expr> TranslateFunction::handleMemset(bugle::BasicBlock *BBB,
   ref<Expr> Dst = Args[0],
             DstPtrArr = ArrayIdExpr::create(Dst, TM->defaultRange()),
             DstPtrOfs = ArrayOffsetExpr::create(Dst);
-  unsigned Len = Length->getValue().getZExtValue();
   unsigned Val = Value->getValue().getZExtValue();
   Type DstRangeTy = DstPtrArr->getType().range();
 
@@ -1324,22 +1425,29 @@ ref<Expr> TranslateFunction::handleMemset(bugle::BasicBlock *BBB,
   assert(DstRangeTy.width % 8 == 0);
   assert(DstRangeTy == Type(Type::Unknown) || DstRangeTy.width != 0);
   ref<Expr> DstDiv = Expr::createExactBVSDiv(DstPtrOfs, DstRangeTy.width / 8);
-  // Handle when Len can be rewritten as an integral number of element writes
-  // Special case if Val is 0
-  if (DstRangeTy != Type(Type::Unknown) && !DstDiv.isNull() &&
-      (Len % (DstRangeTy.width / 8) == 0) &&
-      (Val == 0 || DstRangeTy.width == 8)) {
-    unsigned NumElements = Len / (DstRangeTy.width / 8);
-    for (unsigned i = 0; i != NumElements; ++i) {
+  ref<Expr> NumElements;
+  if (DstRangeTy != Type(Type::Unknown) && !DstDiv.isNull())
+    NumElements = getElementCount(Args[2], DstDiv, DstRangeTy.width);
+  // Handle when the length can be rewritten as an integral number of element
+  // writes. Special case if Val is 0
+  if (!NumElements.isNull() && (Val == 0 || DstRangeTy.width == 8)) {
+    auto CreateValExpr = [&]() {
       ref<Expr> ValExpr = BVConstExpr::create(DstRangeTy.width, Val);
       if (DstRangeTy.isKind(Type::Pointer))
         ValExpr = SafeBVToPtrExpr::create(ValExpr->getType().width, ValExpr);
-      ref<Expr> StoreOfs = BVAddExpr::create(
-          DstDiv, BVConstExpr::create(Dst->getType().width, i));
-      BBB->addEvalStmt(ValExpr, currentSourceLocs);
-      BBB->addStmt(
+      return ValExpr;
+    };
+    auto *ExitBB = addElementWrites(BBB, NumElements, [&](bugle::BasicBlock *BB,
+                                                          ref<Expr> Index) {
+      ref<Expr> ValExpr = CreateValExpr();
+      ref<Expr> StoreOfs = BVAddExpr::create(DstDiv, Index);
+      BB->addEvalStmt(ValExpr, currentSourceLocs);
+      BB->addStmt(
           StoreStmt::create(DstPtrArr, StoreOfs, ValExpr, currentSourceLocs));
-    }
+    });
+    if (ExitBB)
+      ExitBB->addStmt(AssumeElementsStmt::createFill(
+          DstPtrArr, DstDiv, NumElements, CreateValExpr()));
   } else {
     TM->NeedAdditionalByteArrayModels = true;
     std::set<GlobalArray *> Globals;
@@ -1362,19 +1470,11 @@ ref<Expr> TranslateFunction::handleMemcpy(bugle::BasicBlock *BBB,
   // Args[0] == cast<MemCpyInst>(CI)->getDest()
   // Args[1] == cast<MemCpyInst>(CI)->getSource()
   // Args[2] == cast<MemCpyInst>(CI)->getLength()
-  auto Length = dyn_cast<BVConstExpr>(Args[2]);
-  if (!Length) {
-    // Could emit a loop
-    ErrorReporter::reportImplementationLimitation(
-        "memcpy with non-integer constant length not supported");
-  }
-
   ref<Expr> Src = Args[1], Dst = Args[0],
             SrcPtrArr = ArrayIdExpr::create(Src, TM->defaultRange()),
             DstPtrArr = ArrayIdExpr::create(Dst, TM->defaultRange()),
             SrcPtrOfs = ArrayOffsetExpr::create(Src),
             DstPtrOfs = ArrayOffsetExpr::create(Dst);
-  unsigned Len = Length->getValue().getZExtValue();
   Type SrcRangeTy = SrcPtrArr->getType().range(),
        DstRangeTy = DstPtrArr->getType().range();
 
@@ -1393,23 +1493,26 @@ ref<Expr> TranslateFunction::handleMemcpy(bugle::BasicBlock *BBB,
   assert(SrcRangeTy == Type(Type::Unknown) || SrcRangeTy.width != 0);
   ref<Expr> SrcDiv = Expr::createExactBVSDiv(SrcPtrOfs, SrcRangeTy.width / 8);
   ref<Expr> DstDiv = Expr::createExactBVSDiv(DstPtrOfs, DstRangeTy.width / 8);
-  // Handle matching source and destination range types where Len can be
-  // rewritten as an integral number of element read/writes
+  ref<Expr> NumElements;
   if (SrcRangeTy == DstRangeTy && SrcRangeTy != Type(Type::Unknown) &&
-      !SrcDiv.isNull() && !DstDiv.isNull() &&
-      (Len % (SrcRangeTy.width / 8) == 0)) {
-    unsigned NumElements = Len / (SrcRangeTy.width / 8);
-    for (unsigned i = 0; i != NumElements; ++i) {
-      ref<Expr> LoadOfs = BVAddExpr::create(
-          SrcDiv, BVConstExpr::create(Src->getType().width, i));
+      !SrcDiv.isNull() && !DstDiv.isNull())
+    NumElements = getElementCount(Args[2], DstDiv, SrcRangeTy.width);
+  // Handle matching source and destination range types where the length can
+  // be rewritten as an integral number of element read/writes
+  if (!NumElements.isNull()) {
+    auto *ExitBB = addElementWrites(BBB, NumElements, [&](bugle::BasicBlock *BB,
+                                                          ref<Expr> Index) {
+      ref<Expr> LoadOfs = BVAddExpr::create(SrcDiv, Index);
       ref<Expr> Val =
           LoadExpr::create(SrcPtrArr, LoadOfs, SrcRangeTy, LoadsAreTemporal);
-      ref<Expr> StoreOfs = BVAddExpr::create(
-          DstDiv, BVConstExpr::create(Dst->getType().width, i));
-      BBB->addEvalStmt(Val, currentSourceLocs);
-      BBB->addStmt(
+      ref<Expr> StoreOfs = BVAddExpr::create(DstDiv, Index);
+      BB->addEvalStmt(Val, currentSourceLocs);
+      BB->addStmt(
           StoreStmt::create(DstPtrArr, StoreOfs, Val, currentSourceLocs));
-    }
+    });
+    if (ExitBB)
+      ExitBB->addStmt(AssumeElementsStmt::createCopy(
+          DstPtrArr, DstDiv, NumElements, SrcPtrArr, SrcDiv));
   } else {
     TM->NeedAdditionalByteArrayModels = true;
     std::set<GlobalArray *> Globals;
@@ -1534,7 +1637,7 @@ ref<Expr> TranslateFunction::handleSamplerInitializer(bugle::BasicBlock *BBB,
   GlobalArray *GA = TM->getGlobalArray(CI);
 
   if (auto *C = dyn_cast<Constant>(CI->getArgOperand(0))) {
-    TM->translateGlobalInit(GA, 0, C);
+    TM->translateArrayInit(CI, C);
   } else {
     ErrorReporter::reportImplementationLimitation(
         "Non-constant samplers not supported");
@@ -1734,16 +1837,14 @@ ref<Expr> TranslateFunction::handleFmax(bugle::BasicBlock *BBB,
                                         llvm::CallInst *CI,
                                         const ExprVec &Args) {
   llvm::Type *Ty = CI->getType();
-  return maybeTranslateSIMDInst(BBB, Ty, Ty, Args[0], Args[1],
-                                FMaxExpr::create);
+  return createLaneWise(Expr::FMax, Ty, Args[0], Args[1]);
 }
 
 ref<Expr> TranslateFunction::handleFmin(bugle::BasicBlock *BBB,
                                         llvm::CallInst *CI,
                                         const ExprVec &Args) {
   llvm::Type *Ty = CI->getType();
-  return maybeTranslateSIMDInst(BBB, Ty, Ty, Args[0], Args[1],
-                                FMinExpr::create);
+  return createLaneWise(Expr::FMin, Ty, Args[0], Args[1]);
 }
 
 ref<Expr> TranslateFunction::handleFloor(bugle::BasicBlock *BBB,
@@ -1759,9 +1860,12 @@ ref<Expr> TranslateFunction::handleFma(bugle::BasicBlock *BBB,
                                        llvm::CallInst *CI,
                                        const ExprVec &Args) {
   llvm::Type *Ty = CI->getType();
-  ref<Expr> M =
-      maybeTranslateSIMDInst(BBB, Ty, Ty, Args[0], Args[1], FMulExpr::create);
-  return maybeTranslateSIMDInst(BBB, Ty, Ty, M, Args[2], FAddExpr::create);
+  ref<Expr> M = createLaneWise(Expr::FMul, Ty, Args[0], Args[1]);
+  // Each lane of the packed sum refers to the product, which is therefore
+  // named rather than written once per lane.
+  if (isa<VectorType>(Ty))
+    BBB->addEvalStmt(M, currentSourceLocs);
+  return createLaneWise(Expr::FAdd, Ty, M, Args[2]);
 }
 
 ref<Expr> TranslateFunction::handleFrexpExp(bugle::BasicBlock *BBB,
@@ -1809,9 +1913,7 @@ ref<Expr> TranslateFunction::handlePow(bugle::BasicBlock *BBB,
                                        llvm::CallInst *CI,
                                        const ExprVec &Args) {
   llvm::Type *Ty = CI->getType();
-  return maybeTranslateSIMDInst(
-      BBB, Ty, Ty, Args[0], Args[1],
-      [&](ref<Expr> LHS, ref<Expr> RHS) { return FPowExpr::create(LHS, RHS); });
+  return createLaneWise(Expr::FPow, Ty, Args[0], Args[1]);
 }
 
 ref<Expr> TranslateFunction::handlePowi(bugle::BasicBlock *BBB,
@@ -2112,31 +2214,31 @@ void TranslateFunction::translateInstruction(bugle::BasicBlock *BBB,
   if (auto *BO = dyn_cast<BinaryOperator>(I)) {
     ref<Expr> LHS = translateValue(BO->getOperand(0), BBB),
               RHS = translateValue(BO->getOperand(1), BBB);
-    ref<Expr>(*F)(ref<Expr>, ref<Expr>);
+    Expr::Kind K;
     switch (BO->getOpcode()) {
-    case BinaryOperator::Add:  F = BVAddExpr::create;  break;
-    case BinaryOperator::FAdd: F = FAddExpr::create;   break;
-    case BinaryOperator::Sub:  F = BVSubExpr::create;  break;
-    case BinaryOperator::FSub: F = FSubExpr::create;   break;
-    case BinaryOperator::Mul:  F = BVMulExpr::create;  break;
-    case BinaryOperator::FMul: F = FMulExpr::create;   break;
-    case BinaryOperator::SDiv: F = BVSDivExpr::create; break;
-    case BinaryOperator::UDiv: F = BVUDivExpr::create; break;
-    case BinaryOperator::FDiv: F = FDivExpr::create;   break;
-    case BinaryOperator::SRem: F = BVSRemExpr::create; break;
-    case BinaryOperator::URem: F = BVURemExpr::create; break;
-    case BinaryOperator::FRem: F = FRemExpr::create;   break;
-    case BinaryOperator::Shl:  F = BVShlExpr::create;  break;
-    case BinaryOperator::AShr: F = BVAShrExpr::create; break;
-    case BinaryOperator::LShr: F = BVLShrExpr::create; break;
-    case BinaryOperator::And:  F = BVAndExpr::create;  break;
-    case BinaryOperator::Or:   F = BVOrExpr::create;   break;
-    case BinaryOperator::Xor:  F = BVXorExpr::create;  break;
+    case BinaryOperator::Add:  K = Expr::BVAdd;  break;
+    case BinaryOperator::FAdd: K = Expr::FAdd;   break;
+    case BinaryOperator::Sub:  K = Expr::BVSub;  break;
+    case BinaryOperator::FSub: K = Expr::FSub;   break;
+    case BinaryOperator::Mul:  K = Expr::BVMul;  break;
+    case BinaryOperator::FMul: K = Expr::FMul;   break;
+    case BinaryOperator::SDiv: K = Expr::BVSDiv; break;
+    case BinaryOperator::UDiv: K = Expr::BVUDiv; break;
+    case BinaryOperator::FDiv: K = Expr::FDiv;   break;
+    case BinaryOperator::SRem: K = Expr::BVSRem; break;
+    case BinaryOperator::URem: K = Expr::BVURem; break;
+    case BinaryOperator::FRem: K = Expr::FRem;   break;
+    case BinaryOperator::Shl:  K = Expr::BVShl;  break;
+    case BinaryOperator::AShr: K = Expr::BVAShr; break;
+    case BinaryOperator::LShr: K = Expr::BVLShr; break;
+    case BinaryOperator::And:  K = Expr::BVAnd;  break;
+    case BinaryOperator::Or:   K = Expr::BVOr;   break;
+    case BinaryOperator::Xor:  K = Expr::BVXor;  break;
     default:
       ErrorReporter::reportImplementationLimitation(
           "Unsupported binary operator");
     }
-    E = maybeTranslateSIMDInst(BBB, BO->getType(), BO->getType(), LHS, RHS, F);
+    E = createLaneWise(K, BO->getType(), LHS, RHS);
   } else if (auto *GEPI = dyn_cast<GetElementPtrInst>(I)) {
     ref<Expr> Ptr = translateValue(GEPI->getPointerOperand(), BBB);
     E = TM->translateGEP(Ptr, klee::gep_type_begin(GEPI),
@@ -2419,7 +2521,7 @@ void TranslateFunction::translateInstruction(bugle::BasicBlock *BBB,
     if (auto *VT = dyn_cast<VectorType>(SI->getCondition()->getType())) {
       unsigned elementBitWidth =
           TrueVal->getType().width / VT->getNumElements();
-      E = nullptr;
+      ExprVec Elems;
       for (unsigned i = 0; i < VT->getNumElements(); ++i) {
         ref<Expr> Ite = IfThenElseExpr::create(
             BVToBoolExpr::create(BVExtractExpr::create(Cond, i, 1)),
@@ -2427,8 +2529,9 @@ void TranslateFunction::translateInstruction(bugle::BasicBlock *BBB,
                                   elementBitWidth),
             BVExtractExpr::create(FalseVal, i * elementBitWidth,
                                   elementBitWidth));
-        E = (i == 0) ? Ite : BVConcatExpr::create(Ite, E);
+        Elems.push_back(Ite);
       }
+      E = Expr::createBVConcatN(Elems);
     } else {
       Cond = BVToBoolExpr::create(Cond);
       E = IfThenElseExpr::create(Cond, TrueVal, FalseVal);
@@ -2455,37 +2558,21 @@ void TranslateFunction::translateInstruction(bugle::BasicBlock *BBB,
     unsigned ElemCount = IEI->getType()->getNumElements();
     BVConstExpr *CEIdx = cast<BVConstExpr>(Idx);
     unsigned UIdx = CEIdx->getValue().getZExtValue();
-    ExprVec Elems;
-    for (unsigned i = 0; i != ElemCount; ++i) {
-      Elems.push_back(i == UIdx ? NewElt : BVExtractExpr::create(
-                                               Vec, EltBits * i, EltBits));
-    }
-    E = Expr::createBVConcatN(Elems);
+    // The new element is the single lane following those of the vector.
+    std::vector<int> Mask;
+    for (unsigned i = 0; i != ElemCount; ++i)
+      Mask.push_back(i == UIdx ? ElemCount : i);
+    E = VectorShuffleExpr::create(Vec, NewElt, EltBits, Mask);
   } else if (auto *SVI = dyn_cast<ShuffleVectorInst>(I)) {
     ref<Expr> Vec1 = translateValue(SVI->getOperand(0), BBB),
               Vec2 = translateValue(SVI->getOperand(1), BBB);
     unsigned EltBits =
         TM->TD.getTypeSizeInBits(SVI->getType()->getElementType());
-    unsigned VecElemCount =
-        cast<VectorType>(SVI->getOperand(0)->getType())->getNumElements();
     unsigned ResElemCount = SVI->getType()->getNumElements();
-    ExprVec Elems;
-    for (unsigned i = 0; i != ResElemCount; ++i) {
-      ref<Expr> L;
-      int MaskValI = SVI->getMaskValue(i);
-      if (MaskValI < 0)
-        L = BVConstExpr::create(EltBits, 0);
-      else {
-        unsigned MaskVal = (unsigned)MaskValI;
-        if (MaskVal < VecElemCount)
-          L = BVExtractExpr::create(Vec1, EltBits * MaskVal, EltBits);
-        else
-          L = BVExtractExpr::create(Vec2, EltBits * (MaskVal - VecElemCount),
-                                    EltBits);
-      }
-      Elems.push_back(L);
-    }
-    E = Expr::createBVConcatN(Elems);
+    std::vector<int> Mask;
+    for (unsigned i = 0; i != ResElemCount; ++i)
+      Mask.push_back(SVI->getMaskValue(i));
+    E = VectorShuffleExpr::create(Vec1, Vec2, EltBits, Mask);
   } else if (auto *CI = dyn_cast<CallInst>(I)) {
     CallSite CS(CI);
     ExprVec Args;
@@ -2520,13 +2607,14 @@ void TranslateFunction::translateInstruction(bugle::BasicBlock *BBB,
       } else {
         if (CI->getType()->isVoidTy()) {
           auto *V = CI->getCalledValue();
-          BBB->addStmt(TM->modelCallStmt(V->getType(), CI->getCalledFunction(),
+          BBB->addStmt(TM->modelCallStmt(CI, V->getType(),
+                                         CI->getCalledFunction(),
                                          translateValue(V, BBB), Args,
                                          currentSourceLocs));
           return;
         } else {
           auto *V = CI->getCalledValue();
-          E = TM->modelCallExpr(V->getType(), CI->getCalledFunction(),
+          E = TM->modelCallExpr(CI, V->getType(), CI->getCalledFunction(),
                                 translateValue(V, BBB), Args);
           BBB->addEvalStmt(E, currentSourceLocs);
           ValueExprMap[I] = TM->unmodelValue(F, E);
@@ -2540,6 +2628,8 @@ void TranslateFunction::translateInstruction(bugle::BasicBlock *BBB,
       ref<Expr> Val = TM->modelValue(F, translateValue(V, BBB));
       BBB->addStmt(VarAssignStmt::create(ReturnVar, Val));
       ReturnVals.push_back(Val);
+      if (!ReturnCause)
+        ReturnCause = RI;
     }
     BBB->addStmt(ReturnStmt::create());
     return;
@@ -2617,8 +2707,39 @@ void TranslateFunction::translateInstruction(bugle::BasicBlock *BBB,
   return;
 }
 
+// Translate the instruction with the model flags cleared, so that the trace
+// can attribute each flag set to the instruction that set it.
+void TranslateFunction::translateTracedInstruction(bugle::BasicBlock *BBB,
+                                                   llvm::Instruction *I) {
+  bool ByteArrayModels = TM->NeedAdditionalByteArrayModels,
+       AllAsByteArray = TM->NextModelAllAsByteArray;
+  TM->NeedAdditionalByteArrayModels = false;
+  TM->NextModelAllAsByteArray = false;
+
+  translateInstruction(BBB, I);
+
+  if (TM->NeedAdditionalByteArrayModels)
+    TM->traceByteArrayModels(I);
+  if (TM->NextModelAllAsByteArray)
+    TM->traceEvent(TranslationTrace::AllAsByteArray, nullptr, I);
+  TM->NeedAdditionalByteArrayModels |= ByteArrayModels;
+  TM->NextModelAllAsByteArray |= AllAsByteArray;
+}
+
 void TranslateFunction::translateBasicBlock(bugle::BasicBlock *BBB,
                                             llvm::BasicBlock *BB) {
-  for (auto &I : *BB)
-    translateInstruction(BBB, &I);
+  // Expressions are only shared within a basic block, where an expression
+  // evaluated earlier dominates every later use of the same node.
+  ExprUniqueTable BlockExprs;
+  ExprUniqueTable::Scope UniqueScope(TM->uniqueExprs() ? &BlockExprs : nullptr);
+  for (auto &I : *BB) {
+    if (TM->Trace)
+      translateTracedInstruction(BBB, &I);
+    else
+      translateInstruction(BBB, &I);
+    if (NextBBB) {
+      BBB = NextBBB;
+      NextBBB = nullptr;
+    }
+  }
 }
@@ -1,11 +1,15 @@
 #include "bugle/Translator/TranslateModule.h"
 #include "bugle/Translator/TranslateFunction.h"
+#include "bugle/Translator/TranslationTrace.h"
+#include "bugle/AffineForm.h"
 #include "bugle/Expr.h"
 #include "bugle/Function.h"
 #include "bugle/Module.h"
 #include "bugle/Stmt.h"
+#include "bugle/StringTable.h"
 #include "bugle/util/ErrorReporter.h"
 #include "llvm/BinaryFormat/Dwarf.h"
+#include "llvm/ADT/Statistic.h"
 #include "llvm/IR/Constant.h"
 #include "llvm/IR/Constants.h"
 #include "llvm/IR/DerivedTypes.h"
@@ -17,11 +21,41 @@
 using namespace llvm;
 using namespace bugle;
 
+#define DEBUG_TYPE "bugle-translate"
+
+STATISTIC(NumModelRounds, "Number of pointer model rounds");
+STATISTIC(NumAllAsByteArrayEscalations,
+          "Number of escalations to modelling all arrays as byte arrays");
+STATISTIC(NumByteArrayEscalations,
+          "Number of escalations to modelling each array as a byte array");
+STATISTIC(NumEscalatedByteArrays,
+          "Number of arrays modelled as byte arrays by escalation");
+
 static cl::opt<bool> ModelBVAsByteArray(
     "model-bv-as-byte-array", cl::Hidden, cl::init(false),
     cl::desc("Model each array composed of bit vector elements as an array of "
              "bit vectors of size 8"));
 
+static cl::opt<bool> IncrementalModelRounds(
+    "incremental-model-rounds", cl::init(false),
+    cl::desc("Only re-translate functions affected by model changes when "
+             "computing the pointer model fixed point"));
+
+static cl::opt<bool> UniqueExprs(
+    "unique-exprs", cl::init(false),
+    cl::desc("Share a single node between structurally equal expressions "
+             "without side effects"));
+
+static cl::opt<unsigned> MaxModelRounds(
+    "max-model-rounds", cl::init(0),
+    cl::desc("Maximum number of pointer model rounds, after which all arrays "
+             "are modelled as byte arrays (0 for no limit)"));
+
+static cl::opt<unsigned> EarlyModelEscalation(
+    "early-model-escalation", cl::init(0),
+    cl::desc("Escalate to byte array models when this is predicted to save "
+             "at least this many pointer model rounds (0 to disable)"));
+
 static unsigned gcd(unsigned a, unsigned b) {
   return b == 0 ? a : gcd(b, a % b);
 }
@@ -38,14 +72,54 @@ TranslateModule::AddressSpaceMap::AddressSpaceMap(unsigned Global,
 
 ref<Expr> TranslateModule::translateConstant(Constant *C) {
   ref<Expr> &E = ConstantMap[C];
-  if (E.isNull())
-    E = doTranslateConstant(C);
+  if (E.isNull()) {
+    // Constants are cached across basic blocks and functions, so they are
+    // uniqued in a table of their own.
+    ExprUniqueTable::Scope UniqueScope(UniqueExprs ? &ConstantExprs : nullptr);
+    if (IncrementalModelRounds) {
+      auto *OuterDeps = CurrentDeps;
+      CurrentDeps = &ConstantDeps[C];
+      E = doTranslateConstant(C);
+      CurrentDeps = OuterDeps;
+    } else {
+      E = doTranslateConstant(C);
+    }
+  }
+  if (CurrentDeps) {
+    mergeModelDependencies(ConstantDeps[C]);
+    if (!isRoundInvariant(C))
+      CurrentDeps->Constants.insert(C);
+  }
   E->preventEvalStmt = true;
   return E;
 }
 
+bool TranslateModule::uniqueExprs() { return UniqueExprs; }
+
+// Whether the translation of C is the same in every round of the fixed point.
+// This is the case unless C refers to a global value, whose array or function
+// belongs to the module of a single round, or is a pointer expression, whose
+// translation may depend on the pointer models.
+bool TranslateModule::isRoundInvariant(Constant *C) {
+  auto CI = RoundInvariantConstants.find(C);
+  if (CI != RoundInvariantConstants.end())
+    return CI->second;
+
+  bool Invariant = !isa<GlobalValue>(C) &&
+                   !(isa<ConstantExpr>(C) && C->getType()->isPointerTy());
+  for (auto i = C->op_begin(), e = C->op_end(); Invariant && i != e; ++i) {
+    auto *Op = dyn_cast<Constant>(*i);
+    Invariant = Op && isRoundInvariant(Op);
+  }
+
+  RoundInvariantConstants[C] = Invariant;
+  return Invariant;
+}
+
 void TranslateModule::translateGlobalInit(GlobalArray *GA, unsigned ByteOffset,
                                           Constant *Init) {
+  Type GATy = GA->getRangeType();
+  unsigned GAByteWidth = GATy.width / 8;
   if (auto *CS = dyn_cast<ConstantStruct>(Init)) {
     auto *SL = TD.getStructLayout(CS->getType());
     for (unsigned i = 0; i < CS->getNumOperands(); ++i)
@@ -55,11 +129,28 @@ void TranslateModule::translateGlobalInit(GlobalArray *GA, unsigned ByteOffset,
     uint64_t ElemSize = TD.getTypeAllocSize(CA->getType()->getElementType());
     for (unsigned i = 0; i < CA->getNumOperands(); ++i)
       translateGlobalInit(GA, ByteOffset + i * ElemSize, CA->getOperand(i));
+  } else if (isa<ConstantAggregateZero>(Init) && GATy.isKind(Type::BV) &&
+             ByteOffset % GAByteWidth == 0 &&
+             TD.getTypeSizeInBits(Init->getType()) / 8 % GAByteWidth == 0) {
+    // Zeroed aggregates, which are often large, are initialised as a single
+    // range rather than element by element.
+    BM->addGlobalInit(GA, ByteOffset / GAByteWidth,
+                      BVConstExpr::createZero(GATy.width),
+                      TD.getTypeSizeInBits(Init->getType()) / 8 / GAByteWidth);
+  } else if (isa<ConstantDataSequential>(Init) && GATy.isKind(Type::BV) &&
+             cast<ConstantDataSequential>(Init)->getElementByteSize() %
+                     GAByteWidth ==
+                 0) {
+    // The elements of data arrays, such as lookup tables, are initialised one
+    // by one rather than extracted from the concatenation of all of them.
+    auto *CDS = cast<ConstantDataSequential>(Init);
+    unsigned ElemSize = CDS->getElementByteSize();
+    for (unsigned i = 0; i != CDS->getNumElements(); ++i)
+      translateGlobalInit(GA, ByteOffset + i * ElemSize,
+                          CDS->getElementAsConstant(i));
   } else {
     ref<Expr> Const = translateConstant(Init);
     unsigned InitByteWidth = Const->getType().width / 8;
-    Type GATy = GA->getRangeType();
-    unsigned GAByteWidth = GATy.width / 8;
     if (GATy == Const->getType() && ByteOffset % InitByteWidth == 0) {
       BM->addGlobalInit(GA, ByteOffset / InitByteWidth, Const);
     } else if (GATy.isKind(Type::BV) && ByteOffset % GAByteWidth == 0 &&
@@ -385,7 +476,19 @@ ref<Expr> TranslateModule::doTranslateConstant(Constant *C) {
   ErrorReporter::reportImplementationLimitation("Unhandled constant");
 }
 
+// Types are translated once per module, as the translation does not depend
+// on the pointer models.
 bugle::Type TranslateModule::translateType(llvm::Type *T) {
+  auto TI = TypeMap.find(T);
+  if (TI != TypeMap.end())
+    return TI->second;
+
+  Type Ty = doTranslateType(T);
+  TypeMap.insert(std::make_pair(T, Ty));
+  return Ty;
+}
+
+bugle::Type TranslateModule::doTranslateType(llvm::Type *T) {
   if (!T->isSized()) {
     if (SL == SL_OpenCL && T == M->getTypeByName("opencl.sampler_t"))
       return Type(Type::BV, 32);
@@ -411,6 +514,16 @@ bugle::Type TranslateModule::handlePadding(bugle::Type ElTy, llvm::Type *T) {
 }
 
 bugle::Type TranslateModule::translateArrayRangeType(llvm::Type *T) {
+  auto TI = ArrayRangeTypeMap.find(T);
+  if (TI != ArrayRangeTypeMap.end())
+    return TI->second;
+
+  Type Ty = doTranslateArrayRangeType(T);
+  ArrayRangeTypeMap.insert(std::make_pair(T, Ty));
+  return Ty;
+}
+
+bugle::Type TranslateModule::doTranslateArrayRangeType(llvm::Type *T) {
   if (auto *AT = dyn_cast<ArrayType>(T))
     return handlePadding(translateArrayRangeType(AT->getElementType()), T);
   if (auto *VT = dyn_cast<VectorType>(T))
@@ -450,6 +563,16 @@ bugle::Type TranslateModule::translateSourceType(llvm::Type *T) {
 }
 
 bugle::Type TranslateModule::translateSourceArrayRangeType(llvm::Type *T) {
+  auto TI = SourceArrayRangeTypeMap.find(T);
+  if (TI != SourceArrayRangeTypeMap.end())
+    return TI->second;
+
+  Type Ty = doTranslateSourceArrayRangeType(T);
+  SourceArrayRangeTypeMap.insert(std::make_pair(T, Ty));
+  return Ty;
+}
+
+bugle::Type TranslateModule::doTranslateSourceArrayRangeType(llvm::Type *T) {
   if (auto *AT = dyn_cast<ArrayType>(T))
     return translateSourceArrayRangeType(AT->getElementType());
 
@@ -471,9 +594,27 @@ bugle::GlobalArray *TranslateModule::getGlobalArray(llvm::Value *V,
     if (IsParameter) {
       GA->invalidateZeroDimension();
     }
+    recordArrayModelUse(V);
     return GA;
   }
 
+  // Reuse the array of the previous round if its model did not change since,
+  // as the functions carried over from that round refer to it.
+  auto CI = CarriedGlobals.find(V);
+  if (CI != CarriedGlobals.end()) {
+    unsigned Version = CarriedGlobalVersions[V];
+    auto VI = ArrayModelVersion.find(V);
+    if (VI == ArrayModelVersion.end() || VI->second <= Version) {
+      GA = CI->second;
+      BM->adoptGlobal(*PrevBM, GA);
+      GlobalArrayVersion[V] = Version;
+      if (IsParameter)
+        GA->invalidateZeroDimension();
+      recordArrayModelUse(V);
+      return GA;
+    }
+  }
+
   bugle::Type T(Type::BV, 8);
   auto PT = cast<PointerType>(V->getType());
 
@@ -496,44 +637,71 @@ bugle::GlobalArray *TranslateModule::getGlobalArray(llvm::Value *V,
   GA = BM->addGlobal(V->getName(), T, SN, ST, dim, IsParameter);
   addGlobalArrayAttribs(GA, PT);
   GlobalValueMap[GA] = V;
+  if (IncrementalModelRounds) {
+    updateArrayModelVersions();
+    GlobalArrayVersion[V] = ModelVersion;
+  }
+  recordArrayModelUse(V);
   return GA;
 }
 
+// Initialise the array of V, which is not a global variable, to Init.
+void TranslateModule::translateArrayInit(llvm::Value *V, Constant *Init) {
+  if (CurrentDeps)
+    CurrentDeps->ArrayInits.push_back(std::make_pair(V, Init));
+  translateGlobalInit(getGlobalArray(V), 0, Init);
+}
+
+// Record an array whose race instrumentation state a specification refers to.
+void TranslateModule::addInstrumentedArray(ref<Expr> Array) {
+  if (CurrentDeps)
+    CurrentDeps->InstrumentedArrays.push_back(Array);
+  BM->addInstrumentedArray(Array);
+}
+
+// Add a function which is not translated from one of the module, but is
+// introduced by the translation of the current function.
+bugle::Function *
+TranslateModule::addHelperFunction(const std::string &Name,
+                                   const std::string &SourceName) {
+  auto *BF = BM->addFunction(Name, SourceName);
+  if (CurrentDeps)
+    CurrentDeps->HelperFunctions.insert(BF);
+  return BF;
+}
+
 ref<Expr>
 TranslateModule::translateGEP(ref<Expr> Ptr, klee::gep_type_iterator begin,
                               klee::gep_type_iterator end,
                               std::function<ref<Expr>(Value *)> xlate) {
-  ref<Expr> PtrArr = ArrayIdExpr::create(Ptr, defaultRange()),
-            PtrOfs = ArrayOffsetExpr::create(Ptr);
+  // The offset is accumulated in affine normal form, so that the offsets of
+  // nested GEPs are merged and their element alignment is easily checked.
+  ref<Expr> PtrArr = ArrayIdExpr::create(Ptr, defaultRange());
+  AffineForm PtrOfs(BM->getPointerWidth());
+  PtrOfs.add(ArrayOffsetExpr::create(Ptr));
   for (auto i = begin; i != end; ++i) {
     if (auto *ST = dyn_cast<StructType>(*i)) {
       const StructLayout *SL = TD.getStructLayout(ST);
       const ConstantInt *CI = cast<ConstantInt>(i.getOperand());
-      uint64_t Addend = SL->getElementOffset((unsigned)CI->getZExtValue());
-      PtrOfs = BVAddExpr::create(
-          PtrOfs, BVConstExpr::create(BM->getPointerWidth(), Addend));
+      PtrOfs.addConstant(SL->getElementOffset((unsigned)CI->getZExtValue()));
     } else if (auto *SET = dyn_cast<SequentialType>(*i)) {
       uint64_t ElementSize = TD.getTypeAllocSize(SET->getElementType());
       Value *Operand = i.getOperand();
       ref<Expr> Index = xlate(Operand);
       Index = BVZExtExpr::create(BM->getPointerWidth(), Index);
-      ref<Expr> Addend = BVMulExpr::create(
-          Index, BVConstExpr::create(BM->getPointerWidth(), ElementSize));
-      PtrOfs = BVAddExpr::create(PtrOfs, Addend);
+      PtrOfs.add(Index, ElementSize);
     } else if (auto *PT = dyn_cast<PointerType>(*i)) {
       uint64_t ElementSize = TD.getTypeAllocSize(PT->getElementType());
       Value *Operand = i.getOperand();
       ref<Expr> Index = xlate(Operand);
       Index = BVZExtExpr::create(BM->getPointerWidth(), Index);
-      ref<Expr> Addend = BVMulExpr::create(
-          Index, BVConstExpr::create(BM->getPointerWidth(), ElementSize));
-      PtrOfs = BVAddExpr::create(PtrOfs, Addend);
+      PtrOfs.add(Index, ElementSize);
     } else {
       ErrorReporter::reportImplementationLimitation("Unhandled GEP type");
     }
   }
 
-  return PointerExpr::create(PtrArr, PtrOfs);
+  return PointerExpr::create(PtrArr, PtrOfs.toExpr());
 }
 
 ref<Expr>
@@ -795,6 +963,7 @@ std::string TranslateModule::getSourceName(llvm::Value *V, llvm::Function *F) {
 // Convert the given unmodelled expression E to modelled form.
 ref<Expr> TranslateModule::modelValue(Value *V, ref<Expr> E) {
   if (E->getType().isKind(Type::Pointer)) {
+    recordPointerModelUse(V);
     auto OI = ModelPtrAsGlobalOffset.find(V);
     if (OI != ModelPtrAsGlobalOffset.end()) {
       auto GA = getGlobalArray(*OI->second.begin());
@@ -817,6 +986,7 @@ ref<Expr> TranslateModule::modelValue(Value *V, ref<Expr> E) {
 // If the given value is modelled, return its modelled type, else return
 // its conventional Boogie type (translateType).
 bugle::Type TranslateModule::getModelledType(Value *V) {
+  recordPointerModelUse(V);
   auto OI = ModelPtrAsGlobalOffset.find(V);
   if (OI != ModelPtrAsGlobalOffset.end() && OI->second.size() == 1 &&
       PtrMayBeNull.find(V) == PtrMayBeNull.end()) {
@@ -833,6 +1003,7 @@ bugle::Type TranslateModule::getModelledType(Value *V) {
 
 // Convert the given modelled expression E to unmodelled form.
 ref<Expr> TranslateModule::unmodelValue(Value *V, ref<Expr> E) {
+  recordPointerModelUse(V);
   auto OI = ModelPtrAsGlobalOffset.find(V);
   if (OI != ModelPtrAsGlobalOffset.end()) {
     auto *GA = getGlobalArray(*OI->second.begin());
@@ -862,9 +1033,11 @@ ref<Expr> TranslateModule::unmodelValue(Value *V, ref<Expr> E) {
 
 /// Given a value and all possible Boogie expressions to which it may be
 /// assigned, compute a model for that value such that future invocations
-/// of modelValue/getModelledType/unmodelValue use that model.
+/// of modelValue/getModelledType/unmodelValue use that model.  Cause is an
+/// instruction assigning the value, to which the trace attributes the model.
 void TranslateModule::computeValueModel(Value *Val, Var *Var,
-                                        llvm::ArrayRef<ref<Expr>> Assigns) {
+                                        llvm::ArrayRef<ref<Expr>> Assigns,
+                                        llvm::Instruction *Cause) {
   llvm::Type *VTy = Val->getType();
   if (auto *F = dyn_cast<llvm::Function>(Val))
     VTy = F->getReturnType();
@@ -873,21 +1046,22 @@ void TranslateModule::computeValueModel(Value *Val, Var *Var,
     return;
   if (VTy->getPointerElementType()->isFunctionTy())
     return;
+  recordPointerModelUse(Val);
   if (ModelPtrAsGlobalOffset.find(Val) != ModelPtrAsGlobalOffset.end())
     return;
 
-  std::set<GlobalArray *> GlobalSet;
+  GlobalArraySet Candidates;
   for (auto &Assign : Assigns) {
-    if (Assign->computeArrayCandidates(GlobalSet))
+    if (Assign->computeArrayCandidates(Candidates))
       continue;
     else
       return;
   }
 
-  assert(!GlobalSet.empty() && "GlobalSet is empty?");
+  assert(!Candidates.empty() && "GlobalSet is empty?");
 
   // Now check that each array in GlobalSet has the same type.
-  Type GlobalsType = Expr::getArrayCandidateType(GlobalSet);
+  Type GlobalsType = Candidates.getRangeType();
 
   // Check that each offset is a multiple of the range type's byte width (or
   // that if the offset refers to the variable, it maintains the invariant).
@@ -905,9 +1079,11 @@ void TranslateModule::computeValueModel(Value *Val, Var *Var,
   }
 
   // Remove null pointer candidates
-  if (GlobalSet.find(nullptr) != GlobalSet.end()) {
+  std::set<GlobalArray *> GlobalSet;
+  Candidates.getArrays(GlobalSet);
+  if (Candidates.containsNull()) {
     NextPtrMayBeNull.insert(Val);
-    GlobalSet.erase(GlobalSet.find(nullptr));
+    GlobalSet.erase(nullptr);
   }
 
   // If we only had null pointers, there is nothing to do
@@ -920,17 +1096,41 @@ void TranslateModule::computeValueModel(Value *Val, Var *Var,
                  std::inserter(GlobalValSet, GlobalValSet.begin()),
                  [&](GlobalArray *A) { return GlobalValueMap[A]; });
   NeedAdditionalGlobalOffsetModels = true;
+  if (Trace)
+    traceEvent(TranslationTrace::GlobalOffsetModel, Val, Cause);
 
   if (ModelGlobalsAsByteArray) {
     std::transform(GlobalSet.begin(), GlobalSet.end(),
                    std::inserter(ModelAsByteArray, ModelAsByteArray.begin()),
                    [&](GlobalArray *A) { return GlobalValueMap[A]; });
     NeedAdditionalByteArrayModels = true;
+    if (Trace)
+      traceByteArrayModels(Cause);
   }
 }
 
-Stmt *TranslateModule::modelCallStmt(llvm::Type *T, llvm::Function *F,
-                                     ref<Expr> Val,
+// Trace an event of the translation of the current function, which is traced
+// again in each later round the translation is carried over into.
+void TranslateModule::traceEvent(TranslationTrace::Reason R, llvm::Value *V,
+                                 llvm::Value *Cause) {
+  const TranslationTrace::Event &E = Trace->addEvent(R, V, Cause);
+  if (CurrentDeps)
+    CurrentDeps->TraceEvents.push_back(E);
+}
+
+// Record each array which became modelled as a byte array since the last call,
+// attributing it to the translation of Cause.
+void TranslateModule::traceByteArrayModels(llvm::Value *Cause) {
+  if (ModelAsByteArray.size() == TracedByteArrayModels.size())
+    return;
+
+  for (auto *V : ModelAsByteArray)
+    if (TracedByteArrayModels.insert(V).second)
+      traceEvent(TranslationTrace::ByteArrayModel, V, Cause);
+}
+
+Stmt *TranslateModule::modelCallStmt(llvm::CallInst *CI, llvm::Type *T,
+                                     llvm::Function *F, ref<Expr> Val,
                                      std::vector<ref<Expr>> &args,
                                      SourceLocsRef &sourcelocs) {
   std::map<llvm::Function *, Function *> FMap;
@@ -954,7 +1154,10 @@ Stmt *TranslateModule::modelCallStmt(llvm::Type *T, llvm::Function *F,
       return modelValue(&Arg, E);
     });
     auto CS = CallStmt::create(MappedF.second, FArgs, sourcelocs);
-    CallSites[MappedF.first].push_back(&CS->getArgs());
+    CallArgs CA(CI, CS->getArgs());
+    CallSites[MappedF.first].push_back(CA);
+    if (CurrentDeps)
+      CurrentDeps->CallSites.push_back(std::make_pair(MappedF.first, CA));
     CSS.push_back(CS);
   }
 
@@ -967,8 +1170,8 @@ Stmt *TranslateModule::modelCallStmt(llvm::Type *T, llvm::Function *F,
     return CallMemberOfStmt::create(Val, CSS, sourcelocs);
 }
 
-ref<Expr> TranslateModule::modelCallExpr(llvm::Type *T, llvm::Function *F,
-                                         ref<Expr> Val,
+ref<Expr> TranslateModule::modelCallExpr(llvm::CallInst *CI, llvm::Type *T,
+                                         llvm::Function *F, ref<Expr> Val,
                                          std::vector<ref<Expr>> &args) {
   std::map<llvm::Function *, Function *> FMap;
 
@@ -991,7 +1194,10 @@ ref<Expr> TranslateModule::modelCallExpr(llvm::Type *T, llvm::Function *F,
     });
     ref<Expr> E = CallExpr::create(MappedF.second, fargs);
     auto CE = dyn_cast<CallExpr>(E);
-    CallSites[MappedF.first].push_back(&CE->getArgs());
+    CallArgs CA(CI, CE->getArgs());
+    CallSites[MappedF.first].push_back(CA);
+    if (CurrentDeps)
+      CurrentDeps->CallSites.push_back(std::make_pair(MappedF.first, CA));
     CES.push_back(CE);
   }
 
@@ -1004,18 +1210,274 @@ ref<Expr> TranslateModule::modelCallExpr(llvm::Type *T, llvm::Function *F,
     return CallMemberOfExpr::create(Val, CES);
 }
 
+// Record that the function being translated depends on the model of the
+// global array V, as it was when the array was created in this round.
+void TranslateModule::recordArrayModelUse(Value *V) {
+  if (CurrentDeps)
+    CurrentDeps->Arrays.insert(std::make_pair(V, GlobalArrayVersion[V]));
+}
+
+// Record that the function being translated depends on the model of the
+// pointer V.
+void TranslateModule::recordPointerModelUse(Value *V) {
+  if (CurrentDeps)
+    CurrentDeps->Pointers.insert(V);
+}
+
+void TranslateModule::mergeModelDependencies(const ModelDependencies &D) {
+  for (auto &A : D.Arrays)
+    CurrentDeps->Arrays.insert(A);
+  CurrentDeps->Pointers.insert(D.Pointers.begin(), D.Pointers.end());
+}
+
+// ModelAsByteArray only ever grows, so any new members were added since the
+// last time this was called.  Give them a fresh version.
+void TranslateModule::updateArrayModelVersions() {
+  if (ModelAsByteArray.size() == VersionedModelAsByteArray.size())
+    return;
+
+  ++ModelVersion;
+  for (auto *V : ModelAsByteArray)
+    if (VersionedModelAsByteArray.insert(V).second)
+      ArrayModelVersion[V] = ModelVersion;
+}
+
+// Give a fresh version to each pointer whose model will change in the next
+// round.  Must be called before the next models are made current.
+void TranslateModule::updatePointerModelVersions() {
+  ++ModelVersion;
+  for (auto &MP : NextModelPtrAsGlobalOffset) {
+    auto OI = ModelPtrAsGlobalOffset.find(MP.first);
+    if (OI == ModelPtrAsGlobalOffset.end() || OI->second != MP.second)
+      PointerModelVersion[MP.first] = ModelVersion;
+  }
+  for (auto *V : NextPtrMayBeNull)
+    if (PtrMayBeNull.find(V) == PtrMayBeNull.end())
+      PointerModelVersion[V] = ModelVersion;
+}
+
+// Check that none of the models read by an earlier translation of a function
+// changed after they were read.
+bool TranslateModule::isModelUnchanged(const ModelDependencies &D) {
+  for (auto &A : D.Arrays) {
+    auto VI = ArrayModelVersion.find(A.first);
+    if (VI != ArrayModelVersion.end() && VI->second > A.second)
+      return false;
+  }
+  for (auto *V : D.Pointers) {
+    auto VI = PointerModelVersion.find(V);
+    if (VI != PointerModelVersion.end() && VI->second > D.Version)
+      return false;
+  }
+  return true;
+}
+
+// Re-apply the effects an earlier translation of a function had on the
+// fixed-point computation.  The model sets only ever grow, so only the call
+// sites and the flags need to be replayed.  The translation itself is carried
+// over into this round's module, along with the arrays, initialisers and
+// helper functions it refers to, and the events it traced are traced again.
+void TranslateModule::replayModelDependencies(const ModelDependencies &D) {
+  for (auto &CS : D.CallSites)
+    CallSites[CS.first].push_back(CS.second);
+  NeedAdditionalByteArrayModels |= D.NeedAdditionalByteArrayModels;
+  NeedAdditionalGlobalOffsetModels |= D.NeedAdditionalGlobalOffsetModels;
+  NextModelAllAsByteArray |= D.NextModelAllAsByteArray;
+
+  for (auto &A : D.Arrays)
+    getGlobalArray(A.first);
+  for (auto *C : D.Constants)
+    translateConstant(C);
+  for (auto &AI : D.ArrayInits)
+    translateArrayInit(AI.first, AI.second);
+  for (auto &IA : D.InstrumentedArrays)
+    BM->addInstrumentedArray(IA);
+  BM->adoptFunctions(*PrevBM, D.HelperFunctions);
+
+  if (Trace)
+    for (auto &E : D.TraceEvents)
+      Trace->replayEvent(E);
+}
+
+// Discard any earlier translation of F, leaving BF with just its return
+// variable, in the models of this round.
+void TranslateModule::resetFunction(llvm::Function *F, bugle::Function *BF) {
+  BF->clear();
+  if (!F->getReturnType()->isVoidTy())
+    BF->addReturn(getModelledType(F), "ret");
+}
+
+void TranslateModule::translateFunctionIncrementally(llvm::Function *F,
+                                                     TranslateFunction &TF) {
+  ModelDependencies &D = FunctionDeps[F];
+  D = ModelDependencies();
+  D.Version = ModelVersion;
+
+  bool ByteArrayModels = NeedAdditionalByteArrayModels,
+       GlobalOffsetModels = NeedAdditionalGlobalOffsetModels,
+       AllAsByteArray = NextModelAllAsByteArray;
+  NeedAdditionalByteArrayModels = false;
+  NeedAdditionalGlobalOffsetModels = false;
+  NextModelAllAsByteArray = false;
+
+  CurrentDeps = &D;
+  TF.translate();
+  CurrentDeps = nullptr;
+  updateArrayModelVersions();
+
+  D.NeedAdditionalByteArrayModels = NeedAdditionalByteArrayModels;
+  D.NeedAdditionalGlobalOffsetModels = NeedAdditionalGlobalOffsetModels;
+  D.NextModelAllAsByteArray = NextModelAllAsByteArray;
+  NeedAdditionalByteArrayModels |= ByteArrayModels;
+  NeedAdditionalGlobalOffsetModels |= GlobalOffsetModels;
+  NextModelAllAsByteArray |= AllAsByteArray;
+}
+
+// Seed the fixed point with models computed ahead of translation, so that
+// fewer rounds are needed to reach it.  The models must be ones the fixed
+// point would itself arrive at, as they are never revisited.
+void TranslateModule::addPointerModels(
+    const std::set<llvm::Value *> &ByteArrays,
+    const std::map<llvm::Value *, std::set<llvm::Value *>> &GlobalOffsets,
+    const std::set<llvm::Value *> &MayBeNull) {
+  ModelAsByteArray.insert(ByteArrays.begin(), ByteArrays.end());
+  for (auto &GO : GlobalOffsets) {
+    ModelPtrAsGlobalOffset[GO.first].insert(GO.second.begin(),
+                                            GO.second.end());
+    NextModelPtrAsGlobalOffset[GO.first].insert(GO.second.begin(),
+                                                GO.second.end());
+  }
+  PtrMayBeNull.insert(MayBeNull.begin(), MayBeNull.end());
+  NextPtrMayBeNull.insert(MayBeNull.begin(), MayBeNull.end());
+}
+
+// Model every array as a byte array from the next round on.  This is the one
+// model with which the fixed point is certain to be reached in a single round.
+void TranslateModule::escalateAllAsByteArray() {
+  ModelAllAsByteArray = NextModelAllAsByteArray = true;
+  ++NumAllAsByteArrayEscalations;
+  if (Trace)
+    Trace->addEvent(TranslationTrace::EscalateAllAsByteArray, nullptr,
+                    nullptr);
+}
+
+// Model each array of this round as a byte array, while keeping the global
+// offset models.  Returns false if there was no array left to escalate.
+bool TranslateModule::escalateByteArrayModels() {
+  bool Escalated = false;
+  for (auto &VG : ValueGlobalMap) {
+    if (VG.second->getRangeType() == Type(Type::BV, 8) ||
+        !ModelAsByteArray.insert(VG.first).second)
+      continue;
+
+    Escalated = true;
+    ++NumEscalatedByteArrays;
+    if (Trace) {
+      TracedByteArrayModels.insert(VG.first);
+      Trace->addEvent(TranslationTrace::EscalateByteArrayModel, VG.first,
+                      nullptr);
+    }
+  }
+
+  if (Escalated) {
+    ++NumByteArrayEscalations;
+    if (IncrementalModelRounds)
+      updateArrayModelVersions();
+  }
+  return Escalated;
+}
+
+// Decide, after the given round, whether to stop refining the pointer models.
+// A pattern of model changes which has persisted for k rounds is predicted to
+// persist for k more.  Escalating to byte array models instead reaches the
+// fixed point in one further round.
+TranslateModule::ModelEscalation
+TranslateModule::chooseModelEscalation(unsigned Round) {
+  if (ModelAllAsByteArray ||
+      (!NeedAdditionalByteArrayModels && !NeedAdditionalGlobalOffsetModels))
+    return NoEscalation;
+
+  if (MaxModelRounds != 0 && Round + 1 >= MaxModelRounds)
+    return EscalateAllAsByteArray;
+
+  if (EarlyModelEscalation == 0)
+    return NoEscalation;
+
+  // A case split which new global offset models failed to remove costs the
+  // rounds needed to find further models, plus a final round modelling all
+  // arrays as byte arrays.
+  if (CaseSplitRounds >= EarlyModelEscalation)
+    return EscalateAllAsByteArray;
+
+  // Byte array models which are found one round at a time, for example along
+  // a chain of memcpys, cost a round per array.
+  if (ByteArrayRounds > EarlyModelEscalation)
+    return EscalateByteArrays;
+
+  return NoEscalation;
+}
+
 void TranslateModule::translate() {
+  if (Trace)
+    TracedByteArrayModels = ModelAsByteArray;
+
+  // The modules of all rounds share a string table, as expressions may be
+  // carried over from one round to the next.
+  auto Strings = std::make_shared<bugle::StringTable>();
+  bugle::StringTable::Scope StringScope(Strings.get());
+
+  unsigned Round = 0;
+  CaseSplitRounds = ByteArrayRounds = 0;
+  // Set once the round budget is spent, for the round modelling all arrays
+  // as byte arrays which ends the fixed point.
+  bool FinalRound = false;
   do {
     NeedAdditionalByteArrayModels = false;
     NeedAdditionalGlobalOffsetModels = false;
+    if (Trace)
+      Trace->beginRound();
+    ++Round;
+    ++NumModelRounds;
+
+    // A budget of one round can only be met by modelling all arrays as byte
+    // arrays from the outset.
+    if (Round == 1 && MaxModelRounds == 1) {
+      if (!ModelAllAsByteArray)
+        escalateAllAsByteArray();
+      FinalRound = true;
+    }
 
-    delete BM;
-    BM = new bugle::Module;
-
-    FunctionMap.clear();
-    ConstantMap.clear();
-    GlobalValueMap.clear();
+    // When translating incrementally, the functions which are not translated
+    // again, and the arrays they refer to, are carried over from the module
+    // of the previous round.  Each function keeps its object from round to
+    // round, so that the calls to it remain valid.
+    if (IncrementalModelRounds)
+      PrevBM = BM;
+    else
+      delete BM;
+    BM = new bugle::Module(Strings);
+
+    if (!IncrementalModelRounds)
+      FunctionMap.clear();
+    for (auto i = ConstantMap.begin(), e = ConstantMap.end(); i != e;) {
+      if (isRoundInvariant(i->first))
+        ++i;
+      else
+        i = ConstantMap.erase(i);
+    }
+    ConstantExprs.clear();
+    ConstantDeps.clear();
+    if (!IncrementalModelRounds)
+      GlobalValueMap.clear();
+    CarriedGlobals.clear();
+    CarriedGlobalVersions.clear();
+    if (PrevBM) {
+      CarriedGlobals.swap(ValueGlobalMap);
+      CarriedGlobalVersions.swap(GlobalArrayVersion);
+    }
     ValueGlobalMap.clear();
+    GlobalArrayVersion.clear();
+    CarriedFunctions.clear();
     CallSites.clear();
 
     BM->setPointerWidth(TD.getPointerSizeInBits());
@@ -1030,13 +1492,26 @@ void TranslateModule::translate() {
           TranslateFunction::isSpecialFunction(SL, F.getName()))
         continue;
 
-      auto BF = FunctionMap[&F] =
-          BM->addFunction(F.getName(), getSourceFunctionName(&F));
+      bugle::Function *&BF = FunctionMap[&F];
+      if (!BF) {
+        BF = BM->addFunction(F.getName(), getSourceFunctionName(&F));
+        resetFunction(&F, BF);
+        continue;
+      }
 
-      auto *RT = F.getFunctionType()->getReturnType();
-      if (!RT->isVoidTy())
-        BF->addReturn(getModelledType(&F), "ret");
+      // The calls translated this round take their type from the return
+      // variable, so it must be in this round's model from the outset.  The
+      // earlier translation of F, which assigns to the old variable, is then
+      // out of date.
+      CarriedFunctions.insert(BF);
+      if (BF->return_begin() != BF->return_end() &&
+          (*BF->return_begin())->getType() != getModelledType(&F)) {
+        resetFunction(&F, BF);
+        FunctionDeps.erase(&F);
+      }
     }
+    if (PrevBM)
+      BM->adoptFunctions(*PrevBM, CarriedFunctions);
 
     for (auto &F : *M) {
       if (F.isIntrinsic())
@@ -1054,9 +1529,23 @@ void TranslateModule::translate() {
         assert(S->getVars()[0] == RV); (void)RV;
         BM->addAxiom(Expr::createNeZero(S->getValues()[0]));
       } else if (!TranslateFunction::isSpecialFunction(SL, F.getName())) {
+        if (IncrementalModelRounds) {
+          auto DI = FunctionDeps.find(&F);
+          if (DI != FunctionDeps.end() && isModelUnchanged(DI->second)) {
+            replayModelDependencies(DI->second);
+            continue;
+          }
+        }
+
+        bugle::Function *BF = FunctionMap[&F];
+        if (CarriedFunctions.count(BF))
+          resetFunction(&F, BF);
         bool EP = isGPUEntryPoint(&F, M, SL, GPUEntryPoints);
-        TranslateFunction TF(this, FunctionMap[&F], &F, EP);
-        TF.translate();
+        TranslateFunction TF(this, BF, &F, EP);
+        if (IncrementalModelRounds)
+          translateFunctionIncrementally(&F, TF);
+        else
+          TF.translate();
       }
     }
 
@@ -1070,15 +1559,59 @@ void TranslateModule::translate() {
         for (auto i = CSS.first->arg_begin(), e = CSS.first->arg_end(); i != e;
              ++i, ++idx) {
           std::vector<ref<Expr>> Parms;
-          std::transform(
-              CSS.second.begin(), CSS.second.end(), std::back_inserter(Parms),
-              [&](const std::vector<ref<Expr>> *CS) { return (*CS)[idx]; });
-          computeValueModel(&*i, nullptr, Parms);
+          std::transform(CSS.second.begin(), CSS.second.end(),
+                         std::back_inserter(Parms),
+                         [&](const CallArgs &CS) { return CS.second[idx]; });
+          computeValueModel(&*i, nullptr, Parms, CSS.second.front().first);
         }
       }
     }
 
-    if (NeedAdditionalGlobalOffsetModels) {
+    // Whatever of the previous round's module was not carried over is no
+    // longer referred to.
+    delete PrevBM;
+    PrevBM = nullptr;
+    CarriedGlobals.clear();
+
+    if (Trace)
+      Trace->endRound(BM, NeedAdditionalByteArrayModels,
+                      NeedAdditionalGlobalOffsetModels,
+                      NextModelAllAsByteArray);
+
+    if (IncrementalModelRounds)
+      updateArrayModelVersions();
+
+    // Further models asked for by the final round are not acted on.  Every
+    // array is a byte array in it, so its module is consistent as it is.
+    if (FinalRound)
+      break;
+
+    if (!ModelAllAsByteArray && NextModelAllAsByteArray &&
+        NeedAdditionalGlobalOffsetModels)
+      ++CaseSplitRounds;
+    else
+      CaseSplitRounds = 0;
+    if (NeedAdditionalByteArrayModels && !NeedAdditionalGlobalOffsetModels &&
+        !NextModelAllAsByteArray)
+      ++ByteArrayRounds;
+    else
+      ByteArrayRounds = 0;
+
+    ModelEscalation Escalation = chooseModelEscalation(Round);
+    if (Escalation == EscalateByteArrays && !escalateByteArrayModels())
+      Escalation = NoEscalation;
+
+    bool BudgetSpent = MaxModelRounds != 0 && Round + 1 >= MaxModelRounds;
+    bool PrevModelAllAsByteArray = ModelAllAsByteArray;
+    if (Escalation == EscalateAllAsByteArray) {
+      escalateAllAsByteArray();
+      FinalRound = BudgetSpent;
+    } else if (BudgetSpent && ModelAllAsByteArray) {
+      // All arrays are already byte arrays, following an early escalation.
+      // Keep them so rather than dropping back to refine the models.
+      NextModelAllAsByteArray = true;
+      FinalRound = true;
+    } else if (NeedAdditionalGlobalOffsetModels) {
       // If we can model new pointers using global offsets, a previously
       // observed case split may become unnecessary.  So when we recompute the
       // fixed point, don't use byte array models for everything unless we're
@@ -1088,7 +1621,19 @@ void TranslateModule::translate() {
       ModelAllAsByteArray = NextModelAllAsByteArray;
     }
 
+    if (IncrementalModelRounds) {
+      updatePointerModelVersions();
+      // Every array changes its range type along with ModelAllAsByteArray, so
+      // no function or array can be carried over.
+      if (ModelAllAsByteArray != PrevModelAllAsByteArray) {
+        FunctionDeps.clear();
+        ValueGlobalMap.clear();
+      }
+    }
+
     ModelPtrAsGlobalOffset = NextModelPtrAsGlobalOffset;
     PtrMayBeNull = NextPtrMayBeNull;
   } while (NeedAdditionalByteArrayModels || NeedAdditionalGlobalOffsetModels);
+
+  FunctionDeps.clear();
 }
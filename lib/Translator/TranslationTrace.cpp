@@ -0,0 +1,167 @@
+#include "bugle/Translator/TranslationTrace.h"
+#include "bugle/Translator/TranslateModule.h"
+#include "bugle/BasicBlock.h"
+#include "bugle/Expr.h"
+#include "bugle/Function.h"
+#include "bugle/Module.h"
+#include "llvm/IR/DebugInfoMetadata.h"
+#include "llvm/IR/Function.h"
+#include "llvm/IR/Instruction.h"
+#include "llvm/Support/Format.h"
+#include "llvm/Support/raw_ostream.h"
+
+using namespace bugle;
+
+void TranslationTrace::beginRound() {
+  Rounds.push_back(Round());
+  RoundStart = std::chrono::steady_clock::now();
+  RoundStartExprs = Expr::createdCount;
+}
+
+void TranslationTrace::endRound(bugle::Module *BM,
+                                bool NeedAdditionalByteArrayModels,
+                                bool NeedAdditionalGlobalOffsetModels,
+                                bool NextModelAllAsByteArray) {
+  Round &R = Rounds.back();
+  R.Seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() -
+                                            RoundStart)
+                  .count();
+  R.Exprs = Expr::createdCount - RoundStartExprs;
+  R.Stmts = 0;
+  for (auto i = BM->function_begin(), e = BM->function_end(); i != e; ++i)
+    for (auto *BB : **i)
+      R.Stmts += BB->end() - BB->begin();
+  R.NeedAdditionalByteArrayModels = NeedAdditionalByteArrayModels;
+  R.NeedAdditionalGlobalOffsetModels = NeedAdditionalGlobalOffsetModels;
+  R.NextModelAllAsByteArray = NextModelAllAsByteArray;
+}
+
+// Record that another round is needed because of value V.  Cause is the
+// instruction whose translation found this out, for example the instruction
+// accessing V, or the one assigning V for a model of V itself.
+const TranslationTrace::Event &
+TranslationTrace::addEvent(Reason R, llvm::Value *V, llvm::Value *Cause) {
+  Event E;
+  E.R = R;
+  E.Line = E.Column = 0;
+  E.Replayed = false;
+
+  if (V) {
+    llvm::raw_string_ostream SS(E.Value);
+    V->printAsOperand(SS, /*PrintType=*/false);
+    SS.flush();
+    if (R == ByteArrayModel)
+      E.SourceName = TranslateModule::getSourceGlobalArrayName(V);
+  }
+
+  if (Cause) {
+    llvm::raw_string_ostream SS(E.Instruction);
+    if (llvm::isa<llvm::Instruction>(Cause))
+      Cause->print(SS);
+    else
+      Cause->printAsOperand(SS, /*PrintType=*/false);
+    SS.flush();
+    E.Instruction = llvm::StringRef(E.Instruction).ltrim().str();
+  }
+
+  if (auto *I = llvm::dyn_cast_or_null<llvm::Instruction>(Cause)) {
+    if (I->getParent())
+      E.Function = I->getFunction()->getName().str();
+    if (const llvm::DILocation *Loc = I->getDebugLoc()) {
+      E.File = Loc->getFilename().str();
+      E.Line = Loc->getLine();
+      E.Column = Loc->getColumn();
+    }
+  } else if (auto *Arg = llvm::dyn_cast_or_null<llvm::Argument>(Cause)) {
+    E.Function = Arg->getParent()->getName().str();
+  } else if (auto *F = llvm::dyn_cast_or_null<llvm::Function>(Cause)) {
+    E.Function = F->getName().str();
+  }
+
+  Rounds.back().Events.push_back(E);
+  return Rounds.back().Events.back();
+}
+
+// Record an event of an earlier round again in this round, as the translation
+// which caused it was carried over into this round.
+void TranslationTrace::replayEvent(const Event &E) {
+  Rounds.back().Events.push_back(E);
+  Rounds.back().Events.back().Replayed = true;
+}
+
+static void writeString(llvm::raw_ostream &OS, const std::string &S) {
+  OS << '"';
+  for (unsigned char C : S) {
+    if (C == '"' || C == '\\')
+      OS << '\\' << C;
+    else if (C == '\n')
+      OS << "\\n";
+    else if (C == '\t')
+      OS << "\\t";
+    else if (C < 0x20)
+      OS << llvm::format("\\u%04x", C);
+    else
+      OS << C;
+  }
+  OS << '"';
+}
+
+static const char *getReasonName(TranslationTrace::Reason R) {
+  switch (R) {
+  case TranslationTrace::ByteArrayModel:
+    return "byte-array-model";
+  case TranslationTrace::GlobalOffsetModel:
+    return "global-offset-model";
+  case TranslationTrace::AllAsByteArray:
+    return "all-as-byte-array";
+  case TranslationTrace::EscalateByteArrayModel:
+    return "escalate-byte-array-model";
+  case TranslationTrace::EscalateAllAsByteArray:
+    return "escalate-all-as-byte-array";
+  }
+  return "";
+}
+
+void TranslationTrace::write(llvm::raw_ostream &OS) const {
+  OS << "{\n  \"rounds\": [";
+  for (unsigned i = 0; i != Rounds.size(); ++i) {
+    const Round &R = Rounds[i];
+    OS << (i == 0 ? "\n" : ",\n") << "    {\n"
+       << "      \"round\": " << (i + 1) << ",\n"
+       << "      \"seconds\": " << llvm::format("%.6f", R.Seconds) << ",\n"
+       << "      \"expressions\": " << R.Exprs << ",\n"
+       << "      \"statements\": " << R.Stmts << ",\n"
+       << "      \"need_additional_byte_array_models\": "
+       << (R.NeedAdditionalByteArrayModels ? "true" : "false") << ",\n"
+       << "      \"need_additional_global_offset_models\": "
+       << (R.NeedAdditionalGlobalOffsetModels ? "true" : "false") << ",\n"
+       << "      \"next_model_all_as_byte_array\": "
+       << (R.NextModelAllAsByteArray ? "true" : "false") << ",\n"
+       << "      \"events\": [";
+    for (unsigned j = 0; j != R.Events.size(); ++j) {
+      const Event &E = R.Events[j];
+      OS << (j == 0 ? "\n" : ",\n") << "        {\"reason\": ";
+      writeString(OS, getReasonName(E.R));
+      OS << ", \"value\": ";
+      writeString(OS, E.Value);
+      if (!E.SourceName.empty()) {
+        OS << ", \"source_name\": ";
+        writeString(OS, E.SourceName);
+      }
+      OS << ", \"function\": ";
+      writeString(OS, E.Function);
+      OS << ", \"instruction\": ";
+      writeString(OS, E.Instruction);
+      if (!E.File.empty() || E.Line != 0) {
+        OS << ", \"file\": ";
+        writeString(OS, E.File);
+        OS << ", \"line\": " << E.Line << ", \"column\": " << E.Column;
+      }
+      if (E.Replayed)
+        OS << ", \"replayed\": true";
+      OS << "}";
+    }
+    OS << (R.Events.empty() ? "]\n" : "\n      ]\n") << "    }";
+  }
+  OS << (Rounds.empty() ? "]\n" : "\n  ]\n") << "}\n";
+}
@@ -0,0 +1,96 @@
+#include "bugle/util/SourceLocReader.h"
+#include "llvm/Support/Endian.h"
+#include "llvm/Support/MemoryBuffer.h"
+
+using namespace bugle;
+using namespace llvm;
+
+static uint32_t readWord(const char *P, unsigned i) {
+  return support::endian::read32le(P + 4 * i);
+}
+
+SourceLocReader::SourceLocReader(std::unique_ptr<MemoryBuffer> Buffer)
+    : Buffer(std::move(Buffer)), NumChains(0), NumStrings(0),
+      ChainIndex(nullptr), StringIndex(nullptr), Records(nullptr),
+      StringData(nullptr), NumRecords(0), StringDataSize(0) {}
+
+SourceLocReader::~SourceLocReader() {}
+
+std::unique_ptr<SourceLocReader> SourceLocReader::open(StringRef FileName,
+                                                       std::string &Error) {
+  auto BufferOrError = MemoryBuffer::getFile(FileName, -1,
+                                             /*RequiresNullTerminator=*/false);
+  if (!BufferOrError) {
+    Error = BufferOrError.getError().message();
+    return nullptr;
+  }
+  std::unique_ptr<SourceLocReader> R(
+      new SourceLocReader(std::move(BufferOrError.get())));
+
+  const char *Start = R->Buffer->getBufferStart();
+  uint64_t Size = R->Buffer->getBufferSize();
+  if (Size < BinarySourceLocFormat::HeaderSize ||
+      readWord(Start, 0) != BinarySourceLocFormat::Magic) {
+    Error = "not a binary source location file";
+    return nullptr;
+  }
+  if (readWord(Start, 1) != BinarySourceLocFormat::Version) {
+    Error = "unsupported binary source location file version";
+    return nullptr;
+  }
+  R->NumChains = readWord(Start, 2);
+  R->NumStrings = readWord(Start, 3);
+
+  // The sizes of the indices are checked before they are read, and the sizes
+  // of the records and of the string data once they are known.
+  uint64_t Offset = BinarySourceLocFormat::HeaderSize;
+  uint64_t IndexSize = 4 * ((uint64_t)R->NumChains + R->NumStrings + 2);
+  if (Size < Offset + IndexSize) {
+    Error = "truncated binary source location file";
+    return nullptr;
+  }
+  R->ChainIndex = Start + Offset;
+  R->StringIndex = R->ChainIndex + 4 * ((uint64_t)R->NumChains + 1);
+  R->NumRecords = readWord(R->ChainIndex, R->NumChains);
+  R->StringDataSize = readWord(R->StringIndex, R->NumStrings);
+  Offset += IndexSize;
+  R->Records = Start + Offset;
+  Offset += (uint64_t)R->NumRecords * BinarySourceLocFormat::RecordSize;
+  R->StringData = Start + Offset;
+  if (Size < Offset + R->StringDataSize) {
+    Error = "truncated binary source location file";
+    return nullptr;
+  }
+  return R;
+}
+
+StringRef SourceLocReader::getString(unsigned Id) const {
+  if (Id >= NumStrings)
+    return StringRef();
+  uint32_t Begin = readWord(StringIndex, Id);
+  uint32_t End = readWord(StringIndex, Id + 1);
+  if (Begin > End || End > StringDataSize)
+    return StringRef();
+  return StringRef(StringData + Begin, End - Begin);
+}
+
+bool SourceLocReader::getSourceLocs(unsigned Num, SourceLocs &Locs) const {
+  if (Num >= NumChains)
+    return false;
+  uint32_t Begin = readWord(ChainIndex, Num);
+  uint32_t End = readWord(ChainIndex, Num + 1);
+  if (Begin > End || End > NumRecords)
+    return false;
+
+  Locs.clear();
+  for (uint32_t i = Begin; i != End; ++i) {
+    const char *Record =
+        Records + (uint64_t)i * BinarySourceLocFormat::RecordSize;
+    uint32_t FileName = readWord(Record, 2), Path = readWord(Record, 3);
+    if (FileName >= NumStrings || Path >= NumStrings)
+      return false;
+    Locs.push_back(SourceLoc(readWord(Record, 0), readWord(Record, 1),
+                             getString(FileName).str(), getString(Path).str()));
+  }
+  return true;
+}
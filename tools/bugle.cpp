@@ -26,6 +26,7 @@
 #include "bugle/Preprocessing/CycleDetectPass.h"
 #include "bugle/Preprocessing/FreshArrayPass.h"
 #include "bugle/Preprocessing/InlinePass.h"
+#include "bugle/Preprocessing/PointerModelAnalysisPass.h"
 #include "bugle/Preprocessing/RestrictDetectPass.h"
 #include "bugle/Preprocessing/SimpleInternalizePass.h"
 #include "bugle/Preprocessing/StructSimplificationPass.h"
@@ -33,6 +34,7 @@
 #include "bugle/RaceInstrumenter.h"
 #include "bugle/Transform/SimplifyStmt.h"
 #include "bugle/Translator/TranslateModule.h"
+#include "bugle/Translator/TranslationTrace.h"
 #include "bugle/util/ErrorReporter.h"
 
 #include <map>
@@ -53,6 +55,16 @@ static cl::opt<std::string> SourceLocationFilename(
     "s", cl::desc("File for saving source locations"), cl::init(""),
     cl::value_desc("filename"));
 
+static cl::opt<bool> StreamOutput(
+    "stream-bpl", cl::ValueDisallowed,
+    cl::desc("Write the Boogie output as it is generated rather than "
+             "buffering it, at the cost of a pre-pass over the module"));
+
+static cl::opt<std::string> TranslationTraceFilename(
+    "translation-trace",
+    cl::desc("File for saving a JSON trace of the translation rounds"),
+    cl::init(""), cl::value_desc("filename"));
+
 static cl::list<std::string> GPUEntryPoints(
     "k", cl::ZeroOrMore, cl::desc("GPU entry point function name"),
     cl::value_desc("function"));
@@ -73,12 +85,25 @@ static cl::opt<IntRep> IntegerRepresentation(
                clEnumValN(MathIntRep, "math",
                           "Mathematical integer representation")));
 
+static cl::opt<unsigned> Threads(
+    "j", cl::desc("Number of threads used to write procedures (default 1)"),
+    cl::value_desc("int"), cl::init(1));
+
 static cl::opt<bool> Inlining(
     "inline", cl::ValueDisallowed, cl::desc("Inline all function calls"));
 
+static cl::opt<bool> PointerModelAnalysis(
+    "pointer-model-analysis", cl::ValueDisallowed,
+    cl::desc("Compute pointer models before translation"));
+
 #ifndef NDEBUG
 static cl::opt<bool> DumpIR("dump-ir", cl::ValueDisallowed, cl::Hidden,
                             cl::desc("Dump the preprocessed IR"));
+
+static cl::opt<bool> CheckPointerModels(
+    "check-pointer-models", cl::ValueDisallowed, cl::Hidden,
+    cl::desc("Check the models computed by -pointer-model-analysis against "
+             "those translation arrives at without them"));
 #endif
 
 static cl::opt<bugle::RaceInstrumenter> RaceInstrumentation(
@@ -255,6 +280,11 @@ int main(int argc, char **argv) {
   PM.add(createGlobalDCEPass());
   PM.add(new bugle::RestrictDetectPass(SourceLanguage, EP, AddressSpaces));
   PM.add(new bugle::ArgumentRenamePass());
+  bugle::PointerModelAnalysisPass *PMA = nullptr;
+  if (PointerModelAnalysis) {
+    PMA = new bugle::PointerModelAnalysisPass(SourceLanguage, EP);
+    PM.add(PMA);
+  }
 #ifndef NDEBUG
   PM.add(createVerifierPass());
 #endif
@@ -265,11 +295,39 @@ int main(int argc, char **argv) {
     M->dump();
 #endif
 
+  std::unique_ptr<bugle::TranslationTrace> Trace;
+  if (!TranslationTraceFilename.empty())
+    Trace.reset(new bugle::TranslationTrace());
+
+#ifndef NDEBUG
+  if (PMA && CheckPointerModels) {
+    bugle::TranslateModule Unseeded(M.get(), SourceLanguage, EP,
+                                    RaceInstrumentation, AddressSpaces, KAS);
+    Unseeded.translate();
+    std::unique_ptr<bugle::Module> UnseededBM(Unseeded.takeModule());
+    bool ModelsReached = PMA->checkModels(Unseeded, errs());
+    assert(ModelsReached && "Pointer model analysis predicted a model which "
+                            "translation does not arrive at");
+  }
+#endif
+
   bugle::TranslateModule TM(M.get(), SourceLanguage, EP, RaceInstrumentation,
-                            AddressSpaces, KAS);
+                            AddressSpaces, KAS, Trace.get());
+  if (PMA)
+    TM.addPointerModels(PMA->getByteArrayModels(),
+                        PMA->getGlobalOffsetModels(), PMA->getMayBeNull());
   TM.translate();
   std::unique_ptr<bugle::Module> BM(TM.takeModule());
 
+  if (Trace) {
+    std::error_code ErrorCode;
+    ToolOutputFile T(TranslationTraceFilename, ErrorCode, sys::fs::F_Text);
+    if (ErrorCode)
+      bugle::ErrorReporter::reportFatalError(ErrorCode.message());
+    Trace->write(T.os());
+    T.keep();
+  }
+
   bugle::simplifyStmt(BM.get());
 
   std::string OutFile = OutputFilename;
@@ -286,15 +344,19 @@ int main(int argc, char **argv) {
 
   ToolOutputFile *L = nullptr;
   if (!SourceLocationFilename.empty()) {
-    L = new ToolOutputFile(SourceLocationFilename, ErrorCode, sys::fs::F_Text);
+    L = new ToolOutputFile(SourceLocationFilename, ErrorCode,
+                           bugle::SourceLocWriter::writesBinary()
+                               ? sys::fs::F_None
+                               : sys::fs::F_Text);
     if (ErrorCode)
       bugle::ErrorReporter::reportFatalError(ErrorCode.message());
   }
   std::unique_ptr<bugle::SourceLocWriter> SLW(new bugle::SourceLocWriter(L));
 
   bugle::BPLModuleWriter MW(F.os(), BM.get(), IntRep.get(), RaceInstrumentation,
-                            SLW.get());
+                            SLW.get(), StreamOutput, Threads);
   MW.write();
+  SLW->finish();
 
   F.os().flush();
   F.keep();